@@ -1,10 +1,50 @@
 #include "log.h"
 #include "config.h"
+#include <fstream>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
 
 namespace noobnet {
 
 // Config::ConfigVarMap Config::s_datas;
 
+uint64_t ConfigVarBase::NextVersion() {
+  static std::atomic<uint64_t> s_version {0};
+  return ++s_version;
+}
+
+//ConfigHandle的下标，析构后归还
+struct ConfigHandleIds {
+  Mutex mutex;
+  uint32_t next = 0;
+  std::vector<uint32_t> free;
+};
+
+static ConfigHandleIds& GetConfigHandleIds() {
+  static ConfigHandleIds* s_ids = new ConfigHandleIds;
+  return *s_ids;
+}
+
+ConfigHandleBase::ConfigHandleBase() {
+  ConfigHandleIds& ids = GetConfigHandleIds();
+  Mutex::Lock lock(ids.mutex);
+  if (ids.free.empty()) {
+    m_id = ids.next++;
+  } else {
+    m_id = ids.free.back();
+    ids.free.pop_back();
+  }
+}
+
+//其他线程缓存的快照在下标被复用时替换。复用的下标对应的配置项代数一定不同，不会误用旧值
+ConfigHandleBase::~ConfigHandleBase() {
+  ConfigHandleIds& ids = GetConfigHandleIds();
+  Mutex::Lock lock(ids.mutex);
+  ids.free.push_back(m_id);
+}
+
 ConfigVarBase::ptr Config::LookUpBase(const std::string& name) {
   auto it = GetDatas().find(name);
   return it == GetDatas().end() ? nullptr : it->second;
@@ -15,45 +55,271 @@ yaml文件格式
 A:
   B: 10
 */
-static void ListAllMember(const std::string& prefix,
-                          const YAML::Node& node,
-                          std::list<std::pair<std::string, const YAML::Node>>& output) {
-  if (prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._012345678")
+//先序遍历，每个节点直接交给同名的配置项转换，不复制节点也不序列化
+//有配置项转换失败时返回false，其余的配置项照常应用
+static bool LoadMember(const std::string& prefix, const YAML::Node& node) {
+  if (prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789")
         != std::string::npos) {
     SYS_LOG_ERROR(SYS_LOG_ROOT()) << "Invalid config:" << prefix << ":" << node;
-    return;
+    return true;
+  }
+  bool ok = true;
+  if (!prefix.empty()) {
+    std::string key = prefix;
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    ConfigVarBase::ptr var = Config::LookUpBase(key);
+    if (var && !var->fromNode(node)) {
+      ok = false;
+    }
   }
-  output.push_back(std::make_pair(prefix, node));
   if (node.IsMap()) {
     for (auto i = node.begin(); i != node.end(); ++i) {
-      ListAllMember(prefix.empty() ? i->first.Scalar() : 
-          prefix + "." + i->first.Scalar(), i->second, output);
+      if (!LoadMember(prefix.empty() ? i->first.Scalar() :
+            prefix + "." + i->first.Scalar(), i->second)) {
+        ok = false;
+      }
     }
   }
+  return ok;
 }
 //
-void Config::LoadFromYaml(const YAML::Node& root) {
-  std::list<std::pair<std::string, const YAML::Node>> all_nodes;
-  ListAllMember("", root, all_nodes);
+bool Config::LoadFromYaml(const YAML::Node& root) {
+  return LoadMember("", root);
+}
 
-  for (auto &it : all_nodes) {
-    std::string key = it.first;
-    if (key.empty()) {
-      continue;
+//两个节点的内容是否相同，map按文件中的顺序比较
+static bool NodeEqual(const YAML::Node& a, const YAML::Node& b) {
+  if (a.Type() != b.Type()) {
+    return false;
+  }
+  if (a.IsScalar()) {
+    return a.Scalar() == b.Scalar();
+  }
+  if (a.size() != b.size()) {
+    return false;
+  }
+  if (a.IsSequence()) {
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (!NodeEqual(a[i], b[i])) {
+        return false;
+      }
+    }
+  } else if (a.IsMap()) {
+    for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j) {
+      if (i->first.Scalar() != j->first.Scalar() || !NodeEqual(i->second, j->second)) {
+        return false;
+      }
     }
+  }
+  return true;
+}
+
+//配置项最终生效的节点及其所在的文件
+struct ConfValue {
+  YAML::Node node;
+  std::string file;
+};
 
+/**
+ * @brief 收集node中已注册的配置项
+ * @details 只取已注册的配置项对应的子树，以完整的名字作为key，
+ *          按文件名顺序收集，同名的配置项由靠后的文件覆盖
+*/
+static void CollectMember(const std::string& prefix, const YAML::Node& node,
+                          const std::string& file, std::map<std::string, ConfValue>& values) {
+  if (prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789")
+        != std::string::npos) {
+    SYS_LOG_ERROR(SYS_LOG_ROOT()) << "Invalid config:" << prefix << ":" << node;
+    return;
+  }
+  if (!prefix.empty()) {
+    std::string key = prefix;
     std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-    ConfigVarBase::ptr var = Config::LookUpBase(key);
+    if (Config::LookUpBase(key)) {
+      ConfValue& v = values[key];
+      v.node = node;
+      v.file = file;
+    }
+  }
+  if (node.IsMap()) {
+    for (auto i = node.begin(); i != node.end(); ++i) {
+      const std::string& key = i->first.Scalar();
+      CollectMember(prefix.empty() ? key : prefix + "." + key, i->second, file, values);
+    }
+  }
+}
 
-    if (var) {
-      if (it.second.IsScalar()) {
-        var->fromString(it.second.Scalar());
-      } else {
-        std::stringstream ss;
-        ss << it.second;
-        var->fromString(ss.str());
+static void ListAllFile(const std::string& path, const std::string& subfix,
+                        std::vector<std::string>& files) {
+  DIR* dir = opendir(path.c_str());
+  if (!dir) {
+    return;
+  }
+  struct dirent* dp;
+  while ((dp = readdir(dir)) != nullptr) {
+    std::string name = dp->d_name;
+    if (name == "." || name == "..") {
+      continue;
+    }
+    std::string file = path + "/" + name;
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0) {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      ListAllFile(file, subfix, files);
+    } else if (S_ISREG(st.st_mode) && name.size() > subfix.size()
+        && name.compare(name.size() - subfix.size(), subfix.size(), subfix) == 0) {
+      files.push_back(file);
+    }
+  }
+  closedir(dir);
+}
+
+//配置目录中每个文件上一次加载时的状态
+struct ConfFileState {
+  struct timespec mtime;
+  off_t size = 0;
+  size_t hash = 0;
+  YAML::Node root;
+};
+
+struct ConfDirState {
+  Mutex mutex;
+  std::map<std::string, ConfFileState> files;
+  //上一次应用成功的配置项
+  std::map<std::string, YAML::Node> values;
+};
+
+static ConfDirState& GetConfDirState() {
+  static ConfDirState* s_state = new ConfDirState;
+  return *s_state;
+}
+
+bool Config::LoadFromConfDir(const std::string& path, bool force) {
+  std::vector<std::string> files;
+  ListAllFile(path, ".yml", files);
+  std::sort(files.begin(), files.end());
+
+  ConfDirState& state = GetConfDirState();
+  Mutex::Lock lock(state.mutex);
+  std::map<std::string, ConfFileState> loaded;
+  bool ok = true;
+  bool changed = force;
+  for (auto& file : files) {
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0) {
+      continue;
+    }
+    auto it = state.files.find(file);
+    bool known = it != state.files.end();
+    //修改时间和大小都没变的文件不读取
+    if (!force && known && it->second.size == st.st_size
+        && it->second.mtime.tv_sec == st.st_mtim.tv_sec
+        && it->second.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+      loaded[file] = it->second;
+      continue;
+    }
+
+    std::ifstream ifs(file);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    if (!ifs) {
+      SYS_LOG_ERROR(SYS_LOG_ROOT()) << "LoadConfFile file=" << file << " read failed";
+      ok = false;
+      if (known) {
+        loaded[file] = it->second;
       }
+      continue;
     }
+    std::string content = ss.str();
+    ConfFileState cur;
+    cur.mtime = st.st_mtim;
+    //刚修改过的文件在同一个时间戳内可能再次被修改，下次仍然比较内容
+    if (st.st_mtim.tv_sec + 1 >= time(0)) {
+      cur.mtime.tv_sec = 0;
+      cur.mtime.tv_nsec = 0;
+    }
+    cur.size = content.size();
+    cur.hash = std::hash<std::string>()(content);
+    //只是修改时间变化
+    if (!force && known && it->second.hash == cur.hash) {
+      cur.root = it->second.root;
+      loaded[file] = cur;
+      continue;
+    }
+
+    try {
+      cur.root = YAML::Load(content);
+    } catch (const std::exception& e) {
+      //保留上一次的内容，文件修复后重新比较
+      SYS_LOG_ERROR(SYS_LOG_ROOT()) << "LoadConfFile file=" << file << " failed: " << e.what();
+      ok = false;
+      if (known) {
+        loaded[file] = it->second;
+      }
+      continue;
+    }
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "LoadConfFile file=" << file << " ok";
+    loaded[file] = cur;
+    changed = true;
+  }
+  if (!changed && loaded.size() == state.files.size()) {
+    return ok;
+  }
+
+  //按文件名顺序合并所有文件，再与上一次应用的结果比较，
+  //只修改了排序靠前的文件时，同名配置项仍然以靠后的文件为准
+  std::map<std::string, ConfValue> merged;
+  for (auto& i : loaded) {
+    CollectMember("", i.second.root, i.first, merged);
+  }
+  std::map<std::string, YAML::Node> applied;
+  for (auto& i : merged) {
+    auto old = state.values.find(i.first);
+    if (!force && old != state.values.end() && NodeEqual(i.second.node, old->second)) {
+      applied[i.first] = old->second;
+      continue;
+    }
+    ConfigVarBase::ptr var = LookUpBase(i.first);
+    if (var && var->fromNode(i.second.node)) {
+      applied[i.first] = i.second.node;
+      continue;
+    }
+    //转换失败的配置项保持原来的值，所在的文件不记录新的状态，下次重新读取
+    SYS_LOG_ERROR(SYS_LOG_ROOT()) << "LoadConfFile file=" << i.second.file
+        << " name=" << i.first << " convert failed";
+    ok = false;
+    if (old != state.values.end()) {
+      applied[i.first] = old->second;
+    }
+    auto prev = state.files.find(i.second.file);
+    if (prev != state.files.end()) {
+      loaded[i.second.file] = prev->second;
+    } else {
+      loaded.erase(i.second.file);
+    }
+  }
+  //已删除的文件不再记录，其中的配置项保持当前的值
+  applied.insert(state.values.begin(), state.values.end());
+  state.files.swap(loaded);
+  state.values.swap(applied);
+  return ok;
+}
+
+void Config::Visit(std::function<void(ConfigVarBase::ptr)> cb) {
+  //回调里可能再查找或注册配置项，先复制一份，释放锁之后再调用
+  std::vector<ConfigVarBase::ptr> vars;
+  {
+    RWMutexType::ReadLock lock(GetLock());
+    ConfigVarMap& m = GetDatas();
+    vars.reserve(m.size());
+    for (auto it = m.begin(); it != m.end(); ++it) {
+      vars.push_back(it->second);
+    }
+  }
+  for (auto& i : vars) {
+    cb(i);
   }
 }
 
@@ -3,6 +3,7 @@
 
 #include "log.h"
 #include "utils.h"
+#include "epoch.h"
 #include <string>
 #include <sstream>
 #include <memory>
@@ -11,6 +12,9 @@
 #include <unordered_set>
 #include <map>
 #include <unordered_map>
+#include <vector>
+#include <atomic>
+#include <type_traits>
 #include <boost/lexical_cast.hpp>
 #include <yaml-cpp/yaml.h>
 
@@ -26,7 +30,8 @@ public:
 
   ConfigVarBase(const std::string& name, const std::string& des = "") :
         m_name(name), //强制转小写
-        m_description(des) {
+        m_description(des),
+        m_version(NextVersion()) {
     std::transform(m_name.begin(), m_name.end(), m_name.begin(), ::tolower);
   }
 
@@ -34,15 +39,29 @@ public:
 
   virtual std::string toString() = 0;
   virtual bool fromString(const std::string& val) = 0;
+  //直接从YAML节点转换，不经过字符串
+  virtual bool fromNode(const YAML::Node& node) = 0;
   //virtual std::string getTypename() const = 0;
 
   const std::string& getName() const { return m_name; }
   const std::string& getDes() const { return m_description; }
 
   virtual std::string getTypeName() const = 0;
+
+  /**
+   * @brief 值的代数，每次修改后变化
+   * @details 取自全局递增的计数，不同配置项的代数不会相同，0不会被使用
+  */
+  uint64_t getVersion() const { return m_version.load(std::memory_order_acquire); }
+protected:
+  //新值发布之后调用
+  void bumpVersion() { m_version.store(NextVersion(), std::memory_order_release); }
+private:
+  static uint64_t NextVersion();
 private:
   std::string m_name;
   std::string m_description;
+  std::atomic<uint64_t> m_version;
 };
 
 //对类型转换做一个统一的处理，使用偏特化对复杂类型（容器）提供类型转换支持
@@ -54,6 +73,34 @@ public:
   }
 };
 
+//YAML节点 to T，标量直接转换，其余类型序列化之后再转换
+template<class T>
+class LexicalCast<YAML::Node, T> {
+public:
+  T operator() (const YAML::Node& node) {
+    if (node.IsScalar()) {
+      return LexicalCast<std::string, T>()(node.Scalar());
+    }
+    std::stringstream ss;
+    ss << node;
+    return LexicalCast<std::string, T>()(ss.str());
+  }
+};
+
+//YAML节点 to string
+template<>
+class LexicalCast<YAML::Node, std::string> {
+public:
+  std::string operator() (const YAML::Node& node) {
+    if (node.IsScalar()) {
+      return node.Scalar();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+  }
+};
+
 //vector to string
 template<class T>
 class LexicalCast<std::vector<T>, std::string> {
@@ -69,23 +116,29 @@ public:
   }
 };
 
-//string to vector
+//YAML节点 to vector
 template<class T>
-class LexicalCast<std::string, std::vector<T>> {
+class LexicalCast<YAML::Node, std::vector<T>> {
 public:
-  std::vector<T> operator() (const std::string& str) {
-    YAML::Node node = YAML::Load(str);
+  std::vector<T> operator() (const YAML::Node& node) {
     typename std::vector<T> vec;
-    std::stringstream ss;
-    for (size_t i = 0; i < node.size(); ++i) {
-      ss.str("");
-      ss << node[i];
-      vec.push_back(LexicalCast<std::string, T>()(ss.str()));
+    vec.reserve(node.size());
+    for (auto i = node.begin(); i != node.end(); ++i) {
+      vec.push_back(LexicalCast<YAML::Node, T>()(*i));
     }
     return vec;
   }
 };
 
+//string to vector
+template<class T>
+class LexicalCast<std::string, std::vector<T>> {
+public:
+  std::vector<T> operator() (const std::string& str) {
+    return LexicalCast<YAML::Node, std::vector<T>>()(YAML::Load(str));
+  }
+};
+
 //list to string
 template<class T>
 class LexicalCast<std::list<T>, std::string> {
@@ -101,23 +154,28 @@ public:
   }
 };
 
-//string to list
+//YAML节点 to list
 template<class T>
-class LexicalCast<std::string, std::list<T>> {
+class LexicalCast<YAML::Node, std::list<T>> {
 public:
-  std::list<T> operator() (const std::string& str) {
-    YAML::Node node = YAML::Load(str);
+  std::list<T> operator() (const YAML::Node& node) {
     typename std::list<T> vec;
-    std::stringstream ss;
-    for (size_t i = 0; i < node.size(); ++i) {
-      ss.str("");
-      ss << node[i];
-      vec.push_back(LexicalCast<std::string, T>()(ss.str()));
+    for (auto i = node.begin(); i != node.end(); ++i) {
+      vec.push_back(LexicalCast<YAML::Node, T>()(*i));
     }
     return vec;
   }
 };
 
+//string to list
+template<class T>
+class LexicalCast<std::string, std::list<T>> {
+public:
+  std::list<T> operator() (const std::string& str) {
+    return LexicalCast<YAML::Node, std::list<T>>()(YAML::Load(str));
+  }
+};
+
 //set to string
 template<class T>
 class LexicalCast<std::set<T>, std::string> {
@@ -133,23 +191,28 @@ public:
   }
 };
 
-//string to set
+//YAML节点 to set
 template<class T>
-class LexicalCast<std::string, std::set<T>> {
+class LexicalCast<YAML::Node, std::set<T>> {
 public:
-  std::set<T> operator() (const std::string& str) {
-    YAML::Node node = YAML::Load(str);
+  std::set<T> operator() (const YAML::Node& node) {
     typename std::set<T> vec;
-    std::stringstream ss;
-    for (size_t i = 0; i < node.size(); ++i) {
-      ss.str("");
-      ss << node[i];
-      vec.insert(LexicalCast<std::string, T>()(ss.str()));
+    for (auto i = node.begin(); i != node.end(); ++i) {
+      vec.insert(LexicalCast<YAML::Node, T>()(*i));
     }
     return vec;
   }
 };
 
+//string to set
+template<class T>
+class LexicalCast<std::string, std::set<T>> {
+public:
+  std::set<T> operator() (const std::string& str) {
+    return LexicalCast<YAML::Node, std::set<T>>()(YAML::Load(str));
+  }
+};
+
 //unordered_set to string
 template<class T>
 class LexicalCast<std::unordered_set<T>, std::string> {
@@ -165,23 +228,28 @@ public:
   }
 };
 
-//string to unordered_set
+//YAML节点 to unordered_set
 template<class T>
-class LexicalCast<std::string, std::unordered_set<T>> {
+class LexicalCast<YAML::Node, std::unordered_set<T>> {
 public:
-  std::unordered_set<T> operator() (const std::string& str) {
-    YAML::Node node = YAML::Load(str);
+  std::unordered_set<T> operator() (const YAML::Node& node) {
     typename std::unordered_set<T> vec;
-    std::stringstream ss;
-    for (size_t i = 0; i < node.size(); ++i) {
-      ss.str("");
-      ss << node[i];
-      vec.insert(LexicalCast<std::string, T>()(ss.str()));
+    for (auto i = node.begin(); i != node.end(); ++i) {
+      vec.insert(LexicalCast<YAML::Node, T>()(*i));
     }
     return vec;
   }
 };
 
+//string to unordered_set
+template<class T>
+class LexicalCast<std::string, std::unordered_set<T>> {
+public:
+  std::unordered_set<T> operator() (const std::string& str) {
+    return LexicalCast<YAML::Node, std::unordered_set<T>>()(YAML::Load(str));
+  }
+};
+
 //map to string
 template<class T>
 class LexicalCast<std::map<std::string, T>, std::string> {
@@ -197,24 +265,29 @@ public:
   }
 };
 
-//string to map
+//YAML节点 to map
 template<class T>
-class LexicalCast<std::string, std::map<std::string, T>> {
+class LexicalCast<YAML::Node, std::map<std::string, T>> {
 public:
-  std::map<std::string, T> operator() (const std::string& str) {
-    YAML::Node node = YAML::Load(str);
+  std::map<std::string, T> operator() (const YAML::Node& node) {
     typename std::map<std::string, T> vec;
-    std::stringstream ss;
     for (auto i = node.begin(); i != node.end(); ++i) {
-      ss.str("");
-      ss << i->second;
-      vec.insert(std::make_pair(i->first.Scalar(), 
-                  LexicalCast<std::string, T>()(ss.str())));
+      vec.insert(std::make_pair(i->first.Scalar(),
+                  LexicalCast<YAML::Node, T>()(i->second)));
     }
     return vec;
   }
 };
 
+//string to map
+template<class T>
+class LexicalCast<std::string, std::map<std::string, T>> {
+public:
+  std::map<std::string, T> operator() (const std::string& str) {
+    return LexicalCast<YAML::Node, std::map<std::string, T>>()(YAML::Load(str));
+  }
+};
+
 //unordered_map to string
 template<class T>
 class LexicalCast<std::unordered_map<std::string, T>, std::string> {
@@ -230,24 +303,54 @@ public:
   }
 };
 
-//string to unordered_map
+//YAML节点 to unordered_map
 template<class T>
-class LexicalCast<std::string, std::unordered_map<std::string, T>> {
+class LexicalCast<YAML::Node, std::unordered_map<std::string, T>> {
 public:
-  std::unordered_map<std::string, T> operator() (const std::string& str) {
-    YAML::Node node = YAML::Load(str);
+  std::unordered_map<std::string, T> operator() (const YAML::Node& node) {
     typename std::unordered_map<std::string, T> vec;
-    std::stringstream ss;
+    vec.reserve(node.size());
     for (auto i = node.begin(); i != node.end(); ++i) {
-      ss.str("");
-      ss << i->second;
-      vec.insert(std::make_pair(i->first.Scalar(), 
-                  LexicalCast<std::string, T>()(ss.str())));
+      vec.insert(std::make_pair(i->first.Scalar(),
+                  LexicalCast<YAML::Node, T>()(i->second)));
     }
     return vec;
   }
 };
 
+//string to unordered_map
+template<class T>
+class LexicalCast<std::string, std::unordered_map<std::string, T>> {
+public:
+  std::unordered_map<std::string, T> operator() (const std::string& str) {
+    return LexicalCast<YAML::Node, std::unordered_map<std::string, T>>()(YAML::Load(str));
+  }
+};
+
+//YAML节点 to bool，接受YAML的true/false写法，也接受toString输出的1/0
+template<>
+class LexicalCast<YAML::Node, bool> {
+public:
+  bool operator() (const YAML::Node& node) {
+    if (node.IsScalar()) {
+      const std::string& str = node.Scalar();
+      if (str == "1" || str == "0") {
+        return str == "1";
+      }
+    }
+    return node.as<bool>();
+  }
+};
+
+//string to bool
+template<>
+class LexicalCast<std::string, bool> {
+public:
+  bool operator() (const std::string& str) {
+    return LexicalCast<YAML::Node, bool>()(YAML::Load(str));
+  }
+};
+
 /**
  * @brief 配置参数模板类型，并保留其参数值
  * @details T 具体的参数类型
@@ -268,7 +371,8 @@ public:
   */
   ConfigVar(const T& val, const std::string& name, const std::string& des = "")
       :ConfigVarBase(name, des)
-      ,m_val(val) {
+      ,m_val(std::make_shared<Snapshot>(val))
+      ,m_ptr(m_val.get()) {
   }
 
   /**
@@ -285,12 +389,11 @@ public:
   std::string toString() override {
     try {
       //return boost::lexical_cast<std::string>(m_val); 
-      RWMutexType::ReadLock lock(m_mutex);
-      return ToStr()(m_val);
+      return ToStr()(*getSnapshot());
     }
     catch (const std::exception& e) {
       SYS_LOG_ERROR(SYS_LOG_ROOT()) << "ConfigVar::toString exception"
-        << e.what() << "convert" << typeid(m_val).name() << "to stirng";
+        << e.what() << "convert" << typeid(T).name() << "to stirng";
     }    
     return "";
   }
@@ -306,38 +409,81 @@ public:
     try {
       //m_val = LexicalCast<std::string, T>()(val);
       setValue(FromStr()(val));
+      return true;
     }
     catch (const std::exception& e) {
       SYS_LOG_ERROR(SYS_LOG_ROOT()) << "ConfigVar::toString exception"
-        << e.what() << "convert string to" << typeid(m_val).name();
+        << e.what() << "convert string to" << typeid(T).name();
     }
     return false;
   } 
 
   /**
-   * @brief 获取参数值
+   * @brief     使用YAML节点转换后的值更改配置项
+   * @param[in] node 配置项对应的YAML节点
+   * @details   使用默认的FromStr时由LexicalCast<YAML::Node, T>逐层转换，每个子树只解析一次；
+   *            自定义的FromStr仍然先序列化成字符串再转换
+   * @exception e 类型转换失败会抛出异常并打印
+  */
+  bool fromNode(const YAML::Node& node) override {
+    try {
+      setValue(FromNode(node, std::is_same<FromStr, LexicalCast<std::string, T>>()));
+      return true;
+    }
+    catch (const std::exception& e) {
+      SYS_LOG_ERROR(SYS_LOG_ROOT()) << "ConfigVar::fromNode exception"
+        << e.what() << "convert node to" << typeid(T).name();
+    }
+    return false;
+  }
+
+  /**
+   * @brief 获取参数值的拷贝
+   * @details 在EpochGuard内读取当前值的裸指针并拷贝，不加锁也不修改引用计数
   */
   const T getValue() { 
-    RWMutexType::ReadLock lock(m_mutex);
-    return m_val; 
+    EpochGuard guard;
+    return m_ptr.load()->value;
+  }
+
+  /**
+   * @brief 获取参数值的只读快照
+   * @details 在EpochGuard内读取裸指针，再由其weak引用取得shared_ptr，不加锁也不拷贝值，
+   *          只增加一次引用计数，容器类型的配置应优先使用。
+   *          快照创建后不再修改，setValue发布新的快照，持有的旧快照仍然有效
+  */
+  std::shared_ptr<const T> getSnapshot() const {
+    EpochGuard guard;
+    const Snapshot* snapshot = m_ptr.load();
+    //被替换的快照在离开临界区之前不会释放，引用计数不为0
+    return std::shared_ptr<const T>(snapshot->shared_from_this(), &snapshot->value);
   }
 
   /**
    * @brief 更改对应类型的值
-   * @details 如果对应的值出现变化则通知对应的注册回调函数
+   * @details 如果对应的值出现变化则通知对应的注册回调函数，之后发布新的快照，
+   *          旧快照交给Epoch，在读取它的线程都离开后释放
   */
   void setValue(const T& val) { 
+    std::shared_ptr<const T> old = getSnapshot();
+    if (val == *old) {
+      return;
+    }
     {
       RWMutexType::ReadLock lock(m_mutex);
-      if(val== m_val) {
-        return;
-      }
       for(auto& i : m_cbs) {
-        i.second(m_val, val);
+        i.second(*old, val);
       }
     }
-    RWMutexType::WriteLock lock(m_mutex);
-    m_val = val; 
+    std::shared_ptr<const Snapshot> retired;
+    {
+      RWMutexType::WriteLock lock(m_mutex);
+      retired = m_val;
+      m_val = std::make_shared<Snapshot>(val);
+      m_ptr.store(m_val.get());
+      bumpVersion();
+    }
+    Epoch::Retire(retired);
   } 
   //TODO 返回类型
   
@@ -382,12 +528,104 @@ public:
     m_cbs.clear();
   }
 private:
-  T m_val;
+  static T FromNode(const YAML::Node& node, std::true_type) {
+    return LexicalCast<YAML::Node, T>()(node);
+  }
+
+  static T FromNode(const YAML::Node& node, std::false_type) {
+    return FromStr()(LexicalCast<YAML::Node, std::string>()(node));
+  }
+private:
+  //不可变的快照，getSnapshot由裸指针经weak引用取得shared_ptr
+  struct Snapshot : public std::enable_shared_from_this<Snapshot> {
+    explicit Snapshot(const T& v) :value(v) {}
+    const T value;
+  };
+
+  //当前快照的所有者，由m_mutex保护
+  std::shared_ptr<const Snapshot> m_val;
+  //当前快照的裸指针，读取时不加锁
+  std::atomic<const Snapshot*> m_ptr;
   //为了保证每个回调函数唯一，使用uint64_t集中进行管理
   std::map<uint64_t, on_change_cb> m_cbs;
   RWMutexType m_mutex;
 };
 
+//ConfigHandle在每个线程中的缓存
+struct ConfigLocalSlot {
+  uint64_t version = 0;
+  const void* value = nullptr;
+  std::shared_ptr<const void> hold;
+};
+
+class ConfigHandleBase : Noncopyable {
+protected:
+  //分配在线程本地缓存中的下标，句柄析构后下标被复用
+  ConfigHandleBase();
+  ~ConfigHandleBase();
+
+  static std::vector<ConfigLocalSlot>& LocalSlots() {
+    static thread_local std::vector<ConfigLocalSlot> t_slots;
+    return t_slots;
+  }
+protected:
+  uint32_t m_id;
+};
+
+/**
+ * @brief 线程本地缓存的配置项句柄，适合每次操作都要读取的配置
+ * @details 每个线程缓存配置项的快照和代数，代数未变化时读取只需一次加载和比较；
+ *          setValue发布新值后各线程在下一次读取时重新获取快照。
+ *          快照不可修改，容器类型同样适用。
+ *          get()返回的引用在本线程下一次通过同一句柄读取之前有效
+ * @code
+ *   static ConfigHandle<uint32_t> s_stacksize(g_fiber_stacksize);
+ *   uint32_t size = s_stacksize.get();
+ * @endcode
+*/
+template<class T, class FromStr = LexicalCast<std::string, T>
+                , class ToStr = LexicalCast<T, std::string>>
+class ConfigHandle : public ConfigHandleBase {
+public:
+  typedef ConfigVar<T, FromStr, ToStr> VarType;
+
+  ConfigHandle(typename VarType::ptr var)
+      :m_var(var) {
+  }
+
+  const T& get() const {
+    std::vector<ConfigLocalSlot>& slots = LocalSlots();
+    if (m_id < slots.size()) {
+      ConfigLocalSlot& slot = slots[m_id];
+      if (slot.version == m_var->getVersion()) {
+        return *(const T*)slot.value;
+      }
+    }
+    return refresh();
+  }
+
+  const T& operator*() const { return get(); }
+  const T* operator->() const { return &get(); }
+
+  const typename VarType::ptr& getVar() const { return m_var; }
+private:
+  const T& refresh() const {
+    std::vector<ConfigLocalSlot>& slots = LocalSlots();
+    if (m_id >= slots.size()) {
+      slots.resize(m_id + 1);
+    }
+    ConfigLocalSlot& slot = slots[m_id];
+    //先读代数再取快照，两者之间的修改会在下一次读取时发现
+    slot.version = m_var->getVersion();
+    std::shared_ptr<const T> snapshot = m_var->getSnapshot();
+    slot.value = snapshot.get();
+    slot.hold = snapshot;
+    return *snapshot;
+  }
+private:
+  typename VarType::ptr m_var;
+};
+
 //config var 的管理类
 class Config {
 public:
@@ -402,7 +640,7 @@ public:
    * @details    根据配置项的名称查找相应的配置项
    *             若不存在该配置项则使用默认值default_val创建
    * @return     返回对应的配置参数，若名称存在但格式不匹配则返回nullptr
-   * @exception  若存在[abcdefghijklmnopqrstuvwxyz._012345678]
+   * @exception  若存在[abcdefghijklmnopqrstuvwxyz._0123456789]
    *             抛出异常invalid_argument
   */
   template<class T>
@@ -423,7 +661,7 @@ public:
         }
       }
       
-      if (name.find_first_not_of("abcdefghijklmnopqrstuvwxyz._012345678")
+      if (name.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789")
           != std::string::npos) {
         SYS_LOG_ERROR(SYS_LOG_ROOT()) << "Invalid config:" << name;
         throw std::invalid_argument(name);
@@ -456,14 +694,22 @@ public:
 
   /**
    * @brief 使用YAML::Node初始化配置文件
+   * @return 所有配置项都转换成功时返回true，转换失败的配置项保持原来的值
   */ 
-  static void LoadFromYaml(const YAML::Node& root);
+  static bool LoadFromYaml(const YAML::Node& root);
 
   /**
    * @brief     从配置目录path中加载配置项
-   * @param[in] path 配置文件所在的目录 
+   * @param[in] path 配置文件所在的目录，包括子目录中的*.yml文件
+   * @param[in] force 为true时重新读取并应用所有文件
+   * @details   记录每个文件的修改时间、大小和内容的哈希，再次调用时只解析发生变化的文件。
+   *            所有文件按文件名排序合并，同名配置项以靠后的文件为准，
+   *            合并的结果与上一次应用的值比较，只应用有变化的配置项。
+   *            解析失败的文件保持之前的值；转换失败的配置项保持原来的值，
+   *            所在的文件不记录新的状态，下次调用时重新读取
+   * @return    所有需要读取的文件都读取、解析并转换成功时返回true
   */
-  static void LoadFromConfDir(const std::string& path, bool force);
+  static bool LoadFromConfDir(const std::string& path, bool force = false);
   
   /**
    * @brief     遍历配置模块内的所有配置项
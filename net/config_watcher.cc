@@ -0,0 +1,220 @@
+#include "config_watcher.h"
+
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <functional>
+
+namespace noobnet {
+
+static Logger::ptr g_logger = SYS_LOG_NAME("system");
+
+// 持续有事件时，最多推迟到第一个事件之后debounce的这么多倍
+static const uint64_t s_config_watch_max_delay = 10;
+
+static const uint32_t s_config_watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+    | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+
+ConfigWatcher::ConfigWatcher(const std::string& path, uint32_t debounce)
+    :m_path(path)
+    ,m_debounce(debounce)
+    ,m_stopping(false)
+    ,m_reloads(0)
+    ,m_parseFailures(0)
+    ,m_events(0)
+    ,m_lastReloadUs(0)
+    ,m_maxReloadUs(0)
+    ,m_totalReloadUs(0) {
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_inotifyFd < 0 || m_wakeupFd < 0) {
+        SYS_LOG_ERROR(g_logger) << "ConfigWatcher init failed path=" << m_path
+            << " errno=" << errno << " errstr=" << strerror(errno);
+    } else {
+        // 先监视再加载，加载期间的修改会触发下一次加载
+        addWatch(m_path);
+    }
+    if (!Config::LoadFromConfDir(m_path)) {
+        ++m_parseFailures;
+    }
+    if (m_inotifyFd >= 0 && m_wakeupFd >= 0) {
+        m_thread.reset(new Thread(std::bind(&ConfigWatcher::run, this), "config_watch"));
+    }
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    m_stopping = true;
+    if (m_thread) {
+        uint64_t one = 1;
+        if (::write(m_wakeupFd, &one, sizeof(one)) < 0) {
+            SYS_LOG_ERROR(g_logger) << "ConfigWatcher wakeup failed errno=" << errno;
+        }
+        m_thread->join();
+    }
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+    }
+    if (m_wakeupFd >= 0) {
+        ::close(m_wakeupFd);
+    }
+}
+
+void ConfigWatcher::addWatch(const std::string& dir) {
+    int wd = inotify_add_watch(m_inotifyFd, dir.c_str(), s_config_watch_mask);
+    if (wd < 0) {
+        SYS_LOG_ERROR(g_logger) << "ConfigWatcher watch " << dir << " failed errno="
+            << errno << " errstr=" << strerror(errno);
+        return;
+    }
+    m_watches[wd] = dir;
+
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+    struct dirent* dp;
+    while ((dp = readdir(d)) != nullptr) {
+        std::string name = dp->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string sub = dir + "/" + name;
+        struct stat st;
+        if (stat(sub.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            addWatch(sub);
+        }
+    }
+    closedir(d);
+}
+
+bool ConfigWatcher::readEvents() {
+    bool dirty = false;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        ssize_t n = ::read(m_inotifyFd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (char* p = buf; p < buf + n; ) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            ++m_events;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                // 丢失了事件，无法知道哪些文件变化，整个目录重新比较
+                dirty = true;
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                m_watches.erase(ev->wd);
+                continue;
+            }
+            auto it = m_watches.find(ev->wd);
+            if (it == m_watches.end() || ev->len == 0) {
+                continue;
+            }
+            std::string name = ev->name;
+            if (ev->mask & IN_ISDIR) {
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    addWatch(it->second + "/" + name);
+                }
+                dirty = true;
+            } else if (!(ev->mask & IN_CREATE) && name.size() > 4
+                    && name.compare(name.size() - 4, 4, ".yml") == 0) {
+                // 新建的文件写完之后还会有IN_CLOSE_WRITE
+                dirty = true;
+            }
+        }
+    }
+    return dirty;
+}
+
+void ConfigWatcher::reload() {
+    uint64_t begin = GetMonotonicUS();
+    bool ok = Config::LoadFromConfDir(m_path);
+    uint64_t cost = GetMonotonicUS() - begin;
+
+    ++m_reloads;
+    if (!ok) {
+        ++m_parseFailures;
+    }
+    m_lastReloadUs.store(cost, std::memory_order_relaxed);
+    m_totalReloadUs.fetch_add(cost, std::memory_order_relaxed);
+    if (cost > m_maxReloadUs.load(std::memory_order_relaxed)) {
+        m_maxReloadUs.store(cost, std::memory_order_relaxed);
+    }
+    SYS_LOG_INFO(g_logger) << "ConfigWatcher reload path=" << m_path
+        << " ok=" << ok << " cost=" << cost << "us";
+}
+
+void ConfigWatcher::run() {
+    struct pollfd pfds[2];
+    pfds[0].fd = m_inotifyFd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = m_wakeupFd;
+    pfds[1].events = POLLIN;
+
+    bool pending = false;
+    uint64_t first = 0;
+    uint64_t deadline = 0;
+    while (!m_stopping) {
+        int timeout = -1;
+        if (pending) {
+            uint64_t now = GetMonotonicUS();
+            if (now >= deadline) {
+                pending = false;
+                reload();
+                continue;
+            }
+            timeout = (deadline - now + 999) / 1000;
+        }
+        int rt = ::poll(pfds, 2, timeout);
+        if (rt < 0) {
+            if (errno != EINTR) {
+                SYS_LOG_ERROR(g_logger) << "ConfigWatcher poll failed errno=" << errno
+                    << " errstr=" << strerror(errno);
+                break;
+            }
+            continue;
+        }
+        if (pfds[1].revents) {
+            uint64_t v;
+            while (::read(m_wakeupFd, &v, sizeof(v)) > 0) {
+            }
+        }
+        if ((pfds[0].revents & POLLIN) && readEvents()) {
+            uint64_t now = GetMonotonicUS();
+            if (!pending) {
+                pending = true;
+                first = now;
+            }
+            deadline = std::min(now + m_debounce * 1000ul,
+                    first + m_debounce * 1000ul * s_config_watch_max_delay);
+        }
+    }
+}
+
+std::string ConfigWatcher::metricsToYamlString() const {
+    YAML::Node node;
+    node["path"] = m_path;
+    node["reloads"] = getReloads();
+    node["parse_failures"] = getParseFailures();
+    node["events"] = getEvents();
+    node["last_reload_us"] = getLastReloadUs();
+    node["max_reload_us"] = getMaxReloadUs();
+    node["total_reload_us"] = getTotalReloadUs();
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+} // noobnet
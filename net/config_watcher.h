@@ -0,0 +1,117 @@
+#ifndef __NOOBNET_CONFIG_WATCHER_
+#define __NOOBNET_CONFIG_WATCHER_
+
+#include "config.h"
+#include "thread.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <string>
+#include <map>
+#include <memory>
+#include <stdint.h>
+
+namespace noobnet {
+
+/**
+ * @brief 监视配置目录，文件变化后自动重新加载
+ * @details 后台线程用inotify监视目录及其子目录中*.yml文件的写入、移动和删除，
+ *          一批事件结束debounce毫秒后调用Config::LoadFromConfDir，
+ *          只有内容变化的配置项经ConfigVarBase::fromNode重新转换，addListener注册的回调照常触发。
+ *          解析失败的文件保持之前的值，修复后的下一次事件会重新加载。
+ *          没有事件时线程阻塞在poll上，不会定期唤醒
+*/
+class ConfigWatcher : Noncopyable {
+public:
+  typedef std::shared_ptr<ConfigWatcher> ptr;
+
+  /**
+   * @brief 构造函数，先同步加载一次目录，之后启动监视线程
+   * @param[in] path 配置目录
+   * @param[in] debounce 最后一个事件之后等待的毫秒数，编辑器保存时的一连串事件只触发一次加载
+  */
+  ConfigWatcher(const std::string& path, uint32_t debounce = 200);
+
+  /**
+   * @brief 析构函数，停止并等待监视线程
+  */
+  ~ConfigWatcher();
+
+  const std::string& getPath() const { return m_path; }
+  uint32_t getDebounce() const { return m_debounce; }
+
+  /**
+   * @brief 由事件触发的加载次数
+  */
+  uint64_t getReloads() const { return m_reloads.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief 有文件读取、解析失败或配置项转换失败的加载次数，包括构造时的加载
+  */
+  uint64_t getParseFailures() const { return m_parseFailures.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief 收到的inotify事件数，包括被忽略的非*.yml文件
+  */
+  uint64_t getEvents() const { return m_events.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief 最近一次加载的耗时（微秒），不含等待的debounce时间
+  */
+  uint64_t getLastReloadUs() const { return m_lastReloadUs.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief 加载的最大耗时（微秒）
+  */
+  uint64_t getMaxReloadUs() const { return m_maxReloadUs.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief 加载的总耗时（微秒），除以getReloads()得到平均值
+  */
+  uint64_t getTotalReloadUs() const { return m_totalReloadUs.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief 以YAML格式输出上面的统计
+  */
+  std::string metricsToYamlString() const;
+private:
+  /**
+   * @brief 监视dir及其所有子目录
+  */
+  void addWatch(const std::string& dir);
+
+  /**
+   * @brief 读出所有待处理的事件
+   * @return 有需要重新加载的事件时返回true
+  */
+  bool readEvents();
+
+  void reload();
+
+  /**
+   * @brief 后台线程执行函数
+  */
+  void run();
+private:
+  std::string m_path;
+  uint32_t m_debounce;
+
+  int m_inotifyFd = -1;
+  int m_wakeupFd = -1;
+  // 只由构造函数和后台线程访问
+  std::map<int, std::string> m_watches;
+
+  Thread::ptr m_thread;
+  std::atomic<bool> m_stopping;
+
+  std::atomic<uint64_t> m_reloads;
+  std::atomic<uint64_t> m_parseFailures;
+  std::atomic<uint64_t> m_events;
+  std::atomic<uint64_t> m_lastReloadUs;
+  std::atomic<uint64_t> m_maxReloadUs;
+  std::atomic<uint64_t> m_totalReloadUs;
+};
+
+} // noobnet
+
+#endif // !__NOOBNET_CONFIG_WATCHER_
@@ -0,0 +1,276 @@
+#include "epoch.h"
+#include "thread.h"
+#include "mutex.h"
+#include "utils.h"
+
+#include <unistd.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+
+namespace noobnet {
+
+// 有对象等待释放时检查读者的间隔
+static const uint64_t s_epoch_poll_us = 1000;
+// 进程退出时等待仍在临界区内的读者的最长时间，超时后对应的对象不再释放
+static const uint64_t s_epoch_exit_wait_us = 1000 * 1000;
+
+// 全局epoch，从1开始，记录中的0表示线程不在临界区
+static std::atomic<uint64_t> s_epoch {1};
+
+/**
+ * @brief 每个线程的登记记录
+ * @details 记录串成只增不减的链表，线程退出后留给之后的线程复用，从不释放，
+ *          回收线程遍历时不需要加锁
+*/
+struct EpochRecord {
+    std::atomic<uint64_t> epoch {0};
+    std::atomic<bool> used {true};
+    // 只由所属线程访问
+    uint32_t depth = 0;
+    EpochRecord* next = nullptr;
+    // 各线程的记录不共享缓存行
+    char pad[64];
+};
+
+static std::atomic<EpochRecord*> s_epoch_records {nullptr};
+
+static thread_local EpochRecord* t_epoch_record = nullptr;
+// 线程退出时已经归还过记录，之后再进入临界区的记录不再归还
+static thread_local bool t_epoch_exited = false;
+
+//线程退出时归还记录
+struct EpochRecordHolder {
+    EpochRecord* record = nullptr;
+
+    ~EpochRecordHolder() {
+        t_epoch_exited = true;
+        if (!record) {
+            return;
+        }
+        record->depth = 0;
+        record->epoch.store(0, std::memory_order_release);
+        record->used.store(false, std::memory_order_release);
+        t_epoch_record = nullptr;
+    }
+};
+
+static thread_local EpochRecordHolder t_epoch_record_holder;
+
+static EpochRecord* AcquireRecord() {
+    EpochRecord* record = nullptr;
+    for (EpochRecord* i = s_epoch_records.load(std::memory_order_acquire); i; i = i->next) {
+        bool expected = false;
+        if (!i->used.load(std::memory_order_relaxed)
+                && i->used.compare_exchange_strong(expected, true)) {
+            record = i;
+            break;
+        }
+    }
+    if (!record) {
+        record = new EpochRecord;
+        EpochRecord* head = s_epoch_records.load(std::memory_order_relaxed);
+        do {
+            record->next = head;
+        } while (!s_epoch_records.compare_exchange_weak(head, record));
+    }
+    t_epoch_record = record;
+    if (!t_epoch_exited) {
+        t_epoch_record_holder.record = record;
+    }
+    return record;
+}
+
+void Epoch::Enter() {
+    EpochRecord* record = t_epoch_record;
+    if (!record) {
+        record = AcquireRecord();
+    }
+    if (record->depth++ == 0) {
+        //登记和之后对发布指针的读取都是seq_cst，读到旧指针的读者一定会被回收线程看到
+        record->epoch.store(s_epoch.load());
+    }
+}
+
+void Epoch::Leave() {
+    EpochRecord* record = t_epoch_record;
+    if (--record->depth == 0) {
+        record->epoch.store(0, std::memory_order_release);
+    }
+}
+
+//所有在临界区内的线程登记的最小epoch
+static uint64_t MinActiveEpoch() {
+    uint64_t min = UINT64_MAX;
+    for (EpochRecord* i = s_epoch_records.load(std::memory_order_acquire); i; i = i->next) {
+        uint64_t e = i->epoch.load();
+        if (e && e < min) {
+            min = e;
+        }
+    }
+    return min;
+}
+
+/**
+ * @brief 在当前线程等待stamp之前进入的读者都离开
+ * @return 可以释放时返回true；超过deadline或当前线程自己在临界区内时返回false
+*/
+static bool WaitReaders(uint64_t stamp, uint64_t deadline) {
+    while (MinActiveEpoch() <= stamp) {
+        EpochRecord* self = t_epoch_record;
+        if (self && self->depth && self->epoch.load() <= stamp) {
+            return false;
+        }
+        if (GetMonotonicUS() >= deadline) {
+            return false;
+        }
+        usleep(s_epoch_poll_us);
+    }
+    return true;
+}
+
+/**
+ * @brief 进程退出后在当前线程释放obj
+ * @details 仍有读者可能访问它时不释放，有意泄漏
+*/
+static bool ReleaseNow(uint64_t stamp, std::shared_ptr<const void>& obj, uint64_t deadline) {
+    if (WaitReaders(stamp, deadline)) {
+        obj.reset();
+        return true;
+    }
+    new std::shared_ptr<const void>(std::move(obj));
+    return false;
+}
+
+/**
+ * @brief 待释放的对象和后台回收线程
+ * @details 对象按交出时的epoch排队，登记的epoch都大于它时说明替换之前进入的读者已经离开
+*/
+struct EpochReclaimer {
+    Mutex mutex;
+    std::deque<std::pair<uint64_t, std::shared_ptr<const void>>> pending;
+    Thread::ptr thread;
+    Semophore semophore;
+    bool stopping = false;
+    std::atomic<uint64_t> retired {0};
+    std::atomic<uint64_t> reclaimed {0};
+
+    void run() {
+        while (true) {
+            std::vector<std::shared_ptr<const void>> ready;
+            bool stop = false;
+            bool more = false;
+            {
+                Mutex::Lock lock(mutex);
+                stop = stopping;
+                uint64_t min = MinActiveEpoch();
+                while (!pending.empty() && pending.front().first < min) {
+                    ready.push_back(std::move(pending.front().second));
+                    pending.pop_front();
+                }
+                more = !pending.empty();
+            }
+            //在锁外析构，析构函数里可以再交出对象
+            size_t n = ready.size();
+            ready.clear();
+            reclaimed.fetch_add(n);
+            if (stop) {
+                break;
+            }
+            if (more) {
+                usleep(s_epoch_poll_us);
+            } else {
+                semophore.wait();
+            }
+        }
+    }
+};
+
+//放在堆上不析构，进程退出时由EpochReclaimerStopper停止线程
+static EpochReclaimer& GetEpochReclaimer() {
+    static EpochReclaimer* s_reclaimer = new EpochReclaimer;
+    return *s_reclaimer;
+}
+
+/**
+ * @brief 进程退出时停止回收线程并释放剩余的对象
+ * @details 在第一次Retire时构造，因此先于之前已经构造的单例（如LoggerMgr）析构。
+ *          剩余的对象同样要等读者离开后才释放，最多等待s_epoch_exit_wait_us
+*/
+struct EpochReclaimerStopper {
+    ~EpochReclaimerStopper() {
+        EpochReclaimer& r = GetEpochReclaimer();
+        {
+            Mutex::Lock lock(r.mutex);
+            r.stopping = true;
+        }
+        r.semophore.notify();
+        r.thread->join();
+
+        std::deque<std::pair<uint64_t, std::shared_ptr<const void>>> rest;
+        {
+            Mutex::Lock lock(r.mutex);
+            rest.swap(r.pending);
+        }
+        uint64_t deadline = GetMonotonicUS() + s_epoch_exit_wait_us;
+        for (auto& i : rest) {
+            if (ReleaseNow(i.first, i.second, deadline)) {
+                r.reclaimed.fetch_add(1);
+            }
+        }
+    }
+};
+
+void Epoch::Retire(std::shared_ptr<const void> obj) {
+    if (!obj) {
+        return;
+    }
+    EpochReclaimer& r = GetEpochReclaimer();
+    uint64_t stamp = 0;
+    bool stopped = false;
+    {
+        Mutex::Lock lock(r.mutex);
+        //先递增epoch再入队，之后进入的读者登记的epoch都大于stamp
+        stamp = s_epoch.fetch_add(1);
+        r.retired.fetch_add(1);
+        stopped = r.stopping;
+        if (!stopped) {
+            r.pending.push_back(std::make_pair(stamp, std::move(obj)));
+            if (!r.thread) {
+                static EpochReclaimerStopper s_stopper;
+                r.thread.reset(new Thread(std::bind(&EpochReclaimer::run, &r), "epoch_reclaim"));
+            }
+        }
+    }
+    if (stopped) {
+        //进程正在退出，回收线程已经停止，在当前线程等读者离开后释放
+        if (ReleaseNow(stamp, obj, GetMonotonicUS() + s_epoch_exit_wait_us)) {
+            r.reclaimed.fetch_add(1);
+        }
+        return;
+    }
+    r.semophore.notify();
+}
+
+void Epoch::Synchronize() {
+    EpochReclaimer& r = GetEpochReclaimer();
+    uint64_t target = r.retired.load();
+    while (r.reclaimed.load() < target) {
+        {
+            Mutex::Lock lock(r.mutex);
+            if (r.stopping) {
+                return;
+            }
+        }
+        r.semophore.notify();
+        usleep(s_epoch_poll_us);
+    }
+}
+
+uint64_t Epoch::GetPending() {
+    EpochReclaimer& r = GetEpochReclaimer();
+    return r.retired.load() - r.reclaimed.load();
+}
+
+} // noobnet
@@ -0,0 +1,60 @@
+#ifndef __NOOBNET_EPOCH_
+#define __NOOBNET_EPOCH_
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <stdint.h>
+
+namespace noobnet {
+
+/**
+ * @brief 基于epoch的延迟回收
+ * @details 读多写少的数据以裸指针原子发布：读者在EpochGuard的作用域内读取指针并使用，
+ *          不修改引用计数也不加锁；写者替换指针之后把持有旧对象的shared_ptr交给Retire。
+ *          每个线程登记进入临界区时的epoch，后台回收线程等到所有在替换之前进入的读者都离开后
+ *          才释放旧对象，因此旧对象的析构总是发生在回收线程上，不会落到读者线程
+*/
+class Epoch {
+public:
+    /**
+     * @brief 进入临界区，可以嵌套，只有最外层登记epoch
+    */
+    static void Enter();
+
+    /**
+     * @brief 离开临界区
+    */
+    static void Leave();
+
+    /**
+     * @brief 交出已经被替换下来的对象
+     * @details 调用前新指针必须已经发布，obj在之后某个时刻由回收线程释放；
+     *          进程退出、回收线程停止之后交出的对象在当前线程等读者离开后释放
+    */
+    static void Retire(std::shared_ptr<const void> obj);
+
+    /**
+     * @brief 阻塞直到调用之前交出的对象都已释放
+     * @details 不能在EpochGuard的作用域内调用，否则会一直等待自己离开
+    */
+    static void Synchronize();
+
+    /**
+     * @brief 已交出但尚未释放的对象数
+    */
+    static uint64_t GetPending();
+};
+
+/**
+ * @brief 临界区的RAII封装
+*/
+class EpochGuard : Noncopyable {
+public:
+    EpochGuard() { Epoch::Enter(); }
+    ~EpochGuard() { Epoch::Leave(); }
+};
+
+} // noobnet
+
+#endif // !__NOOBNET_EPOCH_
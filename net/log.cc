@@ -1,10 +1,24 @@
 #include "log.h"
+#include "log_async.h"
+#include "log_rolling.h"
+#include "log_mmap.h"
+#include "log_binary.h"
+#include "log_console.h"
+#include "log_flight.h"
+#include "log_syslog.h"
 #include "config.h"
+#include "epoch.h"
+#include "thread.h"
 
 #include <map>
 #include <functional>
 #include <stdarg.h>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <cmath>
+#include <new>
+#include <stdlib.h>
 
 
 namespace noobnet {
@@ -49,10 +63,242 @@ LogLevel::level LogLevel::FromString(const std::string& str) {
 #undef XX
 }
 
-LogEventWrap::LogEventWrap(LogEvent::ptr val) : m_event(val) {}
+//线程本地的日志缓冲，允许少量的嵌套日志（构造日志内容时又打印日志）
+struct LogStreamLocal {
+    static const int kSlots = 4;
+    //扩展区超过该大小时归还给系统，避免偶发的超长日志长期占用内存
+    static const size_t kSpillKeep = 1024 * 1024;
+
+    struct Slot {
+        char buf[LogStream::kInlineSize];
+        char* spill = nullptr;
+        size_t spill_cap = 0;
+        bool used = false;
+    };
+
+    ~LogStreamLocal() {
+        for (int i = 0; i < kSlots; ++i) {
+            free(slots[i].spill);
+        }
+    }
+
+    Slot slots[kSlots];
+};
+
+static thread_local LogStreamLocal t_log_stream_local;
+
+LogStream::LogStream(bool local) {
+    if (!local) {
+        return;
+    }
+    for (int i = 0; i < LogStreamLocal::kSlots; ++i) {
+        LogStreamLocal::Slot& slot = t_log_stream_local.slots[i];
+        if (!slot.used) {
+            slot.used = true;
+            m_local = &slot;
+            m_buf = slot.buf;
+            m_cap = kInlineSize;
+            return;
+        }
+    }
+    //嵌套层数过多时退化为堆内存
+}
+
+LogStream::~LogStream() {
+    if (m_local) {
+        LogStreamLocal::Slot* slot = (LogStreamLocal::Slot*)m_local;
+        if (slot->spill_cap > LogStreamLocal::kSpillKeep) {
+            free(slot->spill);
+            slot->spill = nullptr;
+            slot->spill_cap = 0;
+        }
+        slot->used = false;
+    } else {
+        free(m_buf);
+    }
+}
+
+void LogStream::grow(size_t n) {
+    size_t cap = std::max(m_cap * 2, m_size + n);
+    cap = std::max(cap, (size_t)256);
+    if (m_local) {
+        LogStreamLocal::Slot* slot = (LogStreamLocal::Slot*)m_local;
+        if (m_buf == slot->buf) {
+            //从定长缓冲转存到扩展区
+            if (slot->spill_cap < cap) {
+                free(slot->spill);
+                slot->spill = (char*)malloc(cap);
+                slot->spill_cap = cap;
+            }
+            memcpy(slot->spill, m_buf, m_size);
+        } else {
+            slot->spill = (char*)realloc(slot->spill, cap);
+            slot->spill_cap = cap;
+        }
+        m_buf = slot->spill;
+        m_cap = slot->spill_cap;
+    } else {
+        m_buf = (char*)realloc(m_buf, cap);
+        m_cap = cap;
+    }
+}
+
+void LogStream::appendf(const char* fmt, va_list al) {
+    va_list ap;
+    va_copy(ap, al);
+    int len = vsnprintf(m_buf + m_size, m_cap - m_size, fmt, ap);
+    va_end(ap);
+    if (len < 0) {
+        return;
+    }
+    //vsnprintf需要多一个字节写结尾的'\0'
+    if ((size_t)len >= m_cap - m_size) {
+        grow(len + 1);
+        vsnprintf(m_buf + m_size, m_cap - m_size, fmt, al);
+    }
+    m_size += len;
+}
+
+template<class T>
+void LogStream::appendInteger(T v) {
+    char buf[32];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    bool neg = v < 0;
+    //负数逐位取反，避免最小值取负溢出
+    do {
+        int d = (int)(v % 10);
+        *--p = '0' + (neg ? -d : d);
+        v /= 10;
+    } while (v != 0);
+    if (neg) {
+        *--p = '-';
+    }
+    append(p, end - p);
+}
+
+LogStream& LogStream::operator<<(bool v) {
+    append(v ? "1" : "0", 1);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(char v) {
+    append(&v, 1);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(signed char v) {
+    append((const char*)&v, 1);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(unsigned char v) {
+    append((const char*)&v, 1);
+    return *this;
+}
+
+#define XX(type) \
+    LogStream& LogStream::operator<<(type v) { \
+        appendInteger(v); \
+        return *this; \
+    }
+
+XX(short);
+XX(unsigned short);
+XX(int);
+XX(unsigned int);
+XX(long);
+XX(unsigned long);
+XX(long long);
+XX(unsigned long long);
+#undef XX
+
+//与std::ostream默认的6位有效数字保持一致
+LogStream& LogStream::operator<<(float v) {
+    return *this << (double)v;
+}
+
+LogStream& LogStream::operator<<(double v) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%g", v);
+    append(buf, len);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(long double v) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%Lg", v);
+    append(buf, len);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const void* v) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%p", v);
+    append(buf, len);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const char* v) {
+    if (v) {
+        append(v, strlen(v));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const std::string& v) {
+    append(v.c_str(), v.size());
+    return *this;
+}
+
+LogStream& LogStream::operator<<(std::ostream& (*pf)(std::ostream&)) {
+    typedef std::ostream& (*manip)(std::ostream&);
+    if (pf == (manip)std::endl) {
+        append("\n", 1);
+    } else if (pf == (manip)std::ends) {
+        append("\0", 1);
+    }
+    return *this;
+}
+
+LogEventWrap::LogEventWrap(LogEvent::ptr val) : m_event(val.get()), m_owner(val) {}
+
+LogEventWrap::LogEventWrap(const char* file, int32_t line, uint32_t elapse,
+            uint32_t thread, uint32_t fiber, uint64_t time_us,
+            std::shared_ptr<Logger> logger, LogLevel::level level,
+            bool forced)
+    :m_local(true) {
+    LogEvent* event = new (&m_storage) LogEvent(file, line, elapse,
+                thread, fiber, time_us / 1000000, logger, level, true);
+    event->setTimeUs(time_us);
+    event->setForced(forced);
+    m_event = event;
+}
+
+LogEventWrap::LogEventWrap(const char* file, int32_t line,
+            std::shared_ptr<Logger> logger, LogLevel::level level,
+            bool forced, bool record_only)
+    :m_local(true)
+    ,m_recordOnly(record_only) {
+    uint64_t mono = GetMonotonicUS();
+    LogEvent* event = new (&m_storage) LogEvent(file, line, MonotonicToElapsedMS(mono),
+                Thread::GetId(), GetFiberId(), 0, logger, level, true);
+    event->setTimeUs(MonotonicToRealUS(mono));
+    event->setThreadName(Thread::GetNameCStr());
+    event->setForced(forced);
+    m_event = event;
+}
 
 LogEventWrap::~LogEventWrap() {
-    m_event->getLogger()->log(m_event->getLevel(), m_event);
+    if (LogSite::IsRecording()) {
+        FlightRecorder::Record(*m_event);
+    }
+    if (!m_recordOnly) {
+        m_event->getLogger()->log(m_event->getLevel(), *m_event);
+    }
+    if (m_local) {
+        m_event->~LogEvent();
+    }
 }
 
 void LogEvent::format(const char* fmt, ...) {
@@ -63,194 +309,814 @@ void LogEvent::format(const char* fmt, ...) {
 }
 
 void LogEvent::format(const char* fmt, va_list al) {
-    char* buf = nullptr;
-    int len = vasprintf(&buf, fmt, al);
-    if (len != -1) {
-        m_ss << std::string(buf, len);
-        free(buf);
+    render();
+    m_ss.appendf(fmt, al);
+}
+
+void LogEvent::formatLiteral(const char* fmt, ...) {
+    va_list al;
+    va_start(al, fmt);
+    if (LogArgs::IsCapturing() && !m_fmt && m_ss.size() == 0) {
+        //有二进制appender时只编码参数，不做文本格式化
+        va_list ap;
+        va_copy(ap, al);
+        bool ok = LogArgs::Encode(m_ss, fmt, ap);
+        va_end(ap);
+        if (ok) {
+            m_fmt = fmt;
+            m_argsSize = m_ss.size();
+            va_end(al);
+            return;
+        }
+        //含有不支持的转换说明，退回文本
+        m_ss.clear();
+    }
+    format(fmt, al);
+    va_end(al);
+}
+
+const char* LogEvent::printText(const char* fmt, bool placeholder) {
+    const char* p = fmt;
+    while ((p = strpbrk(p, "{}"))) {
+        if (p[0] == p[1]) {
+            m_ss.append(fmt, p - fmt + 1);
+            p += 2;
+            fmt = p;
+        } else if (placeholder && p[0] == '{' && p[1] == '}') {
+            m_ss.append(fmt, p - fmt);
+            return p + 2;
+        } else {
+            ++p;
+        }
     }
+    m_ss.append(fmt, strlen(fmt));
+    return nullptr;
+}
+
+void LogEvent::renderArgs() const {
+    m_rendered = true;
+    //生成过程中m_ss可能扩容，先写入临时缓冲
+    LogStream text(true);
+    LogArgs::Render(m_fmt, m_ss.data(), m_argsSize, text);
+    m_ss.append(text.data(), text.size());
 }
 
-std::stringstream& LogEventWrap::getSS() {
+LogStream& LogEventWrap::getSS() {
     return m_event->getSS();
 }
 
-class MessegeFormatItem : public LogFormatter::FormatterItem {
+class LogFormatter::DateFormat {
  public:
-    MessegeFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << event->getContent();
-    }
-};
- 
-class LevelFormatItem : public LogFormatter::FormatterItem {
- public:
-    LevelFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << LogLevel::ToString(level);
+    //秒以下字段的最大个数
+    static const int kMaxHoles = 4;
+
+    DateFormat(const std::string& format)
+        :m_id(++s_id) {
+        //按 %3 %6 切分，其余部分交给strftime
+        std::string seg;
+        for (size_t i = 0; i < format.size(); ++i) {
+            if (format[i] == '%' && i + 1 < format.size()) {
+                char c = format[i + 1];
+                if ((c == '3' || c == '6') && (int)m_holes.size() < kMaxHoles) {
+                    m_segments.push_back(seg);
+                    m_holes.push_back(c - '0');
+                    seg.clear();
+                    ++i;
+                    continue;
+                }
+                //%%原样交给strftime
+                seg.append(format, i, 2);
+                ++i;
+                continue;
+            }
+            seg.append(1, format[i]);
+        }
+        m_segments.push_back(seg);
     }
-};
 
-class ElapseFormatItem : public LogFormatter::FormatterItem {
- public:
-    ElapseFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << event->getElapse();
+    void format(LogStream& buf, uint64_t sec, uint32_t usec) {
+        Cache& c = t_cache[m_id % kCacheSize];
+        if (c.id != m_id || c.sec != sec) {
+            render(c, sec);
+        }
+        size_t begin = 0;
+        for (size_t i = 0; i < m_holes.size(); ++i) {
+            buf.append(c.buf + begin, c.ends[i] - begin);
+            begin = c.ends[i];
+            char digits[6];
+            if (m_holes[i] == 3) {
+                uint32_t ms = usec / 1000;
+                digits[0] = '0' + ms / 100;
+                digits[1] = '0' + ms / 10 % 10;
+                digits[2] = '0' + ms % 10;
+                buf.append(digits, 3);
+            } else {
+                uint32_t v = usec;
+                for (int j = 5; j >= 0; --j) {
+                    digits[j] = '0' + v % 10;
+                    v /= 10;
+                }
+                buf.append(digits, 6);
+            }
+        }
+        buf.append(c.buf + begin, c.len - begin);
     }
-};
+ private:
+    static const int kCacheSize = 8;
+    static const size_t kBufSize = 128;
+
+    //线程本地的渲染缓存，按DateFormat的id直接映射
+    struct Cache {
+        uint64_t id;
+        uint64_t sec;
+        char buf[kBufSize];
+        uint16_t len;
+        uint16_t ends[kMaxHoles];
+    };
 
-class NameFormatItem : public LogFormatter::FormatterItem {
- public:
-    NameFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << logger->getName();
+    void render(Cache& c, uint64_t sec) {
+        struct tm tm;
+        time_t t = sec;
+        localtime_r(&t, &tm);
+        size_t len = 0;
+        for (size_t i = 0; i < m_segments.size(); ++i) {
+            if (!m_segments[i].empty()) {
+                len += strftime(c.buf + len, kBufSize - len, m_segments[i].c_str(), &tm);
+            }
+            if (i < m_holes.size()) {
+                c.ends[i] = len;
+            }
+        }
+        c.len = len;
+        c.id = m_id;
+        c.sec = sec;
     }
-};
+ private:
+    uint64_t m_id;
+    std::vector<std::string> m_segments;
+    std::vector<int> m_holes;
 
-class ThreadIdFormatItem : public LogFormatter::FormatterItem {
- public:
-    ThreadIdFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << event->getThreadID();
-    }
+    static std::atomic<uint64_t> s_id;
+    static thread_local Cache t_cache[kCacheSize];
 };
 
-class FiberIdFormatItem : public LogFormatter::FormatterItem {
- public:
-    FiberIdFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << event->getFiberID();
+std::atomic<uint64_t> LogFormatter::DateFormat::s_id {0};
+thread_local LogFormatter::DateFormat::Cache LogFormatter::DateFormat::t_cache[kCacheSize];
+
+//JSON字符串转义，非ASCII的UTF-8字节原样输出
+static void AppendJsonString(LogStream& buf, const char* str, size_t len) {
+    static const char s_hex[] = "0123456789abcdef";
+    buf.append("\"", 1);
+    size_t begin = 0;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = str[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        buf.append(str + begin, i - begin);
+        begin = i + 1;
+        switch (c) {
+        case '"':  buf.append("\\\"", 2); break;
+        case '\\': buf.append("\\\\", 2); break;
+        case '\n': buf.append("\\n", 2); break;
+        case '\r': buf.append("\\r", 2); break;
+        case '\t': buf.append("\\t", 2); break;
+        case '\b': buf.append("\\b", 2); break;
+        case '\f': buf.append("\\f", 2); break;
+        default: {
+            char esc[6] = {'\\', 'u', '0', '0', s_hex[c >> 4], s_hex[c & 0xf]};
+            buf.append(esc, 6);
+        }
+        }
     }
-};
+    buf.append(str + begin, len - begin);
+    buf.append("\"", 1);
+}
 
-class DateTimeFormatItem : public LogFormatter::FormatterItem {
- public:
-    DateTimeFormatItem(const std::string& format = "%Y-%M-%D %H:%M:%S") : m_format(format) {
-        if (m_format.empty()) {
-            m_format = "%Y-%M-%D %H:%M:%S";
-        }
+//key=value形式中需要加引号的值
+static bool NeedQuote(const char* str, size_t len) {
+    if (len == 0) {
+        return true;
     }
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        struct tm tm;
-        time_t time = event->getTime();
-        localtime_r(&time, &tm);
-        char buf[64];
-        strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-        os << event->getTime();
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = str[i];
+        if (c <= ' ' || c == '"' || c == '=' || c == '\\') {
+            return true;
+        }
     }
- private:
-    std::string m_format;
-};
+    return false;
+}
 
-class LineFormatItem : public LogFormatter::FormatterItem {
- public:
-    LineFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << event->getLineID();
+static void AppendDouble(LogStream& buf, double v, bool json) {
+    if (!std::isfinite(v)) {
+        const char* str = std::isnan(v) ? "nan" : (v > 0 ? "inf" : "-inf");
+        if (json) {
+            AppendJsonString(buf, str, strlen(str));
+        } else {
+            buf << str;
+        }
+        return;
     }
-};
-
-class NextLineFormatItem : public LogFormatter::FormatterItem {
- public:
-    NextLineFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << std::endl;
+    //优先用15位有效数字，不能还原时再用17位
+    char tmp[32];
+    int len = snprintf(tmp, sizeof(tmp), "%.15g", v);
+    if (strtod(tmp, nullptr) != v) {
+        len = snprintf(tmp, sizeof(tmp), "%.17g", v);
     }
-};
+    buf.append(tmp, len);
+}
 
-class FileNameFormatItem : public LogFormatter::FormatterItem {
- public:
-    FileNameFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << event->getFile();
+static void AppendFieldValue(LogStream& buf, const LogFields& fields,
+                             const LogFields::Field& f, bool json) {
+    switch (f.type) {
+    case LogFields::Field::INT:
+        buf << (long long)f.i;
+        break;
+    case LogFields::Field::UINT:
+        buf << (unsigned long long)f.u;
+        break;
+    case LogFields::Field::DOUBLE:
+        AppendDouble(buf, f.d, json);
+        break;
+    case LogFields::Field::BOOL:
+        buf << (f.b ? "true" : "false");
+        break;
+    case LogFields::Field::STRING:
+        if (json || NeedQuote(fields.str(f), f.str.len)) {
+            AppendJsonString(buf, fields.str(f), f.str.len);
+        } else {
+            buf.append(fields.str(f), f.str.len);
+        }
+        break;
     }
-};
+}
 
-class TabFormatItem : public LogFormatter::FormatterItem {
- public:
-    TabFormatItem(const std::string& str = "") {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << "\t";
+//key1=value1 key2=value2
+static void AppendFieldsText(LogStream& buf, const LogFields& fields) {
+    for (size_t i = 0; i < fields.size(); ++i) {
+        const LogFields::Field& f = fields[i];
+        if (i) {
+            buf.append(" ", 1);
+        }
+        buf.append(fields.key(f), f.keyLen);
+        buf.append("=", 1);
+        AppendFieldValue(buf, fields, f, false);
     }
-};
+}
 
-class StirngFormatItem : public LogFormatter::FormatterItem {
- public:
-    StirngFormatItem(const std::string& fmt) : m_string(fmt) {}
-    void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) override {
-        os << m_string;
+//{"time":...,"level":...,"logger":...,"thread":...,"thread_name":...,"fiber":...,
+// "file":...,"line":...,"message":...,"fields":{...}}
+static void AppendJson(LogStream& buf, LogFormatter::DateFormat& date, const std::shared_ptr<Logger>& logger,
+                       LogLevel::level level, const LogEvent& event) {
+    buf.append("{\"time\":\"", 9);
+    date.format(buf, event.getTime(), event.getUsec());
+    buf.append("\",\"level\":\"", 11);
+    buf << LogLevel::ToString(level);
+    buf.append("\",\"logger\":", 11);
+    AppendJsonString(buf, logger->getName().c_str(), logger->getName().size());
+    buf.append(",\"thread\":", 10);
+    buf << event.getThreadID();
+    buf.append(",\"thread_name\":", 15);
+    AppendJsonString(buf, event.getThreadName(), strlen(event.getThreadName()));
+    buf.append(",\"fiber\":", 9);
+    buf << event.getFiberID();
+    buf.append(",\"file\":", 8);
+    const char* file = event.getFile() ? event.getFile() : "";
+    AppendJsonString(buf, file, strlen(file));
+    buf.append(",\"line\":", 8);
+    buf << event.getLineID();
+    buf.append(",\"message\":", 11);
+    AppendJsonString(buf, event.getContentData(), event.getContentSize());
+    const LogFields& fields = event.getFields();
+    if (!fields.empty()) {
+        buf.append(",\"fields\":{", 11);
+        for (size_t i = 0; i < fields.size(); ++i) {
+            const LogFields::Field& f = fields[i];
+            if (i) {
+                buf.append(",", 1);
+            }
+            AppendJsonString(buf, fields.key(f), f.keyLen);
+            buf.append(":", 1);
+            AppendFieldValue(buf, fields, f, true);
+        }
+        buf.append("}", 1);
     }
- private:
-    std::string m_string;
-};
+    buf.append("}", 1);
+}
+
+//JSON中默认的时间格式
+static const char* s_json_date_format = "%Y-%m-%dT%H:%M:%S.%6";
 
 LogEvent::LogEvent(const char* file, int32_t line, uint32_t elapse, 
             uint32_t thread, uint32_t fiber, uint64_t time,
-            std::shared_ptr<Logger> logger, LogLevel::level level) 
+            std::shared_ptr<Logger> logger, LogLevel::level level,
+            bool local)
             :m_file(file),
              m_line(line),
              m_elapse(elapse),
              m_threadID(thread),
              m_fiberID(fiber),
              m_time(time),
+             m_ss(local),
              m_logger(logger),
              m_level(level) {
 
 }
 
-Logger::Logger(const std::string name) : m_name(name) , m_level(LogLevel::DEBUG) {
+LogFields::~LogFields() {
+    if (m_fields != m_inlineFields) {
+        free(m_fields);
+    }
+    if (m_data != m_inlineData) {
+        free(m_data);
+    }
+}
+
+uint32_t LogFields::store(const char* data, size_t len) {
+    if (m_dataSize + len > m_dataCap) {
+        size_t cap = std::max(m_dataCap * 2, m_dataSize + len);
+        if (m_data == m_inlineData) {
+            char* p = (char*)malloc(cap);
+            memcpy(p, m_data, m_dataSize);
+            m_data = p;
+        } else {
+            m_data = (char*)realloc(m_data, cap);
+        }
+        m_dataCap = cap;
+    }
+    memcpy(m_data + m_dataSize, data, len);
+    uint32_t offset = m_dataSize;
+    m_dataSize += len;
+    return offset;
+}
+
+LogFields::Field& LogFields::push(const char* key, Field::Type type) {
+    if (m_size == m_cap) {
+        size_t cap = m_cap * 2;
+        if (m_fields == m_inlineFields) {
+            Field* p = (Field*)malloc(cap * sizeof(Field));
+            memcpy(p, m_fields, m_size * sizeof(Field));
+            m_fields = p;
+        } else {
+            m_fields = (Field*)realloc(m_fields, cap * sizeof(Field));
+        }
+        m_cap = cap;
+    }
+    size_t len = std::min(strlen(key), (size_t)UINT16_MAX);
+    Field& f = m_fields[m_size++];
+    f.type = type;
+    f.keyLen = len;
+    f.keyOffset = store(key, len);
+    return f;
+}
+
+void LogFields::add(const char* key, const char* v, size_t len) {
+    uint32_t offset = store(v, len);
+    Field& f = push(key, Field::STRING);
+    f.str.offset = offset;
+    f.str.len = len;
+}
+
+//调用点登记表，调用点本身是静态变量，只在登记和修改开关时加锁
+struct LogSiteRegistry {
+    Mutex mutex;
+    LogSite* head = nullptr;
+    //"文件" 或 "文件:行号" -> 状态
+    std::map<std::string, LogSite::State> states;
+
+    LogSite::State lookup(const LogSite* site) const {
+        if (states.empty()) {
+            return LogSite::FOLLOW;
+        }
+        std::string file = site->getFile() ? site->getFile() : "";
+        auto it = states.find(file + ":" + std::to_string(site->getLine()));
+        if (it == states.end()) {
+            it = states.find(file);
+        }
+        return it == states.end() ? LogSite::FOLLOW : it->second;
+    }
+};
+
+std::atomic<uint8_t> LogSite::s_flags {0};
+std::atomic<uint64_t> LogSite::s_filterEpoch {0};
+
+static_assert(alignof(Logger) >= 8 && LogLevel::FATAL < 8, "FilterKey packs the level into the logger address");
+
+//从不释放，进程退出时析构的logger仍然要清空缓存
+static LogSiteRegistry& GetLogSiteRegistry() {
+    static LogSiteRegistry* s_registry = new LogSiteRegistry;
+    return *s_registry;
+}
+
+int LogSite::checkSlow(const std::shared_ptr<Logger>& logger, LogLevel::level level) {
+    //先读epoch再计算，计算期间的清空会让本次结果不进缓存
+    uint64_t epoch = s_filterEpoch.load();
+    int state = m_state.load(std::memory_order_relaxed);
+    if (state == UNREGISTERED) {
+        LogSiteRegistry& reg = GetLogSiteRegistry();
+        Mutex::Lock lock(reg.mutex);
+        state = m_state.load(std::memory_order_relaxed);
+        if (state == UNREGISTERED) {
+            m_next = reg.head;
+            reg.head = this;
+            state = reg.lookup(this);
+            m_state.store(state, std::memory_order_relaxed);
+        }
+    }
+    if (state == FOLLOW && logger->getLevel() > level) {
+        //统计和飞行记录器都关闭时结果只取决于级别，可以缓存
+        if (!s_flags.load(std::memory_order_relaxed)) {
+            cacheFiltered(logger.get(), level, epoch);
+            return 0;
+        }
+        return levelFiltered(logger);
+    }
+    if (state == FORCE_OFF) {
+        if (!s_flags.load(std::memory_order_relaxed)) {
+            cacheFiltered(logger.get(), level, epoch);
+            return 0;
+        }
+        return filtered();
+    }
+    //限速和采样的结果每次不同，不缓存
+    if (logger->isThrottled() && !throttle(logger, level)) {
+        return filtered();
+    }
+    return state;
+}
+
+void LogSite::cacheFiltered(const Logger* logger, LogLevel::level level, uint64_t epoch) {
+    m_filtered.store(FilterKey(logger, level));
+    //写入之后再检查一次，清空发生在计算期间时撤销，避免留下过期的结果
+    if (s_filterEpoch.load() != epoch) {
+        m_filtered.store(0);
+    }
+}
+
+void LogSite::ClearFiltered() {
+    s_filterEpoch.fetch_add(1);
+    LogSiteRegistry& reg = GetLogSiteRegistry();
+    Mutex::Lock lock(reg.mutex);
+    for (LogSite* i = reg.head; i; i = i->m_next) {
+        i->m_filtered.store(0, std::memory_order_relaxed);
+    }
+}
+
+//汇总输出的最小间隔
+static const uint64_t s_suppress_report_us = 1000 * 1000;
+
+bool LogSite::throttle(const std::shared_ptr<Logger>& logger, LogLevel::level level) {
+    uint32_t sample = logger->getSampleRate();
+    if (sample > 1 && m_hits.fetch_add(1, std::memory_order_relaxed) % sample != 0) {
+        suppress(logger, level, GetMonotonicUS());
+        return false;
+    }
+    uint32_t rate = logger->getRateLimit();
+    if (rate) {
+        //GCRA：每条消息把理论到达时间推后一个间隔，超前当前时间超过burst个间隔即限流
+        uint64_t now = GetMonotonicUS();
+        uint64_t interval = std::max(1000000u / rate, 1u);
+        uint64_t limit = interval * std::max(logger->getBurst(), 1u);
+        uint64_t tat = m_tat.load(std::memory_order_relaxed);
+        while (true) {
+            uint64_t next = std::max(tat, now) + interval;
+            if (next > now + limit) {
+                suppress(logger, level, now);
+                return false;
+            }
+            if (m_tat.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+    }
+    if (m_suppressed.load(std::memory_order_relaxed)) {
+        report(logger, level, GetMonotonicUS());
+    }
+    return true;
+}
+
+void LogSite::suppress(const std::shared_ptr<Logger>& logger, LogLevel::level level, uint64_t now) {
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    logger->getMetrics().add(LogMetrics::THROTTLED);
+    report(logger, level, now);
+}
+
+void LogSite::report(const std::shared_ptr<Logger>& logger, LogLevel::level level, uint64_t now) {
+    uint64_t last = m_lastReport.load(std::memory_order_relaxed);
+    if (last == 0) {
+        //第一次丢弃只开始计时
+        m_lastReport.compare_exchange_strong(last, now, std::memory_order_relaxed);
+        return;
+    }
+    if (now - last < s_suppress_report_us
+            || !m_lastReport.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        return;
+    }
+    uint64_t n = m_suppressed.exchange(0, std::memory_order_relaxed);
+    if (n) {
+        LogEventWrap(m_file, m_line, logger, level, true).getSS()
+            << "suppressed " << n << " messages";
+    }
+}
+
+void LogSite::SetState(const std::string& key, State state) {
+    s_filterEpoch.fetch_add(1);
+    LogSiteRegistry& reg = GetLogSiteRegistry();
+    Mutex::Lock lock(reg.mutex);
+    if (state == FOLLOW) {
+        reg.states.erase(key);
+    } else {
+        reg.states[key] = state;
+    }
+    for (LogSite* i = reg.head; i; i = i->m_next) {
+        i->m_state.store(reg.lookup(i), std::memory_order_relaxed);
+        i->m_filtered.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LogSite::SetStates(const std::map<std::string, State>& states) {
+    s_filterEpoch.fetch_add(1);
+    LogSiteRegistry& reg = GetLogSiteRegistry();
+    Mutex::Lock lock(reg.mutex);
+    reg.states = states;
+    for (LogSite* i = reg.head; i; i = i->m_next) {
+        i->m_state.store(reg.lookup(i), std::memory_order_relaxed);
+        i->m_filtered.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::map<std::string, LogSite::State> LogSite::ListSites() {
+    std::map<std::string, State> sites;
+    LogSiteRegistry& reg = GetLogSiteRegistry();
+    Mutex::Lock lock(reg.mutex);
+    for (LogSite* i = reg.head; i; i = i->m_next) {
+        sites[std::string(i->m_file ? i->m_file : "") + ":" + std::to_string(i->m_line)]
+            = i->getState();
+    }
+    return sites;
+}
+
+LogMetrics::LogMetrics() {
+    void* p = nullptr;
+    if (posix_memalign(&p, sizeof(Shard), sizeof(Shard) * kShards) != 0) {
+        throw std::bad_alloc();
+    }
+    m_shards = (Shard*)p;
+    for (size_t i = 0; i < kShards; ++i) {
+        for (auto& v : m_shards[i].values) {
+            new (&v) std::atomic<uint64_t>(0);
+        }
+    }
+}
+
+LogMetrics::~LogMetrics() {
+    free(m_shards);
+}
+
+uint64_t LogMetrics::get(Counter c) const {
+    uint64_t v = 0;
+    for (size_t i = 0; i < kShards; ++i) {
+        v += m_shards[i].values[c].load(std::memory_order_relaxed);
+    }
+    return v;
+}
+
+const char* LogMetrics::ToString(Counter c) {
+    switch (c) {
+#define XX(name, str) \
+        case name: \
+            return #str;
+    XX(EVENTS, events);
+    XX(FILTERED, filtered);
+    XX(THROTTLED, throttled);
+    XX(BYTES, bytes);
+    XX(ERRORS, errors);
+    XX(FORMAT_NS, format_ns);
+    XX(APPEND_NS, append_ns);
+#undef XX
+        default:
+            return "unknown";
+    }
+}
+
+static thread_local bool t_log_metrics_timing = false;
+
+bool LogMetrics::IsTiming() {
+    return t_log_metrics_timing;
+}
+
+void LogMetrics::SetTiming(bool v) {
+    t_log_metrics_timing = v;
+}
+
+uint64_t LogMetrics::NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+//空闲的独占分片
+struct LogMetricsShards {
+    Mutex mutex;
+    std::vector<uint32_t> free;
+
+    LogMetricsShards() {
+        for (uint32_t i = LogMetrics::kShards - 1; i > 0; --i) {
+            free.push_back(i - 1);
+        }
+    }
+};
+
+static LogMetricsShards& GetLogMetricsShards() {
+    static LogMetricsShards* s_shards = new LogMetricsShards;
+    return *s_shards;
+}
+
+//线程退出时归还独占的分片
+struct LogMetricsShardHolder {
+    uint32_t* shard = nullptr;
+
+    ~LogMetricsShardHolder() {
+        if (!shard || *shard == LogMetrics::kShards) {
+            return;
+        }
+        LogMetricsShards& shards = GetLogMetricsShards();
+        Mutex::Lock lock(shards.mutex);
+        shards.free.push_back(*shard - 1);
+        //之后的统计写入共用分片
+        *shard = LogMetrics::kShards;
+    }
+};
+
+static thread_local LogMetricsShardHolder t_log_metrics_shard;
+
+void LogMetrics::AcquireShard(uint32_t* shard) {
+    LogMetricsShards& shards = GetLogMetricsShards();
+    Mutex::Lock lock(shards.mutex);
+    if (shards.free.empty()) {
+        *shard = kShards;
+        return;
+    }
+    *shard = shards.free.back() + 1;
+    shards.free.pop_back();
+    t_log_metrics_shard.shard = shard;
+}
+
+//从1开始，打包的解析结果初始为0，保证首次读取时会解析
+std::atomic<uint64_t> Logger::s_generation {1};
+
+//所有空的appender快照共用这一个，从不释放，替换时不需要延迟回收
+static const std::shared_ptr<const Logger::AppenderList>& GetEmptyAppenderList() {
+    static std::shared_ptr<const Logger::AppenderList>* s_empty =
+        new std::shared_ptr<const Logger::AppenderList>(std::make_shared<const Logger::AppenderList>());
+    return *s_empty;
+}
+
+Logger::Logger(const std::string name)
+    :m_name(name)
+    ,m_level(LogLevel::UNKOWN)
+    ,m_resolvedLevel(0)
+    ,m_appenders(GetEmptyAppenderList())
+    ,m_appenderList(m_appenders.get())
+    ,m_rateLimit(0)
+    ,m_burst(0)
+    ,m_sampleRate(0)
+    ,m_throttled(false) {
     m_formatter.reset(new LogFormatter("%d%T[%p]%T%c%T%m%T%n"));
 }
 
-//TODO 看
-void Logger::log(LogLevel::level level, LogEvent::ptr event) {
-    if (level >= m_level) {
-        auto self = shared_from_this();
-        Mutex::Lock lock(m_mutex);
-        if (!m_appenders.empty()) {
-            for (auto &i : m_appenders) {
-                i->log(self , level, event);
-            } 
-        } else if (m_root) {
-            m_root->log(level, event);
+Logger::~Logger() {
+    LogSite::ClearFiltered();
+}
+
+std::shared_ptr<const Logger::AppenderList> Logger::getAppenders() const {
+    Mutex::Lock lock(m_mutex);
+    return m_appenders;
+}
+
+void Logger::publish(std::shared_ptr<const AppenderList> list) {
+    if (list->empty()) {
+        list = GetEmptyAppenderList();
+    }
+    std::shared_ptr<const AppenderList> old = m_appenders;
+    m_appenders = list;
+    m_appenderList.store(list.get());
+    //正在遍历旧快照的线程离开临界区之后，旧快照和只被它持有的appender在回收线程上析构
+    if (old != GetEmptyAppenderList()) {
+        Epoch::Retire(old);
+    }
+}
+
+void Logger::setLevel(LogLevel::level val) {
+    m_level.store(val, std::memory_order_relaxed);
+    //子logger可能继承这个级别，全部重新解析
+    s_generation.fetch_add(1, std::memory_order_acq_rel);
+    LogSite::ClearFiltered();
+}
+
+LogLevel::level Logger::resolveLevel() const {
+    //先读代数再解析，解析期间发生的修改会让缓存的代数立即过期
+    uint64_t generation = s_generation.load(std::memory_order_acquire);
+    LogLevel::level level = LogLevel::DEBUG;
+    for (const Logger* i = this; i; i = i->m_parent.get()) {
+        LogLevel::level own = i->getOwnLevel();
+        if (own != LogLevel::UNKOWN) {
+            level = own;
+            break;
+        }
+    }
+    m_resolvedLevel.store((generation << 8) | level, std::memory_order_release);
+    return level;
+}
+
+const Logger::AppenderList* Logger::resolveAppenders() const {
+    const AppenderList* list = m_appenderList.load();
+    for (const Logger* i = m_parent.get(); list->empty() && i; i = i->m_parent.get()) {
+        list = i->m_appenderList.load();
+    }
+    return list;
+}
+
+void Logger::log(LogLevel::level level, const LogEvent& event) {
+    if (level < getLevel() && !event.isForced()) {
+        m_metrics.add(LogMetrics::FILTERED);
+        return;
+    }
+    m_metrics.add(LogMetrics::EVENTS);
+    //临界区内读到的快照不会被释放，appender里嵌套的日志调用同样如此
+    EpochGuard guard;
+    const AppenderList* list = resolveAppenders();
+    if (!list->empty()) {
+        //事件本身持有logger时直接复用，省去一次引用计数
+        Logger::ptr self = event.getLogger().get() == this
+                ? event.getLogger() : shared_from_this();
+        //嵌套调用时只由最外层计时
+        bool timing = !LogMetrics::IsTiming() && LogMetrics::Sample();
+        if (timing) {
+            LogMetrics::SetTiming(true);
+        }
+        for (auto &i : *list) {
+            if (level >= i->m_level) {
+                i->m_metrics.add(LogMetrics::EVENTS);
+            }
+            if (timing) {
+                uint64_t begin = LogMetrics::NowNs();
+                i->log(self, level, event);
+                uint64_t ns = (LogMetrics::NowNs() - begin) * LogMetrics::kSampleRate;
+                i->m_metrics.add(LogMetrics::APPEND_NS, ns);
+                m_metrics.add(LogMetrics::APPEND_NS, ns);
+            } else {
+                i->log(self, level, event);
+            }
+        }
+        if (timing) {
+            LogMetrics::SetTiming(false);
         }
     }
 }
 
 void Logger::debug(Logger::ptr logger, LogEvent::ptr event) {
-    log(LogLevel::DEBUG, event);
+    log(LogLevel::DEBUG, *event);
 }
 
 void Logger::warn(Logger::ptr logger, LogEvent::ptr event) {
-    log(LogLevel::WARN, event);
+    log(LogLevel::WARN, *event);
 }
 
 void Logger::error(Logger::ptr logger, LogEvent::ptr event) {
-    log(LogLevel::ERROR, event);
+    log(LogLevel::ERROR, *event);
 }
 
 void Logger::info(Logger::ptr logger, LogEvent::ptr event) {
-    log(LogLevel::INFO, event);
+    log(LogLevel::INFO, *event);
 }
 
 void Logger::fatal(Logger::ptr logger, LogEvent::ptr event) {
-    log(LogLevel::FATAL, event);
+    log(LogLevel::FATAL, *event);
 }
 
 void Logger::addAppender(LogAppender::ptr appender) {
     Mutex::Lock lock(m_mutex);
-    if (!appender->getFormater()) {
-        appender->setFormater(m_formatter);
+    {
+        //继承logger的formatter，但不标记为appender自有，logger修改formatter时一并更新
+        Mutex::Lock ll(appender->m_mutex);
+        if (!appender->m_formatter) {
+            appender->m_formatter = m_formatter;
+        }
     }
-    m_appenders.push_back(appender);
+    std::shared_ptr<AppenderList> list(new AppenderList(*m_appenders));
+    list->push_back(appender);
+    publish(list);
 }
 
 void Logger::delAppender(LogAppender::ptr appender) {
     Mutex::Lock lock(m_mutex);
-    for (auto i = m_appenders.begin();
-        i != m_appenders.end(); ++i) {
+    std::shared_ptr<AppenderList> list(new AppenderList(*m_appenders));
+    for (auto i = list->begin();
+        i != list->end(); ++i) {
         if (*i == appender) {
-            m_appenders.erase(i);
+            list->erase(i);
+            publish(list);
             break;
         }
     }
@@ -258,21 +1124,61 @@ void Logger::delAppender(LogAppender::ptr appender) {
 
 void Logger::clearAppenders() {
     Mutex::Lock lock(m_mutex);
-    m_appenders.clear();
+    publish(GetEmptyAppenderList());
+}
+
+void Logger::updateAppenders(const AppenderList& del, const AppenderList& add) {
+    if (del.empty() && add.empty()) {
+        return;
+    }
+    Mutex::Lock lock(m_mutex);
+    std::shared_ptr<AppenderList> list(new AppenderList);
+    list->reserve(m_appenders->size() + add.size());
+    for (auto& i : *m_appenders) {
+        if (std::find(del.begin(), del.end(), i) == del.end()) {
+            list->push_back(i);
+        }
+    }
+    for (auto& i : add) {
+        Mutex::Lock ll(i->m_mutex);
+        if (!i->m_formatter) {
+            i->m_formatter = m_formatter;
+        }
+        list->push_back(i);
+    }
+    publish(list);
+}
+
+void Logger::setRateLimit(uint32_t rate, uint32_t burst) {
+    m_burst.store(burst ? burst : rate, std::memory_order_relaxed);
+    m_rateLimit.store(rate, std::memory_order_relaxed);
+    m_throttled.store(rate || getSampleRate() > 1, std::memory_order_relaxed);
+}
+
+void Logger::setSampleRate(uint32_t n) {
+    m_sampleRate.store(n, std::memory_order_relaxed);
+    m_throttled.store(getRateLimit() || n > 1, std::memory_order_relaxed);
 }
 
 std::string Logger::toYamlString() {
     Mutex::Lock lock(m_mutex);
     YAML::Node node;
     node["name"] = m_name;
-    if (m_level != LogLevel::UNKOWN) {
-        node["level"] = LogLevel::ToString(m_level);
+    if (getOwnLevel() != LogLevel::UNKOWN) {
+        node["level"] = LogLevel::ToString(getOwnLevel());
+    }
+    if (getRateLimit()) {
+        node["rate_limit"] = getRateLimit();
+        node["burst"] = getBurst();
+    }
+    if (getSampleRate() > 1) {
+        node["sample"] = getSampleRate();
     }
     if (m_formatter) {
         node["formatter"] = m_formatter->getPattern();     
     }
 
-    for (auto& i : m_appenders) {
+    for (auto& i : *m_appenders) {
         node["appenders"].push_back(YAML::Load(i->toYamlString()));
     }
     std::stringstream ss;
@@ -280,6 +1186,26 @@ std::string Logger::toYamlString() {
     return ss.str();
 }
 
+void LogAppender::formatEvent(const LogFormatter::ptr& fmt, LogStream& buf, const std::shared_ptr<Logger>& logger,
+                              LogLevel::level level, const LogEvent& event) {
+    size_t size = buf.size();
+    if (LogMetrics::IsTiming()) {
+        uint64_t begin = LogMetrics::NowNs();
+        fmt->format(buf, logger, level, event);
+        uint64_t ns = (LogMetrics::NowNs() - begin) * LogMetrics::kSampleRate;
+        m_metrics.add(LogMetrics::FORMAT_NS, ns);
+        logger->getMetrics().add(LogMetrics::FORMAT_NS, ns);
+    } else {
+        fmt->format(buf, logger, level, event);
+    }
+    countBytes(logger, buf.size() - size);
+}
+
+void LogAppender::countBytes(const std::shared_ptr<Logger>& logger, uint64_t bytes) {
+    m_metrics.add(LogMetrics::BYTES, bytes);
+    logger->getMetrics().add(LogMetrics::BYTES, bytes);
+}
+
 void LogAppender::setFormater(LogFormatter::ptr val) {
     Mutex::Lock lock(m_mutex);
     m_formatter = val;
@@ -291,9 +1217,9 @@ void LogAppender::setFormater(LogFormatter::ptr val) {
 }
 
 std::string LoggerManager::toYamlstring() {
-    Mutex::Lock lock(m_mutex);
+    std::shared_ptr<const LoggerMap> loggers = getLoggers();
     YAML::Node node;
-    for (auto& i : m_loggers) {
+    for (auto& i : *loggers) {
         node.push_back(YAML::Load(i.second->toYamlString()));
     }
     std::stringstream ss;
@@ -301,6 +1227,90 @@ std::string LoggerManager::toYamlstring() {
     return ss.str();
 }
 
+//统计项按输出顺序排列，I/O耗时由append_ns减去format_ns得到
+struct LogMetricsItem {
+    const char* name;
+    uint64_t value;
+};
+
+static std::vector<LogMetricsItem> ListMetrics(const LogMetrics& m, bool logger) {
+    std::vector<LogMetricsItem> rt;
+    rt.push_back({"events", m.get(LogMetrics::EVENTS)});
+    if (logger) {
+        rt.push_back({"filtered", m.get(LogMetrics::FILTERED)});
+        rt.push_back({"throttled", m.get(LogMetrics::THROTTLED)});
+    }
+    rt.push_back({"bytes", m.get(LogMetrics::BYTES)});
+    if (!logger) {
+        rt.push_back({"errors", m.get(LogMetrics::ERRORS)});
+    }
+    uint64_t format = m.get(LogMetrics::FORMAT_NS);
+    uint64_t append = m.get(LogMetrics::APPEND_NS);
+    rt.push_back({"format_ns", format});
+    rt.push_back({"io_ns", append > format ? append - format : 0});
+    return rt;
+}
+
+//appender的类型取自其配置
+static std::string AppenderType(const LogAppender::ptr& appender) {
+    YAML::Node node = YAML::Load(appender->toYamlString());
+    return node["type"].IsDefined() ? node["type"].as<std::string>() : "";
+}
+
+std::string LoggerManager::metricsToYamlString() {
+    std::shared_ptr<const LoggerMap> loggers = getLoggers();
+    YAML::Node node;
+    for (auto& i : *loggers) {
+        YAML::Node n;
+        n["name"] = i.first;
+        for (auto& m : ListMetrics(i.second->getMetrics(), true)) {
+            n[m.name] = m.value;
+        }
+        for (auto& a : *i.second->getAppenders()) {
+            YAML::Node an;
+            an["type"] = AppenderType(a);
+            for (auto& m : ListMetrics(a->getMetrics(), false)) {
+                an[m.name] = m.value;
+            }
+            n["appenders"].push_back(an);
+        }
+        node.push_back(n);
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+std::string LoggerManager::metricsToJsonString() {
+    std::shared_ptr<const LoggerMap> loggers = getLoggers();
+    LogStream buf;
+    buf << '[';
+    bool first = true;
+    for (auto& i : *loggers) {
+        buf << (first ? "{\"name\":" : ",{\"name\":");
+        first = false;
+        AppendJsonString(buf, i.first.c_str(), i.first.size());
+        for (auto& m : ListMetrics(i.second->getMetrics(), true)) {
+            buf << ",\"" << m.name << "\":" << m.value;
+        }
+        buf << ",\"appenders\":[";
+        bool afirst = true;
+        for (auto& a : *i.second->getAppenders()) {
+            std::string type = AppenderType(a);
+            buf << (afirst ? "{\"type\":" : ",{\"type\":");
+            afirst = false;
+            AppendJsonString(buf, type.c_str(), type.size());
+            for (auto& m : ListMetrics(a->getMetrics(), false)) {
+                buf << ",\"" << m.name << "\":" << m.value;
+            }
+            buf << '}';
+        }
+        buf << "]}";
+    }
+    buf << ']';
+    return buf.str();
+}
+
 LogFormatter::ptr Logger::getFormatter() {
     Mutex::Lock lock(m_mutex);
     return m_formatter;
@@ -319,7 +1329,7 @@ void Logger::setFormatter(const LogFormatter::ptr formatter) {
     Mutex::Lock lock(m_mutex);
     m_formatter = formatter;
 
-    for (auto& i : m_appenders) {
+    for (auto& i : *m_appenders) {
         Mutex::Lock ll(i->m_mutex);
         if (!i->m_hasformatter) {
             i->m_formatter = m_formatter;
@@ -329,6 +1339,7 @@ void Logger::setFormatter(const LogFormatter::ptr formatter) {
 
 FileLogAppender::FileLogAppender(const std::string& filename)
      : m_filename(filename) {
+    reopen(m_filename);
 }
 
 std::string FileLogAppender::toYamlString() {
@@ -348,10 +1359,17 @@ std::string FileLogAppender::toYamlString() {
     return ss.str();
 }
 
-void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, LogEvent::ptr event) {
-    Mutex::Lock lock(m_mutex);
+void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) {
     if (level >= m_level) {
-        m_filestream << m_formatter->format(logger, level, event);
+        LogStream buf(true);
+        Mutex::Lock lock(m_mutex);
+        formatEvent(m_formatter, buf, logger, level, event);
+        m_filestream.write(buf.data(), buf.size());
+        m_filestream.flush();
+        if (!m_filestream) {
+            m_metrics.add(LogMetrics::ERRORS);
+            m_filestream.clear();
+        }
     }
 }
 
@@ -360,14 +1378,18 @@ bool FileLogAppender::reopen(const std::string& filename) {
     if (m_filestream) {
         m_filestream.close();
     }
-    m_filestream.open(filename);
+    m_filename = filename;
+    m_filestream.open(m_filename, std::ios::app);
     return !!m_filestream;
 }
 
-void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, LogEvent::ptr event) {
+void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) {
     if (level >= m_level) {
+        LogStream buf(true);
         Mutex::Lock lock(m_mutex);
-        std::cout << m_formatter->format(logger, level, event);
+        formatEvent(m_formatter, buf, logger, level, event);
+        std::cout.write(buf.data(), buf.size());
+        std::cout.flush();
     }
 }
 //头文件中声明了override 实现函数时不需要二次声明
@@ -392,12 +1414,83 @@ LogFormatter::LogFormatter(const std::string& pattern) : m_pattern(pattern) {
     init();
 }
 
-std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::level level, LogEvent::ptr event) {
-    std::stringstream ss;
-    for (auto &i : m_items) {
-        i->format(logger, ss, level, event);
+std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) {
+    LogStream buf(true);
+    format(buf, logger, level, event);
+    return buf.str();
+}
+
+//日志级别名称及长度，避免每次strlen
+struct LevelName {
+    const char* name;
+    size_t len;
+};
+
+static const LevelName& GetLevelName(LogLevel::level level) {
+    static LevelName s_names[] = {
+#define XX(name) {name, sizeof(name) - 1}
+        XX("UNKOWN"),
+        XX("DEBUG"),
+        XX("WARN"),
+        XX("ERROR"),
+        XX("INFO"),
+        XX("FATAL")
+#undef XX
+    };
+    if (level < LogLevel::UNKOWN || level > LogLevel::FATAL) {
+        return s_names[0];
+    }
+    return s_names[level];
+}
+
+void LogFormatter::format(LogStream& buf, const std::shared_ptr<Logger>& logger,
+                          LogLevel::level level, const LogEvent& event) {
+    const char* literals = m_literals.c_str();
+    for (auto& op : m_ops) {
+        switch (op.code) {
+        case Op::LITERAL:
+            buf.append(literals + op.offset, op.len);
+            break;
+        case Op::MESSAGE:
+            buf.append(event.getContentData(), event.getContentSize());
+            break;
+        case Op::LEVEL: {
+            const LevelName& n = GetLevelName(level);
+            buf.append(n.name, n.len);
+            break;
+        }
+        case Op::ELAPSE:
+            buf << event.getElapse();
+            break;
+        case Op::NAME:
+            buf << logger->getName();
+            break;
+        case Op::THREAD_ID:
+            buf << event.getThreadID();
+            break;
+        case Op::THREAD_NAME:
+            buf << event.getThreadName();
+            break;
+        case Op::FIBER_ID:
+            buf << event.getFiberID();
+            break;
+        case Op::DATETIME:
+            m_dateFormats[op.offset]->format(buf, event.getTime(), event.getUsec());
+            break;
+        case Op::LINE:
+            buf << event.getLineID();
+            break;
+        case Op::FILENAME:
+            buf << event.getFile();
+            break;
+        case Op::FIELDS:
+            AppendFieldsText(buf, event.getFields());
+            break;
+        case Op::JSON:
+            AppendJson(buf, *m_dateFormats[op.offset], logger, level, event);
+            break;
+        }
     }
-    return ss.str();
 }
 
 //%XXX%   %% XXX{XXX} 可能解析这样的字符串
@@ -412,137 +1505,240 @@ void LogFormatter::init() {
         }
         //遇到连续的两个‘%’号，视为转义字符 存储一个%进字符串
         if ((i + 1) < m_pattern.size() && m_pattern[i + 1] == '%') {
+            nstr.append(1, '%');
+            ++i;
+            continue;
+        }
+        //模式串以单个%结尾
+        if ((i + 1) >= m_pattern.size()) {
             nstr.append(1, '%');
             continue;
         }
 
-        //当前字符为‘%’ 且之后的字符串不是‘%’
-        size_t n = i + 1;
+        //当前字符为‘%’ 之后的一个字符为格式名，可以跟随{fmt}
+        std::string str = m_pattern.substr(i + 1, 1);
         std::string fmt;
-        std::string str;
-        int fmt_status = 0;
-        size_t fmt_begin = 0;
-
-        while (++n < m_pattern.size()) {
-            //如果是空格直接退出循环，说明已经解析到了最后
-            if (!isalpha(m_pattern[i]) && m_pattern[n] != '{' && m_pattern[n] != '}') {
-                break;
-            }
-            //当前状态为0，即正在解析{之前的字符
-            if (fmt_status == 0 && (n + 1) < m_pattern.size()) {
-                if (m_pattern[n] == '{') {
-                    str = m_pattern.substr(i + 1, n - i - 1);
-                    fmt_status = 1;
-                    fmt_begin = n;
-                    i = n;
-                    continue;
-                }
-            }
-            //当前状态为1，说明正在解析fmt，解析后更改状态
-            if (fmt_status == 1 && (n + 1) < m_pattern.size()) {
-                if (m_pattern[n] == '}') {
-                    fmt = m_pattern.substr(fmt_begin + 1, n - fmt_begin - 1);
-                    fmt_status = 2;
+        size_t n = i + 2;
+        if (n < m_pattern.size() && m_pattern[n] == '{') {
+            size_t end = m_pattern.find('}', n);
+            if (end == std::string::npos) {
+                //此时说明解析出错，并不是完整的一组 X{XXX}
+                std::cout << "pattern parser error" << m_pattern << "-" << m_pattern.substr(i) << std::endl;
+                if (!nstr.empty()) {
+                    vec.push_back(std::make_tuple(nstr, "", 0));
+                    nstr.clear();
                 }
+                vec.push_back(std::make_tuple("<<pattern error>>", fmt, 0));
+                m_error = true;
+                break;
             }
+            fmt = m_pattern.substr(n + 1, end - n - 1);
+            n = end + 1;
         }
         // 解析完一组之后 存入vec中
-        if (fmt_status == 0) {
-            if (!nstr.empty()) {
-                vec.push_back(std::make_tuple(nstr, "", 0));
-                nstr.clear();
-            }
-            str = m_pattern.substr(i + 1, n - i - 1);
-            vec.push_back(std::make_tuple(str, fmt, 1));
-            i = n - 1;
-        } else if (fmt_status == 1) {
-            //此时说明解析出错，并不是完整的一组 XXX{XXX}
-            std::cout << "pattern parser error" << m_pattern << "-" << m_pattern.substr(i) << std::endl;
-            vec.push_back(std::make_tuple("<<pattern error>>", fmt, 0));
-            m_error = true;
-        } else if (fmt_status == 2) {
-            if (!nstr.empty()) {
-                vec.push_back(std::make_tuple(nstr, "", 0));
-                nstr.clear();
-            }
-            vec.push_back(std::make_tuple(str, fmt, 1));
-            i = n - 1;
+        if (!nstr.empty()) {
+            vec.push_back(std::make_tuple(nstr, "", 0));
+            nstr.clear();
         }
+        vec.push_back(std::make_tuple(str, fmt, 1));
+        i = n - 1;
     }
 
     if (!nstr.empty()) {
         vec.push_back(std::make_tuple(nstr, "", 0));
     }
-    //该map用来存储字符到格式子模块的映射,保存了全部存在的format
-    static std::map<std::string, std::function<FormatterItem::ptr(const std::string& str)>> s_format_items = {
-#define XX(str, C) \
-        {#str, [] (const std::string& fmt) { return FormatterItem::ptr(new C(fmt)); }}
-
-        XX(m, MessegeFormatItem),
-        XX(p, LevelFormatItem),
-        XX(r, ElapseFormatItem),
-        XX(c, NameFormatItem),
-        XX(t, ThreadIdFormatItem),
-        XX(n, NextLineFormatItem),
-        XX(d, DateTimeFormatItem),
-        XX(f, FileNameFormatItem),
-        XX(l, LineFormatItem),
-        XX(T, TabFormatItem),
+    //该map用来存储格式字符到编译后指令的映射，保存了全部存在的format，负数表示并入常量的固定字符
+    static std::map<std::string, int> s_format_items = {
+#define XX(str, op) \
+        {#str, op}
+
+        XX(m, Op::MESSAGE),
+        XX(p, Op::LEVEL),
+        XX(r, Op::ELAPSE),
+        XX(c, Op::NAME),
+        XX(t, Op::THREAD_ID),
+        XX(N, Op::THREAD_NAME),
+        XX(F, Op::FIBER_ID),
+        XX(n, -'\n'),
+        XX(d, Op::DATETIME),
+        XX(f, Op::FILENAME),
+        XX(l, Op::LINE),
+        XX(T, -'\t'),
+        XX(K, Op::FIELDS),
+        XX(J, Op::JSON),
         //tab
         //...
 #undef XX
     };
 
+    m_ops.clear();
+    m_literals.clear();
+    m_dateFormats.clear();
     for (auto& i : vec) {
         if (std::get<2>(i) == 0) {
-            m_items.push_back(FormatterItem::ptr(new StirngFormatItem(std::get<0>(i))));
+            addLiteral(std::get<0>(i));
         } else {
             auto it = s_format_items.find(std::get<0>(i));
             if (it == s_format_items.end()) {
-                m_items.push_back(FormatterItem::ptr(new StirngFormatItem("<<error_format %" + std::get<0>(i) + ">>"))); 
+                std::string err = "<<error_format %" + std::get<0>(i) + ">>";
+                addLiteral(err);
             } else {
-                m_items.push_back(it->second(std::get<1>(i)));
+                int op = it->second;
+                if (op < 0) {
+                    //固定字符直接并入常量
+                    addLiteral(std::string(1, (char)-op));
+                } else if (op == Op::DATETIME) {
+                    std::string fmt = std::get<1>(i).empty() ? "%Y-%m-%d %H:%M:%S" : std::get<1>(i);
+                    m_ops.push_back(Op{Op::DATETIME, (uint32_t)m_dateFormats.size(), 0});
+                    m_dateFormats.push_back(std::make_shared<DateFormat>(fmt));
+                } else if (op == Op::JSON) {
+                    std::string fmt = std::get<1>(i).empty() ? s_json_date_format : std::get<1>(i);
+                    m_ops.push_back(Op{Op::JSON, (uint32_t)m_dateFormats.size(), 0});
+                    m_dateFormats.push_back(std::make_shared<DateFormat>(fmt));
+                } else {
+                    m_ops.push_back(Op{(Op::Code)op, 0, 0});
+                }
             }
         }
         //std::cout << std::get<0>(i) << "-" << std::get<1>(i) << "-" << std::get<2>(i) << std::endl;
     }
 }
 
+void LogFormatter::addLiteral(const std::string& str) {
+    if (str.empty()) {
+        return;
+    }
+    if (!m_ops.empty() && m_ops.back().code == Op::LITERAL
+            && m_ops.back().offset + m_ops.back().len == m_literals.size()) {
+        m_ops.back().len += str.size();
+    } else {
+        m_ops.push_back(Op{Op::LITERAL, (uint32_t)m_literals.size(), (uint32_t)str.size()});
+    }
+    m_literals.append(str);
+}
+
 LoggerManager::LoggerManager() {
     m_root.reset(new Logger);
 
     m_root->addAppender(noobnet::StdoutLogAppender::ptr(new StdoutLogAppender));
 
-    m_loggers[m_root->m_name] = m_root;
+    std::shared_ptr<LoggerMap> loggers(new LoggerMap);
+    (*loggers)[m_root->m_name] = m_root;
+    m_loggers = loggers;
+    m_loggerMap.store(loggers.get());
 
     init();
 }
 
 Logger::ptr LoggerManager::getLogger(const std::string& name) {
+    {
+        EpochGuard guard;
+        const LoggerMap* loggers = m_loggerMap.load();
+        auto i = loggers->find(name);
+        if (i != loggers->end()) {
+            return i->second;
+        }
+    }
+    return addLogger(name);
+}
+
+std::shared_ptr<const LoggerManager::LoggerMap> LoggerManager::getLoggers() {
     Mutex::Lock lock(m_mutex);
-    auto i = m_loggers.find(name);
+    return m_loggers;
+}
 
-    if (i != m_loggers.end()) {
-        return i->second;
+Logger::ptr LoggerManager::addLogger(const std::string& name) {
+    Mutex::Lock lock(m_mutex);
+    std::shared_ptr<LoggerMap> loggers(new LoggerMap(*m_loggers));
+    //从自身向上找到第一个已存在的祖先，途中缺失的logger一并创建
+    std::vector<std::string> missing;
+    Logger::ptr parent;
+    std::string cur = name;
+    while (true) {
+        auto i = loggers->find(cur);
+        if (i != loggers->end()) {
+            parent = i->second;
+            break;
+        }
+        missing.push_back(cur);
+        size_t pos = cur.rfind('.');
+        if (pos == std::string::npos || pos == 0) {
+            parent = m_root;
+            break;
+        }
+        cur = cur.substr(0, pos);
     }
-
-    Logger::ptr logger(new Logger(name));
-    logger->m_root = m_root;
-    m_loggers[name] = logger;
-    return logger;
+    if (missing.empty()) {
+        return parent;
+    }
+    for (auto i = missing.rbegin(); i != missing.rend(); ++i) {
+        Logger::ptr logger(new Logger(*i));
+        logger->m_parent = parent;
+        (*loggers)[*i] = logger;
+        parent = logger;
+    }
+    //新logger没有级别和appender，不影响已有的解析结果，无需递增代数
+    std::shared_ptr<const LoggerMap> retired = m_loggers;
+    m_loggers = loggers;
+    m_loggerMap.store(loggers.get());
+    //其他线程可能仍在旧快照上查找，交给Epoch在它们离开后释放
+    Epoch::Retire(retired);
+    return parent;
 }
 
 struct LogAppenderDefine {
-    int type = 0; // 1 File, 2 Stdout
+    int type = 0; // 1 File, 2 Stdout, 3 RollingFile, 4 MmapFile, 5 Binary, 6 Console, 7 Syslog
     LogLevel::level level = LogLevel::UNKOWN;
     std::string formatter;
     std::string file;
+    // 异步输出相关配置
+    bool async = false;
+    uint32_t queue_size = 1024 * 1024;
+    AsyncLogAppender::OverflowPolicy overflow = AsyncLogAppender::BLOCK;
+    LogLevel::level drop_level = LogLevel::WARN;
+    // 滚动文件相关配置
+    uint64_t max_size = 0;
+    uint32_t interval = 0;
+    uint32_t max_files = 0;
+    RollingFileLogAppender::Compress compress = RollingFileLogAppender::NONE;
+    // mmap文件相关配置
+    uint64_t chunk_size = 4 * 1024 * 1024;
+    // 二进制文件相关配置
+    uint32_t buffer_size = 64 * 1024;
+    // 批量控制台输出相关配置
+    bool to_stderr = false;
+    uint32_t batch_size = 64 * 1024;
+    uint32_t flush_interval = 100;
+    bool nonblock = false;
+    uint32_t backlog = 4 * 1024 * 1024;
+    // syslog相关配置
+    std::string address = "unix:/dev/log";
+    std::string facility = "user";
+    std::string tag;
 
     bool operator== (const LogAppenderDefine& ohs) const {
         return type == ohs.type
             && level == ohs.level
             && formatter == ohs.formatter
-            && file == ohs.file;
+            && file == ohs.file
+            && async == ohs.async
+            && queue_size == ohs.queue_size
+            && overflow == ohs.overflow
+            && drop_level == ohs.drop_level
+            && max_size == ohs.max_size
+            && interval == ohs.interval
+            && max_files == ohs.max_files
+            && compress == ohs.compress
+            && chunk_size == ohs.chunk_size
+            && buffer_size == ohs.buffer_size
+            && to_stderr == ohs.to_stderr
+            && batch_size == ohs.batch_size
+            && flush_interval == ohs.flush_interval
+            && nonblock == ohs.nonblock
+            && backlog == ohs.backlog
+            && address == ohs.address
+            && facility == ohs.facility
+            && tag == ohs.tag;
     }
 };
 
@@ -550,12 +1746,19 @@ struct LogDefine {
     std::string name;
     LogLevel::level level = LogLevel::UNKOWN;
     std::string formatter;
+    // 每个调用点的限速与采样
+    uint32_t rate_limit = 0;
+    uint32_t burst = 0;
+    uint32_t sample = 0;
     std::vector<LogAppenderDefine> appenders;
 
     bool operator==(const LogDefine& ohs) const {
         return name == ohs.name
             && level == ohs.level
             && formatter == ohs.formatter
+            && rate_limit == ohs.rate_limit
+            && burst == ohs.burst
+            && sample == ohs.sample
             && appenders == ohs.appenders;
     }
 
@@ -584,6 +1787,15 @@ public:
         std::cout << "formatter works" << std::endl;
         n["formatter"] = i.formatter;
     }
+    if (i.rate_limit) {
+        n["rate_limit"] = i.rate_limit;
+    }
+    if (i.burst) {
+        n["burst"] = i.burst;
+    }
+    if (i.sample) {
+        n["sample"] = i.sample;
+    }
 
     for (auto& a : i.appenders) {
         YAML::Node na;
@@ -593,13 +1805,63 @@ public:
             na["file"] = a.file;
         } else if (a.type == 2) {
             na["type"] = "StdoutLogAppender";
-        } 
+        } else if (a.type == 3) {
+            na["type"] = "RollingFileLogAppender";
+            na["file"] = a.file;
+            if (a.max_size) {
+                na["max_size"] = a.max_size;
+            }
+            if (a.interval) {
+                na["interval"] = a.interval;
+            }
+            if (a.max_files) {
+                na["max_files"] = a.max_files;
+            }
+            if (a.compress != RollingFileLogAppender::NONE) {
+                na["compress"] = RollingFileLogAppender::CompressToString(a.compress);
+            }
+        } else if (a.type == 4) {
+            na["type"] = "MmapFileLogAppender";
+            na["file"] = a.file;
+            na["chunk_size"] = a.chunk_size;
+        } else if (a.type == 5) {
+            na["type"] = "BinaryLogAppender";
+            na["file"] = a.file;
+            na["buffer_size"] = a.buffer_size;
+            na["flush_interval"] = a.flush_interval;
+        } else if (a.type == 6) {
+            na["type"] = "ConsoleLogAppender";
+            na["stream"] = a.to_stderr ? "stderr" : "stdout";
+            na["batch_size"] = a.batch_size;
+            na["flush_interval"] = a.flush_interval;
+            if (a.nonblock) {
+                na["nonblock"] = true;
+                na["backlog"] = a.backlog;
+            }
+        } else if (a.type == 7) {
+            na["type"] = "SyslogLogAppender";
+            na["address"] = a.address;
+            na["facility"] = a.facility;
+            if (!a.tag.empty()) {
+                na["tag"] = a.tag;
+            }
+            na["queue_size"] = a.queue_size;
+            na["flush_interval"] = a.flush_interval;
+        }
         if (a.level != LogLevel::UNKOWN) {
             na["level"] = LogLevel::ToString(a.level);
         }
         if (!a.formatter.empty()) {
             na["formatter"] = a.formatter;
         }
+        if (a.async) {
+            na["async"] = true;
+            na["queue_size"] = a.queue_size;
+            na["overflow"] = AsyncLogAppender::PolicyToString(a.overflow);
+            if (a.overflow == AsyncLogAppender::DROP_BELOW_LEVEL) {
+                na["drop_level"] = LogLevel::ToString(a.drop_level);
+            }
+        }
 
         n["appenders"].push_back(na);
     }
@@ -609,12 +1871,11 @@ public:
   }
 };
 
-//string to logdefine
+//YAML节点 to logdefine
 template<>
-class LexicalCast<std::string, LogDefine> {
+class LexicalCast<YAML::Node, LogDefine> {
 public:
-  LogDefine operator() (const std::string& str) {
-    YAML::Node n = YAML::Load(str);
+  LogDefine operator() (const YAML::Node& n) {
     LogDefine ld;
     if (!n["name"].IsDefined()) {
         std::cout << "Logdefine's name is null" << std::endl;
@@ -627,6 +1888,15 @@ public:
         //std::cout << "formatter works" << std::endl;
         ld.formatter = n["formatter"].as<std::string>();
     }
+    if (n["rate_limit"].IsDefined()) {
+        ld.rate_limit = n["rate_limit"].as<uint32_t>();
+    }
+    if (n["burst"].IsDefined()) {
+        ld.burst = n["burst"].as<uint32_t>();
+    }
+    if (n["sample"].IsDefined()) {
+        ld.sample = n["sample"].as<uint32_t>();
+    }
     
     if (n["appenders"].IsDefined()) {
         //std::cout << "appenders parsering" << std::endl;
@@ -654,10 +1924,119 @@ public:
                 if (lap["formatter"].IsDefined()) {
                     lad.formatter = lap["formatter"].as<std::string>();
                 }
+            } else if (type == "RollingFileLogAppender") {
+                lad.type = 3;
+                if (!lap["file"].IsDefined()) {
+                    std::cout << "log config error : file is null" << lap << std::endl;
+                    continue;
+                }
+                lad.file = lap["file"].as<std::string>();
+                if (lap["formatter"].IsDefined()) {
+                    lad.formatter = lap["formatter"].as<std::string>();
+                }
+                if (lap["max_size"].IsDefined()) {
+                    lad.max_size = lap["max_size"].as<uint64_t>();
+                }
+                if (lap["interval"].IsDefined()) {
+                    lad.interval = lap["interval"].as<uint32_t>();
+                }
+                if (lap["max_files"].IsDefined()) {
+                    lad.max_files = lap["max_files"].as<uint32_t>();
+                }
+                if (lap["compress"].IsDefined()) {
+                    lad.compress = RollingFileLogAppender::CompressFromString(lap["compress"].as<std::string>());
+                }
+            } else if (type == "MmapFileLogAppender") {
+                lad.type = 4;
+                if (!lap["file"].IsDefined()) {
+                    std::cout << "log config error : file is null" << lap << std::endl;
+                    continue;
+                }
+                lad.file = lap["file"].as<std::string>();
+                if (lap["formatter"].IsDefined()) {
+                    lad.formatter = lap["formatter"].as<std::string>();
+                }
+                if (lap["chunk_size"].IsDefined()) {
+                    lad.chunk_size = lap["chunk_size"].as<uint64_t>();
+                }
+            } else if (type == "BinaryLogAppender") {
+                lad.type = 5;
+                if (!lap["file"].IsDefined()) {
+                    std::cout << "log config error : file is null" << lap << std::endl;
+                    continue;
+                }
+                lad.file = lap["file"].as<std::string>();
+                if (lap["buffer_size"].IsDefined()) {
+                    lad.buffer_size = lap["buffer_size"].as<uint32_t>();
+                }
+                if (lap["flush_interval"].IsDefined()) {
+                    lad.flush_interval = lap["flush_interval"].as<uint32_t>();
+                }
+            } else if (type == "ConsoleLogAppender") {
+                lad.type = 6;
+                if (lap["formatter"].IsDefined()) {
+                    lad.formatter = lap["formatter"].as<std::string>();
+                }
+                if (lap["stream"].IsDefined()) {
+                    std::string stream = lap["stream"].as<std::string>();
+                    if (stream != "stdout" && stream != "stderr") {
+                        std::cout << "log config error : stream is invalid" << lap << std::endl;
+                        continue;
+                    }
+                    lad.to_stderr = stream == "stderr";
+                }
+                if (lap["batch_size"].IsDefined()) {
+                    lad.batch_size = lap["batch_size"].as<uint32_t>();
+                }
+                if (lap["flush_interval"].IsDefined()) {
+                    lad.flush_interval = lap["flush_interval"].as<uint32_t>();
+                }
+                if (lap["nonblock"].IsDefined()) {
+                    lad.nonblock = lap["nonblock"].as<bool>();
+                }
+                if (lap["backlog"].IsDefined()) {
+                    lad.backlog = lap["backlog"].as<uint32_t>();
+                }
+            } else if (type == "SyslogLogAppender") {
+                lad.type = 7;
+                if (lap["formatter"].IsDefined()) {
+                    lad.formatter = lap["formatter"].as<std::string>();
+                }
+                if (lap["address"].IsDefined()) {
+                    lad.address = lap["address"].as<std::string>();
+                }
+                if (lap["facility"].IsDefined()) {
+                    lad.facility = lap["facility"].as<std::string>();
+                    if (SyslogLogAppender::FacilityFromString(lad.facility) < 0) {
+                        std::cout << "log config error : facility is invalid" << lap << std::endl;
+                        continue;
+                    }
+                }
+                if (lap["tag"].IsDefined()) {
+                    lad.tag = lap["tag"].as<std::string>();
+                }
+                if (lap["flush_interval"].IsDefined()) {
+                    lad.flush_interval = lap["flush_interval"].as<uint32_t>();
+                }
             } else {
                 std::cout << "log config error : type is invalid" << lap << std::endl;
                 continue;
             }
+            if (lap["level"].IsDefined()) {
+                lad.level = LogLevel::FromString(lap["level"].as<std::string>());
+            }
+            if (lap["async"].IsDefined()) {
+                lad.async = lap["async"].as<bool>();
+            }
+            if (lap["queue_size"].IsDefined()) {
+                lad.queue_size = lap["queue_size"].as<uint32_t>();
+            }
+            if (lap["overflow"].IsDefined()) {
+                lad.overflow = AsyncLogAppender::PolicyFromString(lap["overflow"].as<std::string>());
+            }
+            if (lap["drop_level"].IsDefined()) {
+                lad.drop_level = LogLevel::FromString(lap["drop_level"].as<std::string>());
+            }
             ld.appenders.push_back(lad);
         }
     }
@@ -665,52 +2044,168 @@ public:
   }
 };
 
+//string to logdefine
+template<>
+class LexicalCast<std::string, LogDefine> {
+public:
+  LogDefine operator() (const std::string& str) {
+    return LexicalCast<YAML::Node, LogDefine>()(YAML::Load(str));
+  }
+};
+
 noobnet::ConfigVar<std::set<LogDefine>>::ptr g_log_defines =
     noobnet::Config::LookUp(std::set<LogDefine>(), "logs", "log defines");
 
+//调用点开关，列出的调用点为 "文件" 或 "文件:行号"
+noobnet::ConfigVar<std::set<std::string>>::ptr g_log_sites_enabled =
+    noobnet::Config::LookUp(std::set<std::string>(), "log_sites.enabled", "log sites forced on");
+noobnet::ConfigVar<std::set<std::string>>::ptr g_log_sites_disabled =
+    noobnet::Config::LookUp(std::set<std::string>(), "log_sites.disabled", "log sites forced off");
+
+struct LogSiteIniter {
+    LogSiteIniter() {
+        auto apply = [] (const std::set<std::string>&, const std::set<std::string>&) {
+            std::map<std::string, LogSite::State> states;
+            for (auto& i : g_log_sites_enabled->getValue()) {
+                states[i] = LogSite::FORCE_ON;
+            }
+            //同时出现时关闭优先
+            for (auto& i : g_log_sites_disabled->getValue()) {
+                states[i] = LogSite::FORCE_OFF;
+            }
+            LogSite::SetStates(states);
+        };
+        g_log_sites_enabled->addListener(apply);
+        g_log_sites_disabled->addListener(apply);
+    }
+};
+
+static LogSiteIniter __log_site_init_;
+
+static LogAppender::ptr CreateAppender(const LogAppenderDefine& a, const std::string& name) {
+    LogAppender::ptr ap;
+    if (a.async && (a.type == 1 || a.type == 2)) {
+        ap.reset(new AsyncLogAppender(a.type == 1 ? a.file : "",
+                    a.queue_size, a.overflow, a.drop_level));
+    } else if (a.type == 1) {
+        ap.reset(new FileLogAppender(a.file));
+    } else if (a.type == 2) {
+        ap.reset(new StdoutLogAppender);
+    } else if (a.type == 3) {
+        ap.reset(new RollingFileLogAppender(a.file, a.max_size,
+                    a.interval, a.max_files, a.compress));
+    } else if (a.type == 4) {
+        ap.reset(new MmapFileLogAppender(a.file, a.chunk_size));
+    } else if (a.type == 5) {
+        ap.reset(new BinaryLogAppender(a.file, a.buffer_size, a.flush_interval));
+    } else if (a.type == 6) {
+        ap.reset(new ConsoleLogAppender(a.to_stderr, a.batch_size,
+                    a.flush_interval, a.nonblock, a.backlog));
+    } else if (a.type == 7) {
+        ap.reset(new SyslogLogAppender(a.address, a.facility, a.tag,
+                    a.queue_size, a.flush_interval));
+    }
+    ap->setLevel(a.level);
+    if (!a.formatter.empty()) {
+        LogFormatter::ptr fm(new LogFormatter(a.formatter));
+        if (!fm->is_Error()) {
+            ap->setFormater(fm);
+        } else {
+            std::cout << "logdefines formatter invalid" << "-" <<
+            "log.name: " << name << "-" << "log.appender.format: "
+            << a.formatter << std::endl;
+        }
+    }
+    return ap;
+}
+
+//由配置创建的appender及其定义，重新加载时据此复用未变化的appender
+struct ConfigAppenders {
+    Mutex mutex;
+    std::map<std::string, std::vector<std::pair<LogAppenderDefine, LogAppender::ptr>>> loggers;
+};
+
+static ConfigAppenders& GetConfigAppenders() {
+    static ConfigAppenders s_appenders;
+    return s_appenders;
+}
+
+/**
+ * @brief 按新的定义更新logger由配置创建的appender
+ * @details 定义未变化的appender原样保留，新增和变化的先创建好，再一次性替换快照，
+ *          被替换的appender交给Epoch在回收线程析构。代码中手动添加的appender不受影响
+*/
+static void ApplyAppenders(const Logger::ptr& logger, const std::vector<LogAppenderDefine>& defines) {
+    ConfigAppenders& ca = GetConfigAppenders();
+    Mutex::Lock lock(ca.mutex);
+    auto& old = ca.loggers[logger->getName()];
+    std::vector<bool> kept(old.size(), false);
+    std::vector<std::pair<LogAppenderDefine, LogAppender::ptr>> current;
+    Logger::AppenderList add;
+    Logger::AppenderList del;
+    for (auto& a : defines) {
+        LogAppender::ptr ap;
+        for (size_t i = 0; i < old.size(); ++i) {
+            if (!kept[i] && old[i].first == a) {
+                kept[i] = true;
+                ap = old[i].second;
+                break;
+            }
+        }
+        if (!ap) {
+            ap = CreateAppender(a, logger->getName());
+            add.push_back(ap);
+        }
+        current.push_back(std::make_pair(a, ap));
+    }
+    for (size_t i = 0; i < old.size(); ++i) {
+        if (!kept[i]) {
+            del.push_back(old[i].second);
+        }
+    }
+    logger->updateAppenders(del, add);
+    //旧快照先交出，这里交出的引用在它之后释放，最后一个引用总是落在回收线程上，
+    //析构时的刷盘、关闭文件和回收后台线程都不会发生在写日志或加载配置的线程里
+    for (auto& i : del) {
+        Epoch::Retire(i);
+    }
+    if (current.empty()) {
+        ca.loggers.erase(logger->getName());
+    } else {
+        old.swap(current);
+    }
+}
+
 //TODO  fix
 struct LogIniter {
     LogIniter() {
         g_log_defines->addListener([] (const std::set<LogDefine>& old_val,
             const std::set<LogDefine>& new_val) {
                 SYS_LOG_INFO(SYS_LOG_ROOT()) << "on_logger_conf_changed";
+                //只修改发生变化的部分：级别等按字段比较，appender按定义复用
+                //级别和appender的修改会递增Logger代数，子logger缓存的解析结果随之失效
+                static const LogDefine s_empty;
                 for (auto& i : new_val) {
                     auto it = old_val.find(i);
-                    noobnet::Logger::ptr logger;
-                    if (it == old_val.end()) {
-                        logger = SYS_LOG_NAME(i.name);
-                    } else {
-                        if (!(i == *it)) {
-                            logger = SYS_LOG_NAME(i.name);
-                        } else {
-                            continue;
-                        }
-                    } //logger fix finished
-                    //logger's level and formatter
-                    logger->setLevel(i.level);
-                    if (!i.formatter.empty()) {
+                    if (it != old_val.end() && i == *it) {
+                        continue;
+                    }
+                    const LogDefine& prev = it == old_val.end() ? s_empty : *it;
+                    noobnet::Logger::ptr logger = SYS_LOG_NAME(i.name);
+                    if (it == old_val.end() || i.level != prev.level) {
+                        logger->setLevel(i.level);
+                    }
+                    if (i.rate_limit != prev.rate_limit || i.burst != prev.burst) {
+                        logger->setRateLimit(i.rate_limit, i.burst);
+                    }
+                    if (i.sample != prev.sample) {
+                        logger->setSampleRate(i.sample);
+                    }
+                    if (!i.formatter.empty() && i.formatter != prev.formatter) {
                         logger->setFormatter(i.formatter);
                     }
-                    // appender's all 
-                    for (auto& a : i.appenders) {
-                        noobnet::LogAppender::ptr ap;
-                        if (a.type == 1) {
-                            ap.reset(new FileLogAppender(a.file));
-                        } else if (a.type == 2) {
-                            ap.reset(new StdoutLogAppender);
-                        }
-                        ap->setLevel(a.level);
-                        if (!a.formatter.empty()) {
-                            LogFormatter::ptr fm(new LogFormatter(a.formatter));
-                            if (!fm->is_Error()) {
-                                ap->setFormater(fm);
-                            } else {
-                                std::cout << "logdefines formatter invalid" << "-" <<
-                                "log.name: " << i.name << "-" << "log.appender.format: "
-                                << a.formatter << std::endl;
-                            }
-                        }
-                        logger->addAppender(ap);
+                    if (!(i.appenders == prev.appenders)) {
+                        ApplyAppenders(logger, i.appenders);
                     }
                 }
 
@@ -720,7 +2215,9 @@ struct LogIniter {
                     if (it == new_val.end()) {
                         noobnet::Logger::ptr logger(SYS_LOG_NAME(i.name));
                         logger->setLevel((LogLevel::level)0);
-                        logger->clearAppenders();
+                        logger->setRateLimit(0);
+                        logger->setSampleRate(0);
+                        ApplyAppenders(logger, std::vector<LogAppenderDefine>());
                     }
                 }
             }        
@@ -4,26 +4,46 @@
 #include "singleton.h"
 #include "utils.h"
 #include "mutex.h"
+#include "noncopyable.h"
 
 #include <string>
+#include <string.h>
+#include <type_traits>
 #include <stdint.h>
 #include <memory>
+#include <atomic>
 #include <list>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <sstream>
 #include <map>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 #include <yaml-cpp/yaml.h>
 
 
 namespace noobnet {
 
+//编译期的最低日志级别，低于该级别的日志语句条件恒为假，由编译器整体删除
+//通过cmake -DLOG_MIN_LEVEL=INFO 等方式设置
+#ifndef SYS_LOG_MIN_LEVEL
+#define SYS_LOG_MIN_LEVEL 0
+#endif
+
+//每个调用点一个静态的LogSite，常量初始化，不需要线程安全的静态变量保护
+#define SYS_LOG_SITE() \
+  ([]() -> noobnet::LogSite& { \
+    static noobnet::LogSite s_sys_log_site(__FILE__, __LINE__); \
+    return s_sys_log_site; }())
+
 #define SYS_LOG_LEVEL(logger, level) \
-  if (logger->getLevel() <= level)  \
-    noobnet::LogEventWrap(noobnet::LogEvent::ptr\
-    (new noobnet::LogEvent(__FILE__, __LINE__,\
-    0, 1, 2, time(0), logger, level))).getSS()
+  if ((int)(level) >= SYS_LOG_MIN_LEVEL) \
+    if (int sys_log_site_state = SYS_LOG_SITE().check(logger, level)) \
+      noobnet::LogEventWrap(__FILE__, __LINE__, logger, level, \
+      sys_log_site_state == noobnet::LogSite::FORCE_ON, \
+      sys_log_site_state == noobnet::LogSite::RECORD_ONLY).getSS()
 
 
 #define SYS_LOG_DEBUG(logger) SYS_LOG_LEVEL(logger, noobnet::LogLevel::DEBUG)
@@ -36,12 +56,13 @@ namespace noobnet {
 
 #define SYS_LOG_FATAL(logger) SYS_LOG_LEVEL(logger, noobnet::LogLevel::FATAL)
 
-//自定义输出格式
+//自定义输出格式，字符串字面量在开启参数捕获时只编码参数，运行时生成的格式串立即生成文本
 #define SYS_LOG_FMT_LEVEL(logger, level, fmt, ...) \
-  if (logger->getLevel() <= level)  \
-    noobnet::LogEventWrap(noobnet::LogEvent::ptr\
-    (new noobnet::LogEvent(__FILE__, __LINE__,\
-    0, 1, 2, time(0), logger, level))).getEvent()->format(fmt, __VA_ARGS__)
+  if ((int)(level) >= SYS_LOG_MIN_LEVEL) \
+    if (int sys_log_site_state = SYS_LOG_SITE().check(logger, level)) \
+      noobnet::LogEventWrap(__FILE__, __LINE__, logger, level, \
+      sys_log_site_state == noobnet::LogSite::FORCE_ON, \
+      sys_log_site_state == noobnet::LogSite::RECORD_ONLY).getEvent()->formatFmt(fmt, __VA_ARGS__)
 
 #define SYS_LOG_FMT_DEBUG(logger, fmt, ...) SYS_LOG_FMT_LEVEL(logger, noobnet::LogLevel::DEBUG, fmt, __VA_ARGS__)
 
@@ -53,6 +74,45 @@ namespace noobnet {
 
 #define SYS_LOG_FMT_FATAL(logger, fmt, ...) SYS_LOG_FMT_LEVEL(logger, noobnet::LogLevel::FATAL, fmt, __VA_ARGS__)
 
+//{}占位符风格，参数按类型写入，用法：SYS_LOG_PRINT_INFO(logger, "uid={} cost={}", uid, 1.5);
+//fmt必须是字符串字面量，占位符与参数个数不一致时编译失败
+#define SYS_LOG_PRINT_LEVEL(logger, level, fmt, ...) \
+  if ((int)(level) >= SYS_LOG_MIN_LEVEL) \
+    if (int sys_log_site_state = SYS_LOG_SITE().check(logger, level)) \
+      noobnet::LogEventWrap(__FILE__, __LINE__, logger, level, \
+      sys_log_site_state == noobnet::LogSite::FORCE_ON, \
+      sys_log_site_state == noobnet::LogSite::RECORD_ONLY).getEvent()->print( \
+      noobnet::LogCheckedFormat<noobnet::LogPlaceholders(fmt) + 1 == \
+        sizeof(noobnet::LogArgCounter(__VA_ARGS__))>(fmt), ##__VA_ARGS__)
+
+#define SYS_LOG_PRINT_DEBUG(logger, fmt, ...) SYS_LOG_PRINT_LEVEL(logger, noobnet::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+
+#define SYS_LOG_PRINT_WARN(logger, fmt, ...) SYS_LOG_PRINT_LEVEL(logger, noobnet::LogLevel::WARN, fmt, ##__VA_ARGS__)
+
+#define SYS_LOG_PRINT_ERROR(logger, fmt, ...) SYS_LOG_PRINT_LEVEL(logger, noobnet::LogLevel::ERROR, fmt, ##__VA_ARGS__)
+
+#define SYS_LOG_PRINT_INFO(logger, fmt, ...) SYS_LOG_PRINT_LEVEL(logger, noobnet::LogLevel::INFO, fmt, ##__VA_ARGS__)
+
+#define SYS_LOG_PRINT_FATAL(logger, fmt, ...) SYS_LOG_PRINT_LEVEL(logger, noobnet::LogLevel::FATAL, fmt, ##__VA_ARGS__)
+
+//带结构化字段的日志，用法：SYS_LOG_KV_INFO(logger).with("uid", uid).with("cost", 1.5) << "done";
+#define SYS_LOG_KV_LEVEL(logger, level) \
+  if ((int)(level) >= SYS_LOG_MIN_LEVEL) \
+    if (int sys_log_site_state = SYS_LOG_SITE().check(logger, level)) \
+      (*noobnet::LogEventWrap(__FILE__, __LINE__, logger, level, \
+      sys_log_site_state == noobnet::LogSite::FORCE_ON, \
+      sys_log_site_state == noobnet::LogSite::RECORD_ONLY).getEvent())
+
+#define SYS_LOG_KV_DEBUG(logger) SYS_LOG_KV_LEVEL(logger, noobnet::LogLevel::DEBUG)
+
+#define SYS_LOG_KV_WARN(logger) SYS_LOG_KV_LEVEL(logger, noobnet::LogLevel::WARN)
+
+#define SYS_LOG_KV_ERROR(logger) SYS_LOG_KV_LEVEL(logger, noobnet::LogLevel::ERROR)
+
+#define SYS_LOG_KV_INFO(logger) SYS_LOG_KV_LEVEL(logger, noobnet::LogLevel::INFO)
+
+#define SYS_LOG_KV_FATAL(logger) SYS_LOG_KV_LEVEL(logger, noobnet::LogLevel::FATAL)
+
 #define SYS_LOG_ROOT() noobnet::LoggerMgr::getInstance()->getRoot()
 #define SYS_LOG_NAME(name) noobnet::LoggerMgr::getInstance()->getLogger(name)
 
@@ -76,27 +136,303 @@ class LogLevel {
   static LogLevel::level FromString(const std::string& str);  
 };
 
+//日志内容的输出流，替代std::stringstream
+//local为true时借用线程本地的定长缓冲，超出后转存到线程本地的扩展区，常见长度的日志不做任何内存分配
+//local为false时使用堆内存，可以跨线程持有
+class LogStream : Noncopyable {
+ public:
+  //线程本地缓冲的大小
+  static const size_t kInlineSize = 4096;
+
+  LogStream(bool local = false);
+  ~LogStream();
+
+  LogStream& operator<<(bool v);
+  LogStream& operator<<(char v);
+  LogStream& operator<<(signed char v);
+  LogStream& operator<<(unsigned char v);
+  LogStream& operator<<(short v);
+  LogStream& operator<<(unsigned short v);
+  LogStream& operator<<(int v);
+  LogStream& operator<<(unsigned int v);
+  LogStream& operator<<(long v);
+  LogStream& operator<<(unsigned long v);
+  LogStream& operator<<(long long v);
+  LogStream& operator<<(unsigned long long v);
+  LogStream& operator<<(float v);
+  LogStream& operator<<(double v);
+  LogStream& operator<<(long double v);
+  LogStream& operator<<(const void* v);
+  LogStream& operator<<(void* v) { return *this << (const void*)v; }
+  LogStream& operator<<(const char* v);
+  LogStream& operator<<(char* v) { return *this << (const char*)v; }
+  LogStream& operator<<(const std::string& v);
+#if __cplusplus >= 201703L
+  LogStream& operator<<(std::string_view v) { append(v.data(), v.size()); return *this; }
+#endif
+  //只识别std::endl/std::ends/std::flush，其余操纵符被忽略
+  LogStream& operator<<(std::ostream& (*pf)(std::ostream&));
+
+  //其余类型退化为std::ostringstream输出，会产生内存分配
+  template<class T>
+  LogStream& operator<<(const T& v) {
+    std::ostringstream ss;
+    ss << v;
+    const std::string& str = ss.str();
+    append(str.c_str(), str.size());
+    return *this;
+  }
+
+  void append(const char* data, size_t len) {
+    if (m_size + len > m_cap) {
+      grow(len);
+    }
+    memcpy(m_buf + m_size, data, len);
+    m_size += len;
+  }
+
+  //printf风格格式化，直接写入剩余空间，放不下时扩容后再格式化一次
+  void appendf(const char* fmt, va_list al);
+
+  const char* data() const { return m_buf; }
+  size_t size() const { return m_size; }
+  std::string str() const { return std::string(m_buf, m_size); }
+  void clear() { m_size = 0; }
+
+ private:
+  //保证至少还有n字节的空间
+  void grow(size_t n);
+  template<class T>
+  void appendInteger(T v);
+
+ private:
+  char* m_buf = nullptr;
+  size_t m_size = 0;
+  size_t m_cap = 0;
+  //借用的线程本地缓冲，为空表示使用堆内存
+  void* m_local = nullptr;
+};
+
+//日志事件的结构化字段，键和字符串值都拷贝到内部的数据区
+//前kInlineFields个字段和kInlineBytes字节的数据保存在对象内部，超出后才分配堆内存
+class LogFields : Noncopyable {
+ public:
+  static const size_t kInlineFields = 8;
+  static const size_t kInlineBytes = 256;
+
+  struct Field {
+    enum Type : uint8_t {
+      INT,
+      UINT,
+      DOUBLE,
+      BOOL,
+      STRING
+    };
+    Type type;
+    uint16_t keyLen;
+    uint32_t keyOffset;
+    union {
+      int64_t i;
+      uint64_t u;
+      double d;
+      bool b;
+      struct {
+        uint32_t offset;
+        uint32_t len;
+      } str;
+    };
+  };
+
+  LogFields() {}
+  ~LogFields();
+
+  void add(const char* key, bool v) { push(key, Field::BOOL).b = v; }
+  void add(const char* key, char v) { add(key, &v, 1); }
+  void add(const char* key, signed char v) { addInt(key, v); }
+  void add(const char* key, unsigned char v) { addUInt(key, v); }
+  void add(const char* key, short v) { addInt(key, v); }
+  void add(const char* key, unsigned short v) { addUInt(key, v); }
+  void add(const char* key, int v) { addInt(key, v); }
+  void add(const char* key, unsigned int v) { addUInt(key, v); }
+  void add(const char* key, long v) { addInt(key, v); }
+  void add(const char* key, unsigned long v) { addUInt(key, v); }
+  void add(const char* key, long long v) { addInt(key, v); }
+  void add(const char* key, unsigned long long v) { addUInt(key, v); }
+  void add(const char* key, float v) { push(key, Field::DOUBLE).d = v; }
+  void add(const char* key, double v) { push(key, Field::DOUBLE).d = v; }
+  void add(const char* key, long double v) { push(key, Field::DOUBLE).d = (double)v; }
+  void add(const char* key, const char* v) { add(key, v ? v : "", v ? strlen(v) : 0); }
+  void add(const char* key, char* v) { add(key, (const char*)v); }
+  void add(const char* key, const std::string& v) { add(key, v.c_str(), v.size()); }
+#if __cplusplus >= 201703L
+  void add(const char* key, std::string_view v) { add(key, v.data(), v.size()); }
+#endif
+  void add(const char* key, const char* v, size_t len);
+
+  //其余类型退化为std::ostringstream输出的字符串
+  template<class T>
+  void add(const char* key, const T& v) {
+    std::ostringstream ss;
+    ss << v;
+    add(key, ss.str());
+  }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  const Field& operator[](size_t i) const { return m_fields[i]; }
+  const char* key(const Field& f) const { return m_data + f.keyOffset; }
+  const char* str(const Field& f) const { return m_data + f.str.offset; }
+
+ private:
+  void addInt(const char* key, int64_t v) { push(key, Field::INT).i = v; }
+  void addUInt(const char* key, uint64_t v) { push(key, Field::UINT).u = v; }
+  //追加一个字段并拷贝键
+  Field& push(const char* key, Field::Type type);
+  //拷贝到数据区，返回偏移
+  uint32_t store(const char* data, size_t len);
+
+ private:
+  Field* m_fields = m_inlineFields;
+  size_t m_size = 0;
+  size_t m_cap = kInlineFields;
+  char* m_data = m_inlineData;
+  size_t m_dataSize = 0;
+  size_t m_dataCap = kInlineBytes;
+  Field m_inlineFields[kInlineFields];
+  char m_inlineData[kInlineBytes];
+};
+
+//统计格式串中{}占位符的个数，{{和}}是转义
+constexpr size_t LogPlaceholders(const char* s) {
+  return *s == 0 ? 0
+    : ((s[0] == '{' && s[1] == '{') || (s[0] == '}' && s[1] == '}')) ? LogPlaceholders(s + 2)
+    : (s[0] == '{' && s[1] == '}') ? 1 + LogPlaceholders(s + 2)
+    : LogPlaceholders(s + 1);
+}
+
+//只用于sizeof，返回长度为参数个数加一的数组
+template<class... Args>
+char (&LogArgCounter(const Args&...))[sizeof...(Args) + 1];
+
+//占位符与参数个数不一致时编译失败
+template<bool Match>
+inline const char* LogCheckedFormat(const char* fmt) {
+  static_assert(Match, "number of {} placeholders does not match number of arguments");
+  return fmt;
+}
+
 //日志的所有出现的字段由这个类持有,用来表示日志事件
 class LogEvent {
  public:
+  //只用于在堆上创建、持有所有权的事件；日志宏的事件构造在LogEventWrap的栈空间上，
+  //以const LogEvent&交给logger和appender，不会产生指向它的ptr
   typedef std::shared_ptr<LogEvent> ptr;
+  //local为true时内容写入线程本地缓冲，此时事件只能在创建它的线程、创建它的作用域内使用
   LogEvent(const char* file, int32_t line, uint32_t elapse, 
             uint32_t thread, uint32_t fiber, uint64_t time,
-            std::shared_ptr<Logger> logger, LogLevel::level level);
+            std::shared_ptr<Logger> logger, LogLevel::level level,
+            bool local = false);
 
   const char* getFile() const { return m_file; }
   int32_t getLineID() const { return m_line; }
   uint32_t getThreadID() const { return m_threadID; }
   uint32_t getFiberID() const { return m_fiberID; }
+  //线程名，指向Thread::GetNameCStr()返回的常驻字符串，未设置时为空串
+  const char* getThreadName() const { return m_threadName; }
+  void setThreadName(const char* name) { m_threadName = name ? name : ""; }
   uint32_t getElapse() const { return m_elapse; }
+  //秒级时间戳
   uint64_t getTime() const { return m_time; }
-  const std::string getContent() const { return m_ss.str(); }
-  std::stringstream& getSS() { return m_ss; }
-  std::shared_ptr<Logger> getLogger() const { return m_logger; }
+  //秒以下的微秒部分
+  uint32_t getUsec() const { return m_usec; }
+  //微秒级时间戳
+  uint64_t getTimeUs() const { return m_time * 1000000ul + m_usec; }
+  void setTimeUs(uint64_t us) { m_time = us / 1000000; m_usec = us % 1000000; }
+  const std::string getContent() const { return std::string(getContentData(), getContentSize()); }
+  const char* getContentData() const { render(); return m_ss.data() + m_argsSize; }
+  size_t getContentSize() const { render(); return m_ss.size() - m_argsSize; }
+  LogStream& getSS() { render(); return m_ss; }
+  //printf风格的事件在开启参数捕获时只保存格式串和编码后的参数，文本在第一次读取内容时才生成
+  //未捕获时格式串为空
+  const char* getFormat() const { return m_fmt; }
+  const char* getArgsData() const { return m_ss.data(); }
+  size_t getArgsSize() const { return m_argsSize; }
+  const std::shared_ptr<Logger>& getLogger() const { return m_logger; }
   LogLevel::level getLevel() const { return m_level; }
+  //调用点被强制打开时不受logger级别限制
+  bool isForced() const { return m_forced; }
+  void setForced(bool v) { m_forced = v; }
 
+  //fmt可以是运行时生成的字符串，立即生成文本
   void format(const char* fmt, ...);
   void format(const char* fmt, va_list al);
+  //开启参数捕获时只保存格式串的地址和编码后的参数，二进制appender按地址区分调用点，
+  //因此fmt必须是内容不变的字符串字面量
+  void formatLiteral(const char* fmt, ...);
+
+  //SYS_LOG_FMT_*宏的入口，按格式串的类型在编译期选择：const char数组（字符串字面量）
+  //走formatLiteral，char*、const char*和可写的数组走format
+  template<class F, class... Args>
+  void formatFmt(F&& fmt, Args... args) {
+    typedef typename std::remove_reference<F>::type R;
+    if (std::is_array<R>::value && std::is_const<typename std::remove_extent<R>::type>::value) {
+      formatLiteral(fmt, args...);
+    } else {
+      format(fmt, args...);
+    }
+  }
+
+  //{}占位符风格的格式化，参数通过LogStream按类型写入
+  //多出的参数被忽略，多出的占位符原样输出
+  template<class... Args>
+  void print(const char* fmt, const Args&... args) {
+    render();
+    printArgs(fmt, args...);
+  }
+
+  //添加一个结构化字段
+  template<class T>
+  LogEvent& with(const char* key, const T& v) {
+    m_fields.add(key, v);
+    return *this;
+  }
+  const LogFields& getFields() const { return m_fields; }
+
+  template<class T>
+  LogStream& operator<<(const T& v) {
+    return getSS() << v;
+  }
+
+ private:
+  //由捕获的参数生成文本，追加在参数之后
+  void render() const {
+    if (m_fmt && !m_rendered) {
+      renderArgs();
+    }
+  }
+  void renderArgs() const;
+
+  /**
+   * @brief 写入fmt中下一个占位符之前的文本
+   * @param[in] placeholder 为false时占位符按原文写入
+   * @return 占位符之后的位置，到达结尾时返回nullptr
+  */
+  const char* printText(const char* fmt, bool placeholder);
+
+  void printArgs(const char* fmt) {
+    if (fmt) {
+      printText(fmt, false);
+    }
+  }
+
+  template<class T, class... Args>
+  void printArgs(const char* fmt, const T& v, const Args&... args) {
+    if (!fmt || !(fmt = printText(fmt, true))) {
+      return;
+    }
+    m_ss << v;
+    printArgs(fmt, args...);
+  }
 
  private:
     //文件路径，行号，协程号，线程号，时间，文本
@@ -105,21 +441,49 @@ class LogEvent {
   uint32_t m_elapse = 0; //启动至今的时间间隔
   uint32_t m_threadID = 0;
   uint32_t m_fiberID = 0;
+  const char* m_threadName = "";
   uint64_t m_time = 0;
-  std::stringstream m_ss;
+  uint32_t m_usec = 0;
+  //捕获参数时前m_argsSize字节是编码后的参数，之后是生成的文本
+  mutable LogStream m_ss;
+  const char* m_fmt = nullptr;
+  uint32_t m_argsSize = 0;
+  mutable bool m_rendered = false;
   std::shared_ptr<Logger> m_logger;
   LogLevel::level m_level;
+  bool m_forced = false;
+  LogFields m_fields;
 };
 
+//析构时将事件提交给logger
 class LogEventWrap {
 public:
+  //持有val直到提交
   LogEventWrap(LogEvent::ptr val);
+  //日志宏使用的构造函数，线程id、线程名、协程id、启动至今的毫秒数和时间都在这里取得
+  //线程信息来自线程本地缓存，时间只读取一次单调时钟，整个过程没有系统调用
+  //record_only为true时事件只写入飞行记录器，不提交给logger
+  LogEventWrap(const char* file, int32_t line,
+            std::shared_ptr<Logger> logger, LogLevel::level level,
+            bool forced = false, bool record_only = false);
+  //事件直接构造在栈上并使用线程本地缓冲，整个过程没有内存分配
+  //time_us为微秒级时间戳
+  LogEventWrap(const char* file, int32_t line, uint32_t elapse,
+            uint32_t thread, uint32_t fiber, uint64_t time_us,
+            std::shared_ptr<Logger> logger, LogLevel::level level,
+            bool forced = false);
   ~LogEventWrap();
 
-  LogEvent::ptr getEvent() { return m_event; }
-  std::stringstream& getSS();
+  //事件只在本语句内有效
+  LogEvent* getEvent() { return m_event; }
+  LogStream& getSS();
 private:
-  LogEvent::ptr m_event;
+  LogEvent* m_event = nullptr;
+  //由LogEvent::ptr构造时持有所有权
+  LogEvent::ptr m_owner;
+  bool m_local = false;
+  bool m_recordOnly = false;
+  std::aligned_storage<sizeof(LogEvent), alignof(LogEvent)>::type m_storage;
 };
 
 //定义输出的格式
@@ -128,27 +492,119 @@ class LogFormatter {
   typedef std::shared_ptr<LogFormatter> ptr;
   LogFormatter(const std::string& pattern);
 
-    //处理为时-分-秒-线程ID-协程ID类似
-  std::string format(std::shared_ptr<Logger> logger, LogLevel::level level, LogEvent::ptr event);
+    //处理为时-分-秒-线程ID-协程ID类似，按编译后的指令生成后返回字符串
+  std::string format(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event);
+    //按编译后的指令直接追加到buf，不经过iostream，也不产生中间的std::string
+  void format(LogStream& buf, const std::shared_ptr<Logger>& logger, LogLevel::level level, const LogEvent& event);
 
-    //不同类日志格式的总控制类，之后的其他所有格式都继承自该类
-  class FormatterItem {
-   public:
-    typedef std::shared_ptr<FormatterItem> ptr;
-    virtual ~FormatterItem() {};
-    virtual void format(std::shared_ptr<Logger> logger, std::ostream& os, LogLevel::level level, LogEvent::ptr event) = 0;
-  };
+  //日期格式，支持strftime的全部格式以及 %3 毫秒 %6 微秒
+  //每个线程缓存当前秒的渲染结果，同一秒内只需拷贝并填入秒以下的数字
+  class DateFormat;
 
   bool is_Error() const { return m_error; }
   std::string getPattern() const { return m_pattern; }
 
   void init();
+
+  //pattern编译后的指令
+  struct Op {
+    enum Code {
+      LITERAL,  //常量字符串，%T %n 也会被合并进来
+      MESSAGE,
+      LEVEL,
+      ELAPSE,
+      NAME,
+      THREAD_ID,
+      THREAD_NAME,
+      FIBER_ID,
+      DATETIME,
+      LINE,
+      FILENAME,
+      FIELDS,   //key=value形式的结构化字段
+      JSON      //整条事件的JSON对象，m_dateFormats的下标
+    };
+    Code code;
+    //LITERAL: m_literals中的偏移和长度; DATETIME/JSON: m_dateFormats的下标
+    uint32_t offset;
+    uint32_t len;
+  };
+ private:
+  //添加一条常量指令，与前一条常量相邻时合并
+  void addLiteral(const std::string& str);
  private:
   std::string m_pattern;
-  std::vector<FormatterItem::ptr> m_items;
+  std::vector<Op> m_ops;
+  std::string m_literals;
+  std::vector<std::shared_ptr<DateFormat>> m_dateFormats;
   bool m_error = false;
 };
 
+//logger和appender的运行统计
+//前kShards-1个分片各由一个线程独占，只需普通的读改写，线程退出后分片交给之后的线程；
+//线程数超过时其余线程共用最后一个分片并使用原子加。分片数组按缓存行对齐单独分配，
+//每个分片正好占一个缓存行，读取时汇总所有分片
+//耗时只对每个线程每kSampleRate条事件中的一条计时，按比例放大后计入
+class LogMetrics : Noncopyable {
+ public:
+  enum Counter {
+    EVENTS = 0,     //交给输出的事件数
+    FILTERED,       //被级别过滤的事件数，只统计logger；日志宏的过滤在LogSite::SetCountFiltered(true)后才统计
+    THROTTLED,      //被限速或采样丢弃的事件数，只统计logger
+    BYTES,          //格式化后的字节数
+    ERRORS,         //写入失败次数，只统计appender
+    FORMAT_NS,      //格式化耗时
+    APPEND_NS,      //appender的log调用总耗时，减去格式化耗时即为I/O耗时
+    COUNTER_NUM
+  };
+  static const size_t kShards = 32;
+  static const uint32_t kSampleRate = 64;
+
+  LogMetrics();
+  ~LogMetrics();
+
+  void add(Counter c, uint64_t v = 1) {
+    size_t shard = LocalShard();
+    std::atomic<uint64_t>& value = m_shards[shard].values[c];
+    if (shard != kShards - 1) {
+      value.store(value.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    } else {
+      value.fetch_add(v, std::memory_order_relaxed);
+    }
+  }
+  uint64_t get(Counter c) const;
+
+  static const char* ToString(Counter c);
+
+  //当前线程的下一条事件是否计时
+  static bool Sample() {
+    static thread_local uint32_t t_events = 0;
+    return (t_events++ & (kSampleRate - 1)) == 0;
+  }
+  //当前线程正在计时的事件，appender据此统计格式化耗时
+  static bool IsTiming();
+  static void SetTiming(bool v);
+  //单调时钟纳秒
+  static uint64_t NowNs();
+ private:
+  //t_shard保存分片号加一，0表示尚未分配
+  static size_t LocalShard() {
+    static thread_local uint32_t t_shard = 0;
+    if (!t_shard) {
+      AcquireShard(&t_shard);
+    }
+    return t_shard - 1;
+  }
+  //分配分片，线程退出时归还并把*shard改为共用的分片
+  static void AcquireShard(uint32_t* shard);
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> values[(COUNTER_NUM + 7) / 8 * 8];
+  };
+  static_assert(sizeof(Shard) == 64, "LogMetrics::Shard must fill one cache line");
+  //LogMetrics本身嵌在只保证16字节对齐的堆对象中，分片数组用posix_memalign单独分配
+  Shard* m_shards;
+};
+
 //日志输出地
 class LogAppender {
   friend class Logger;
@@ -156,7 +612,9 @@ class LogAppender {
   typedef std::shared_ptr<LogAppender> ptr;
   virtual ~LogAppender() {};
 
-  virtual void log(std::shared_ptr<Logger> logger, LogLevel::level level, LogEvent::ptr event) = 0; 
+  //event只在本次调用期间有效，日志宏的事件在栈上；
+  //异步输出的appender必须在返回前格式化或复制出需要的内容
+  virtual void log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) = 0; 
 
   //TODO 为set get toyaml方法加锁
   void setFormater(LogFormatter::ptr val);
@@ -166,8 +624,17 @@ class LogAppender {
   LogLevel::level getLevel() const { return m_level; }
 
   virtual std::string toYamlString() = 0;
+
+  const LogMetrics& getMetrics() const { return m_metrics; }
  protected:
-  LogLevel::level m_level;
+  //格式化事件，字节数计入appender和logger的统计，正在计时的事件同时计入格式化耗时
+  void formatEvent(const LogFormatter::ptr& fmt, LogStream& buf, const std::shared_ptr<Logger>& logger,
+                   LogLevel::level level, const LogEvent& event);
+  //计入未经formatEvent生成的字节数
+  void countBytes(const std::shared_ptr<Logger>& logger, uint64_t bytes);
+ protected:
+  LogMetrics m_metrics;
+  LogLevel::level m_level = LogLevel::DEBUG;
   LogFormatter::ptr m_formatter;
   Mutex m_mutex;
   bool m_hasformatter = false; //是否有日志格式器
@@ -181,7 +648,10 @@ friend class LoggerManager;
   typedef std::shared_ptr<Logger> ptr;
 
   Logger(const std::string name = "root");
-  void log(LogLevel::level level, LogEvent::ptr event);
+  //地址可能被新的logger复用，析构时清空调用点的过滤缓存
+  ~Logger();
+  void log(LogLevel::level level, const LogEvent& event);
+  void log(LogLevel::level level, LogEvent::ptr event) { log(level, *event); }
 
   void debug(ptr logger, LogEvent::ptr event);
   void warn(ptr logger, LogEvent::ptr event);
@@ -189,34 +659,192 @@ friend class LoggerManager;
   void info(ptr logger, LogEvent::ptr event);
   void fatal(ptr logger, LogEvent::ptr event);
 
+  //appender列表以不可变快照的形式发布，修改时复制一份新的快照再原子替换，
+  //log路径在EpochGuard内直接读取裸指针，替换下来的快照交给Epoch，在后台线程释放
+  typedef std::vector<LogAppender::ptr> AppenderList;
+
   void addAppender(LogAppender::ptr appender);
+  //删除后其他线程可能仍在旧快照上调用它，旧快照在回收线程释放；
+  //需要确定appender的析构时机时，先调用Epoch::Synchronize()再释放自己持有的引用
   void delAppender(LogAppender::ptr appender);
   void clearAppenders();
-
-  LogLevel::level getLevel() { return m_level; }
-  void setLevel(LogLevel::level val) { m_level = val; }
+  //一次性删除del中的appender并追加add中的appender，只发布一次新快照
+  void updateAppenders(const AppenderList& del, const AppenderList& add);
+  std::shared_ptr<const AppenderList> getAppenders() const;
+
+  //生效的级别：自身未设置(UNKOWN)时沿点分层级向上继承，都未设置时为DEBUG
+  //解析结果和代数打包缓存在一个原子量里，代数未变化时只需两次原子读取
+  LogLevel::level getLevel() const {
+    uint64_t resolved = m_resolvedLevel.load(std::memory_order_acquire);
+    if ((resolved >> 8) == s_generation.load(std::memory_order_acquire)) {
+      return (LogLevel::level)(resolved & 0xff);
+    }
+    return resolveLevel();
+  }
+  void setLevel(LogLevel::level val);
+  //自身设置的级别，UNKOWN表示继承
+  LogLevel::level getOwnLevel() const { return m_level.load(std::memory_order_relaxed); }
   const std::string& getName() const { return m_name; }
+  //点分层级上的父logger，root和独立创建的logger为空
+  Logger::ptr getParent() const { return m_parent; }
+
+  //任何logger的级别变化时递增，缓存的解析结果随之失效
+  static uint64_t GetGeneration() { return s_generation.load(std::memory_order_acquire); }
+
+  //每个调用点每秒最多输出rate条，允许burst条的突发，rate为0表示不限速
+  void setRateLimit(uint32_t rate, uint32_t burst = 0);
+  uint32_t getRateLimit() const { return m_rateLimit.load(std::memory_order_relaxed); }
+  uint32_t getBurst() const { return m_burst.load(std::memory_order_relaxed); }
+  //每个调用点每n条只输出1条，0和1表示不采样
+  void setSampleRate(uint32_t n);
+  uint32_t getSampleRate() const { return m_sampleRate.load(std::memory_order_relaxed); }
+  //是否设置了限速或采样，调用点据此跳过节流检查
+  bool isThrottled() const { return m_throttled.load(std::memory_order_relaxed); }
 
   void setFormatter(const std::string& formatter);
   void setFormatter(const LogFormatter::ptr formatter);
   LogFormatter::ptr getFormatter();
 
   std::string toYamlString();
+
+  LogMetrics& getMetrics() { return m_metrics; }
+  const LogMetrics& getMetrics() const { return m_metrics; }
  private:
-  Logger::ptr m_root;
+  //发布新的appender快照，调用方需持有m_mutex
+  void publish(std::shared_ptr<const AppenderList> list);
+  //沿父logger解析生效的级别并缓存
+  LogLevel::level resolveLevel() const;
+  //沿父logger找到第一个非空的appender快照，调用方需在EpochGuard内
+  const AppenderList* resolveAppenders() const;
+ private:
+  static std::atomic<uint64_t> s_generation;
+
+  Logger::ptr m_parent;  //创建后不再修改
   std::string m_name;
-  LogLevel::level m_level;
-  std::list<LogAppender::ptr> m_appenders;  //用链表维护appenders
+  std::atomic<LogLevel::level> m_level;
+  mutable std::atomic<uint64_t> m_resolvedLevel;  //(代数 << 8) | 生效级别
+  std::shared_ptr<const AppenderList> m_appenders;  //持有当前快照，由m_mutex保护
+  std::atomic<const AppenderList*> m_appenderList;  //当前快照的裸指针，log路径不加锁读取
+  std::atomic<uint32_t> m_rateLimit;
+  std::atomic<uint32_t> m_burst;
+  std::atomic<uint32_t> m_sampleRate;
+  std::atomic<bool> m_throttled;
+  LogMetrics m_metrics;
   LogFormatter::ptr m_formatter;  //logger也需要一个formater  可能appender直接输出日志
-  // 互斥锁 线程安全
-  Mutex m_mutex;
+  // 互斥锁 只用于串行化修改，log路径不加锁
+  mutable Mutex m_mutex;
+};
+
+//日志调用点，每个SYS_LOG_*语句对应一个静态实例
+//状态可以在运行时按 "文件" 或 "文件:行号" 单独开关
+//被过滤的结果按(logger, 级别)缓存在调用点上，命中时只需一次读取和比较，
+//级别、开关或飞行记录器设置变化时清空所有调用点的缓存
+//logger设置了限速或采样时，每个调用点独立节流，被丢弃的条数每秒汇总输出一次
+//飞行记录器开启时，被过滤的事件仍然生成内容并只写入记录器
+class LogSite {
+ public:
+  enum State {
+    UNREGISTERED = 0, //首次执行，尚未登记
+    FOLLOW = 1,       //按logger级别过滤
+    FORCE_ON = 2,     //忽略logger级别，总是输出
+    FORCE_OFF = 3,    //总是不输出
+    RECORD_ONLY = 4   //只由check返回：事件被过滤，但需要写入飞行记录器
+  };
+
+  constexpr LogSite(const char* file, int32_t line)
+    :m_file(file), m_line(line), m_state(UNREGISTERED), m_filtered(0), m_next(nullptr) {}
+
+  //返回0表示不输出，否则返回当前状态
+  int check(const std::shared_ptr<Logger>& logger, LogLevel::level level) {
+    if (m_filtered.load(std::memory_order_relaxed) == FilterKey(logger.get(), level)) {
+      return 0;
+    }
+    return checkSlow(logger, level);
+  }
+
+  //飞行记录器是否开启
+  static bool IsRecording() { return s_flags.load(std::memory_order_relaxed) & RECORDING; }
+  static void SetRecording(bool v) { setFlag(RECORDING, v); }
+  //被级别过滤的事件是否计入logger的FILTERED统计，默认关闭，保持关闭时过滤只需一次判断
+  static bool IsCountingFiltered() { return s_flags.load(std::memory_order_relaxed) & COUNT_FILTERED; }
+  static void SetCountFiltered(bool v) { setFlag(COUNT_FILTERED, v); }
+
+  const char* getFile() const { return m_file; }
+  int32_t getLine() const { return m_line; }
+  State getState() const { return (State)m_state.load(std::memory_order_relaxed); }
+  //尚未汇总输出的丢弃条数
+  uint64_t getSuppressed() const { return m_suppressed.load(std::memory_order_relaxed); }
+
+  //设置调用点的开关，key为 "文件" 或 "文件:行号"，对已登记和之后登记的调用点都生效
+  static void SetState(const std::string& key, State state);
+  //整体替换所有开关，未出现的调用点恢复为FOLLOW
+  static void SetStates(const std::map<std::string, State>& states);
+  //已登记的调用点，"文件:行号" -> 状态
+  static std::map<std::string, State> ListSites();
+  //清空所有调用点缓存的过滤结果，logger级别变化或析构时调用
+  static void ClearFiltered();
+ private:
+  int checkSlow(const std::shared_ptr<Logger>& logger, LogLevel::level level);
+  //s_flags的各位
+  enum Flag {
+    RECORDING = 1,
+    COUNT_FILTERED = 2
+  };
+  static void setFlag(Flag flag, bool v) {
+    if (v) {
+      s_flags.fetch_or(flag, std::memory_order_relaxed);
+    } else {
+      s_flags.fetch_and(~flag, std::memory_order_relaxed);
+    }
+    ClearFiltered();
+  }
+  //缓存的键，logger按8字节对齐，低3位放级别
+  static uintptr_t FilterKey(const Logger* logger, LogLevel::level level) {
+    return (uintptr_t)logger | (uintptr_t)level;
+  }
+  //缓存本次被过滤的结果，epoch是计算结果之前读到的s_filterEpoch
+  void cacheFiltered(const Logger* logger, LogLevel::level level, uint64_t epoch);
+  //被过滤时的返回值
+  static int filtered() { return IsRecording() ? RECORD_ONLY : 0; }
+  //被logger级别过滤时的返回值，两个开关在同一个字节内，都关闭时只读一次
+  static int levelFiltered(const std::shared_ptr<Logger>& logger) {
+    int flags = s_flags.load(std::memory_order_relaxed);
+    if (!flags) {
+      return 0;
+    }
+    if (flags & COUNT_FILTERED) {
+      logger->getMetrics().add(LogMetrics::FILTERED);
+    }
+    return flags & RECORDING ? RECORD_ONLY : 0;
+  }
+  //按logger的限速和采样设置判断本次是否输出，不加锁
+  bool throttle(const std::shared_ptr<Logger>& logger, LogLevel::level level);
+  //记录一次丢弃
+  void suppress(const std::shared_ptr<Logger>& logger, LogLevel::level level, uint64_t now);
+  //距上次汇总超过1秒时输出 "suppressed N messages"
+  void report(const std::shared_ptr<Logger>& logger, LogLevel::level level, uint64_t now);
+ private:
+  const char* m_file;
+  int32_t m_line;
+  std::atomic<int8_t> m_state;
+  std::atomic<uintptr_t> m_filtered;  //上次被过滤的FilterKey，0表示没有缓存
+  LogSite* m_next;  //已登记调用点的链表
+  //节流状态
+  std::atomic<uint64_t> m_hits {0};        //采样计数
+  std::atomic<uint64_t> m_tat {0};         //令牌桶(GCRA)的理论到达时间，单调时钟微秒
+  std::atomic<uint64_t> m_suppressed {0};  //未汇总的丢弃条数
+  std::atomic<uint64_t> m_lastReport {0};  //上次汇总的时间，单调时钟微秒
+
+  static std::atomic<uint8_t> s_flags;
+  //每次清空缓存时加一，计算期间发生清空的结果不写入缓存
+  static std::atomic<uint64_t> s_filterEpoch;
 };
 
 //终端日志类
 class StdoutLogAppender : public LogAppender {
  public:
   typedef std::shared_ptr<StdoutLogAppender> ptr;
-  void log(std::shared_ptr<Logger> logger, LogLevel::level level, LogEvent::ptr event) override;
+  void log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) override;
   
   std::string toYamlString() override;
 };
@@ -227,7 +855,7 @@ class FileLogAppender : public LogAppender {
   FileLogAppender(const std::string& filename);
 
   typedef std::shared_ptr<FileLogAppender> ptr;
-  void log(std::shared_ptr<Logger> logger, LogLevel::level level, LogEvent::ptr event) override;
+  void log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) override;
   bool reopen(const std::string& filename);
 
   std::string toYamlString() override;
@@ -238,19 +866,36 @@ class FileLogAppender : public LogAppender {
 };
 
 //日志管理
+//logger按名字中的'.'组成层级，如net.http.server的父logger为net.http，
+//创建时补齐所有祖先，顶层logger的父logger为root
 class LoggerManager {
 public:
+  typedef std::map<std::string, Logger::ptr> LoggerMap;
+
   LoggerManager();
 
+  //查找已存在的logger时在EpochGuard内读取不可变快照的裸指针，不加锁也不修改快照的引用计数，
+  //只复制找到的Logger::ptr；不存在时加锁创建
   Logger::ptr getLogger(const std::string& name);
   void init();
 
   Logger::ptr getRoot() const { return m_root; }
 
   std::string toYamlstring();
+
+  //所有logger及其appender的运行统计，I/O耗时为appender总耗时减去格式化耗时
+  std::string metricsToYamlString();
+  std::string metricsToJsonString();
+private:
+  //加锁复制快照，创建logger及缺失的祖先后发布
+  Logger::ptr addLogger(const std::string& name);
+  //加锁取得当前快照，用于遍历所有logger
+  std::shared_ptr<const LoggerMap> getLoggers();
 private:
-  std::map<std::string, Logger::ptr> m_loggers;
+  std::shared_ptr<const LoggerMap> m_loggers;  //当前快照的所有者，由m_mutex保护
+  std::atomic<const LoggerMap*> m_loggerMap;  //当前快照的裸指针，getLogger不加锁读取
   Logger::ptr m_root;
+  // 串行化创建，保护m_loggers
   Mutex m_mutex;
 };
 
@@ -0,0 +1,346 @@
+#include "log_async.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+
+namespace noobnet {
+
+// 后台线程空闲时的最长休眠时间
+static const uint64_t s_async_idle_ms = 100;
+// 批量缓冲的初始容量
+static const size_t s_async_batch_bytes = 256 * 1024;
+
+static std::atomic<uint64_t> s_ring_buffer_group_id {0};
+
+// 当前线程在各个缓冲区集合中注册的缓冲区
+static thread_local std::vector<std::pair<uint64_t, LogRingBuffer::ptr>> t_ring_buffers;
+
+LogRingBuffer::LogRingBuffer(size_t capacity)
+    :m_closed(false)
+    ,m_head(0)
+    ,m_tail(0) {
+    m_capacity = 4096;
+    while (m_capacity < capacity) {
+        m_capacity <<= 1;
+    }
+    m_mask = m_capacity - 1;
+    m_data = new char[m_capacity];
+}
+
+LogRingBuffer::~LogRingBuffer() {
+    delete[] m_data;
+}
+
+bool LogRingBuffer::push(const char* data, size_t len) {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    uint64_t tail = m_tail.load(std::memory_order_acquire);
+    if (m_capacity - (head - tail) < len) {
+        return false;
+    }
+    size_t pos = head & m_mask;
+    size_t first = std::min(len, m_capacity - pos);
+    memcpy(m_data + pos, data, first);
+    memcpy(m_data, data + first, len - first);
+    m_head.store(head + len, std::memory_order_release);
+    return true;
+}
+
+size_t LogRingBuffer::pop(std::string& out) {
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    size_t len = head - tail;
+    if (len == 0) {
+        return 0;
+    }
+    size_t pos = tail & m_mask;
+    size_t first = std::min(len, m_capacity - pos);
+    out.append(m_data + pos, first);
+    out.append(m_data, len - first);
+    m_tail.store(head, std::memory_order_release);
+    return len;
+}
+
+size_t LogRingBuffer::size() const {
+    return m_head.load(std::memory_order_acquire)
+        - m_tail.load(std::memory_order_acquire);
+}
+
+LogRingBufferGroup::LogRingBufferGroup(size_t queue_size)
+    :m_id(++s_ring_buffer_group_id)
+    ,m_queueSize(queue_size)
+    ,m_sleeping(false)
+    ,m_stopping(false)
+    ,m_rounds(0) {
+}
+
+LogRingBufferGroup::~LogRingBufferGroup() {
+    stop();
+}
+
+void LogRingBufferGroup::start(DrainFunc drain, uint32_t idle, const std::string& name) {
+    m_drain = drain;
+    m_idle = idle;
+    m_thread.reset(new Thread(std::bind(&LogRingBufferGroup::run, this), name));
+}
+
+void LogRingBufferGroup::stop() {
+    if (m_thread) {
+        m_stopping = true;
+        wakeup();
+        m_thread->join();
+        m_thread.reset();
+    }
+    Mutex::Lock lock(m_buffersMutex);
+    for (auto& i : m_buffers) {
+        i->close();
+    }
+    m_buffers.clear();
+}
+
+LogRingBuffer::ptr LogRingBufferGroup::getLocalBuffer() {
+    for (auto& i : t_ring_buffers) {
+        if (i.first == m_id) {
+            return i.second;
+        }
+    }
+    // 顺便清理已析构appender留下的缓冲区
+    t_ring_buffers.erase(std::remove_if(t_ring_buffers.begin(), t_ring_buffers.end(),
+        [] (const std::pair<uint64_t, LogRingBuffer::ptr>& i) {
+            return i.second->isClosed();
+        }), t_ring_buffers.end());
+
+    LogRingBuffer::ptr buf(new LogRingBuffer(m_queueSize));
+    {
+        Mutex::Lock lock(m_buffersMutex);
+        m_buffers.push_back(buf);
+    }
+    t_ring_buffers.push_back(std::make_pair(m_id, buf));
+    return buf;
+}
+
+size_t LogRingBufferGroup::pop(std::string& out) {
+    size_t total = 0;
+    Mutex::Lock lock(m_buffersMutex);
+    for (auto it = m_buffers.begin(); it != m_buffers.end();) {
+        total += (*it)->pop(out);
+        // 只剩这里持有的缓冲区说明所属线程已经退出
+        if (it->use_count() == 1 && (*it)->size() == 0) {
+            it = m_buffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return total;
+}
+
+size_t LogRingBufferGroup::size() {
+    size_t depth = 0;
+    Mutex::Lock lock(m_buffersMutex);
+    for (auto& i : m_buffers) {
+        depth += i->size();
+    }
+    return depth;
+}
+
+void LogRingBufferGroup::wakeup() {
+    if (m_sleeping.exchange(false)) {
+        m_semophore.notify();
+    }
+}
+
+void LogRingBufferGroup::flush() {
+    // 等待一个在调用之后才开始的完整轮次
+    uint64_t target = m_rounds.load() + 2;
+    while (m_rounds.load() < target && !m_stopping) {
+        wakeup();
+        usleep(100);
+    }
+}
+
+void LogRingBufferGroup::run() {
+    while (true) {
+        bool stopping = m_stopping;
+        size_t n = m_drain();
+        ++m_rounds;
+        if (n) {
+            continue;
+        }
+        if (stopping) {
+            break;
+        }
+        m_sleeping = true;
+        if (size() || m_stopping) {
+            m_sleeping = false;
+            continue;
+        }
+        m_semophore.timedwait(m_idle);
+        m_sleeping = false;
+    }
+}
+
+const char* AsyncLogAppender::PolicyToString(OverflowPolicy policy) {
+    switch (policy) {
+    case BLOCK:
+        return "block";
+    case DROP:
+        return "drop";
+    case DROP_BELOW_LEVEL:
+        return "drop_below_level";
+    default:
+        return "block";
+    }
+}
+
+AsyncLogAppender::OverflowPolicy AsyncLogAppender::PolicyFromString(const std::string& str) {
+    std::string v = str;
+    std::transform(v.begin(), v.end(), v.begin(), ::tolower);
+    if (v == "drop") {
+        return DROP;
+    }
+    if (v == "drop_below_level" || v == "drop_below") {
+        return DROP_BELOW_LEVEL;
+    }
+    return BLOCK;
+}
+
+AsyncLogAppender::AsyncLogAppender(const std::string& filename, size_t queue_size,
+                                   OverflowPolicy policy, LogLevel::level drop_level)
+    :m_filename(filename)
+    ,m_policy(policy)
+    ,m_dropLevel(drop_level)
+    ,m_buffers(queue_size)
+    ,m_dropped(0)
+    ,m_blocked(0)
+    ,m_written(0)
+    ,m_writeErrors(0) {
+    if (m_filename.empty()) {
+        m_fd = STDOUT_FILENO;
+    } else {
+        m_fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (m_fd < 0) {
+            std::cout << "AsyncLogAppender open file error: " << m_filename
+                      << " errno=" << errno << " " << strerror(errno) << std::endl;
+        }
+    }
+    m_batch.reserve(s_async_batch_bytes);
+    m_buffers.start(std::bind(&AsyncLogAppender::drain, this), s_async_idle_ms, "log_async");
+}
+
+AsyncLogAppender::~AsyncLogAppender() {
+    m_buffers.stop();
+    if (m_fd >= 0 && m_fd != STDOUT_FILENO) {
+        ::close(m_fd);
+    }
+}
+
+void AsyncLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) {
+    if (level < m_level) {
+        return;
+    }
+    LogFormatter::ptr fmt;
+    {
+        Mutex::Lock lock(m_mutex);
+        fmt = m_formatter;
+    }
+    if (!fmt) {
+        return;
+    }
+    LogStream line(true);
+    formatEvent(fmt, line, logger, level, event);
+
+    LogRingBuffer::ptr buf = m_buffers.getLocalBuffer();
+    if (line.size() > buf->capacity()) {
+        // 单条超过缓冲区容量，直接同步写出。
+        // 先等本线程已入队的日志被取走，drain持有m_writeMutex直到写完，
+        // 拿到锁时它们已经写出，同一线程的日志不会乱序
+        while (buf->size() > 0 && !m_buffers.isStopping()) {
+            m_buffers.wakeup();
+            usleep(50);
+        }
+        Mutex::Lock lock(m_writeMutex);
+        writeAll(line.data(), line.size());
+        return;
+    }
+    if (!buf->push(line.data(), line.size())) {
+        bool block = m_policy == BLOCK
+            || (m_policy == DROP_BELOW_LEVEL && level >= m_dropLevel);
+        if (!block) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_blocked.fetch_add(1, std::memory_order_relaxed);
+        do {
+            m_buffers.wakeup();
+            usleep(50);
+        } while (!buf->push(line.data(), line.size()));
+    }
+    m_buffers.notify();
+}
+
+void AsyncLogAppender::flush() {
+    m_buffers.flush();
+}
+
+size_t AsyncLogAppender::getQueueDepth() {
+    return m_buffers.size();
+}
+
+void AsyncLogAppender::writeAll(const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t rt = ::write(m_fd, data, len);
+        if (rt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.add(LogMetrics::ERRORS);
+            return;
+        }
+        data += rt;
+        len -= rt;
+        m_written.fetch_add(rt, std::memory_order_relaxed);
+    }
+}
+
+size_t AsyncLogAppender::drain() {
+    // 取出和写出都在m_writeMutex内，超长日志的同步写出据此保证顺序
+    Mutex::Lock wlock(m_writeMutex);
+    size_t total = m_buffers.pop(m_batch);
+    if (!m_batch.empty()) {
+        writeAll(m_batch.c_str(), m_batch.size());
+        m_batch.clear();
+    }
+    return total;
+}
+
+std::string AsyncLogAppender::toYamlString() {
+    Mutex::Lock lock(m_mutex);
+    YAML::Node node;
+    if (m_filename.empty()) {
+        node["type"] = "StdoutLogAppender";
+    } else {
+        node["type"] = "FileLogAppender";
+        node["file"] = m_filename;
+    }
+    node["async"] = true;
+    node["queue_size"] = m_buffers.getQueueSize();
+    node["overflow"] = PolicyToString(m_policy);
+    if (m_policy == DROP_BELOW_LEVEL) {
+        node["drop_level"] = LogLevel::ToString(m_dropLevel);
+    }
+    if (m_level != LogLevel::UNKOWN) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasformatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+} // noobnet
@@ -0,0 +1,285 @@
+#ifndef __NOOBNET_LOG_ASYNC_
+#define __NOOBNET_LOG_ASYNC_
+
+#include "log.h"
+#include "thread.h"
+#include "mutex.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <stdint.h>
+
+namespace noobnet {
+
+/**
+ * @brief 单生产者单消费者的字节环形缓冲区
+ * @details 每个写日志的线程独占一个缓冲区作为生产者，后台刷盘线程作为唯一的消费者，
+ *          读写位置只通过原子变量同步，生产者写入时不需要加锁
+*/
+class LogRingBuffer : Noncopyable {
+public:
+    typedef std::shared_ptr<LogRingBuffer> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] capacity 缓冲区字节数，会向上取整为2的幂
+    */
+    LogRingBuffer(size_t capacity);
+
+    /**
+     * @brief 析构函数
+    */
+    ~LogRingBuffer();
+
+    /**
+     * @brief 写入一条完整的记录（生产者调用）
+     * @return 剩余空间不足时返回false，不会写入部分数据
+    */
+    bool push(const char* data, size_t len);
+
+    /**
+     * @brief 取出缓冲区内的全部数据并追加到out（消费者调用）
+     * @details 生产者只发布完整的记录，因此取出的数据总是以记录边界结尾
+     * @return 取出的字节数
+    */
+    size_t pop(std::string& out);
+
+    /**
+     * @brief 当前待消费的字节数
+    */
+    size_t size() const;
+
+    /**
+     * @brief 缓冲区容量
+    */
+    size_t capacity() const { return m_capacity; }
+
+    /**
+     * @brief 关闭缓冲区，所属的appender析构时调用，线程缓存据此清理
+    */
+    void close() { m_closed.store(true, std::memory_order_release); }
+    bool isClosed() const { return m_closed.load(std::memory_order_acquire); }
+private:
+    char* m_data = nullptr;
+    size_t m_capacity = 0;
+    size_t m_mask = 0;
+    std::atomic<bool> m_closed;
+    // 读写位置放在不同的缓存行，避免生产者与消费者互相干扰
+    char m_pad0[64];
+    std::atomic<uint64_t> m_head;  // 生产者写入位置
+    char m_pad1[64];
+    std::atomic<uint64_t> m_tail;  // 消费者读取位置
+    char m_pad2[64];
+};
+
+/**
+ * @brief 按线程分配的环形缓冲区集合及汇总它们的后台线程
+ * @details 每个写日志的线程第一次写入时注册自己的缓冲区，线程退出后缓冲区在取空时移除；
+ *          后台线程循环调用drain，没有数据时休眠idle毫秒或等待唤醒。
+ *          异步输出地和syslog输出地共用，drain决定取出的数据如何写出
+*/
+class LogRingBufferGroup : Noncopyable {
+public:
+    // 取出并写出一轮数据，返回取出的字节数
+    typedef std::function<size_t()> DrainFunc;
+
+    /**
+     * @brief 构造函数
+     * @param[in] queue_size 每个线程缓冲区的字节数
+    */
+    LogRingBufferGroup(size_t queue_size);
+
+    /**
+     * @brief 析构函数，停止后台线程并关闭所有缓冲区
+    */
+    ~LogRingBufferGroup();
+
+    /**
+     * @brief 启动后台线程，所属appender构造完成后调用
+     * @param[in] drain 每一轮的处理函数
+     * @param[in] idle 没有数据时的最长休眠时间（毫秒）
+     * @param[in] name 线程名
+    */
+    void start(DrainFunc drain, uint32_t idle, const std::string& name);
+
+    /**
+     * @brief 取出剩余数据后停止后台线程，所属appender析构时先调用，重复调用无效果
+    */
+    void stop();
+
+    /**
+     * @brief 获取当前线程的缓冲区，首次调用时注册
+    */
+    LogRingBuffer::ptr getLocalBuffer();
+
+    /**
+     * @brief 取出所有缓冲区的数据并追加到out，所属线程已退出的空缓冲区顺便移除
+     * @return 取出的字节数
+    */
+    size_t pop(std::string& out);
+
+    /**
+     * @brief 所有缓冲区中待取出的字节数
+    */
+    size_t size();
+
+    /**
+     * @brief 唤醒正在休眠的后台线程
+    */
+    void wakeup();
+
+    /**
+     * @brief 写入之后调用，只在后台线程休眠时唤醒
+     * @details 后台线程在休眠前会再检查一次缓冲区，这里漏掉的唤醒最多延迟一个休眠周期
+    */
+    void notify() {
+        if (m_sleeping.load(std::memory_order_relaxed)) {
+            wakeup();
+        }
+    }
+
+    /**
+     * @brief 阻塞直到调用时已写入的数据全部被drain处理
+    */
+    void flush();
+
+    bool isStopping() const { return m_stopping.load(std::memory_order_relaxed); }
+    size_t getQueueSize() const { return m_queueSize; }
+private:
+    /**
+     * @brief 后台线程执行函数
+    */
+    void run();
+private:
+    // 唯一id，用于线程缓存的查找
+    uint64_t m_id;
+    size_t m_queueSize;
+    uint32_t m_idle = 0;
+    DrainFunc m_drain;
+
+    Mutex m_buffersMutex;
+    std::vector<LogRingBuffer::ptr> m_buffers;
+
+    Thread::ptr m_thread;
+    Semophore m_semophore;
+    std::atomic<bool> m_sleeping;
+    std::atomic<bool> m_stopping;
+    // 已完成的轮数，flush据此等待
+    std::atomic<uint64_t> m_rounds;
+};
+
+/**
+ * @brief 异步日志输出地
+ * @details 调用线程只负责格式化并写入自己的环形缓冲区，
+ *          由专门的后台线程汇总所有缓冲区，攒批后通过write(2)写入文件或标准输出
+*/
+class AsyncLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<AsyncLogAppender> ptr;
+
+    /**
+     * @brief 缓冲区写满时的处理策略
+    */
+    enum OverflowPolicy {
+        // 等待后台线程腾出空间
+        BLOCK = 0,
+        // 直接丢弃
+        DROP = 1,
+        // 低于drop_level的丢弃，其余等待
+        DROP_BELOW_LEVEL = 2
+    };
+
+    static const char* PolicyToString(OverflowPolicy policy);
+    static OverflowPolicy PolicyFromString(const std::string& str);
+
+    /**
+     * @brief 构造函数
+     * @param[in] filename 输出文件，为空时输出到标准输出
+     * @param[in] queue_size 每个线程环形缓冲区的字节数
+     * @param[in] policy 缓冲区写满时的策略
+     * @param[in] drop_level DROP_BELOW_LEVEL策略下保留的最低级别
+    */
+    AsyncLogAppender(const std::string& filename,
+                     size_t queue_size = 1024 * 1024,
+                     OverflowPolicy policy = BLOCK,
+                     LogLevel::level drop_level = LogLevel::WARN);
+
+    /**
+     * @brief 析构函数，等待后台线程写完剩余数据
+    */
+    ~AsyncLogAppender();
+
+    void log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) override;
+    std::string toYamlString() override;
+
+    /**
+     * @brief 阻塞直到调用时已入队的数据全部写出
+    */
+    void flush();
+
+    const std::string& getFilename() const { return m_filename; }
+    size_t getQueueSize() const { return m_buffers.getQueueSize(); }
+    OverflowPolicy getPolicy() const { return m_policy; }
+    LogLevel::level getDropLevel() const { return m_dropLevel; }
+
+    /**
+     * @brief 所有线程缓冲区中待写出的字节数
+    */
+    size_t getQueueDepth();
+
+    /**
+     * @brief 因缓冲区满被丢弃的日志条数
+    */
+    uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 因缓冲区满而等待过的日志条数
+    */
+    uint64_t getBlocked() const { return m_blocked.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 已写出的字节数
+    */
+    uint64_t getWritten() const { return m_written.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief write失败的次数
+    */
+    uint64_t getWriteErrors() const { return m_writeErrors.load(std::memory_order_relaxed); }
+private:
+    /**
+     * @brief 取出所有缓冲区的数据并写出
+     * @return 本轮取出的字节数
+    */
+    size_t drain();
+
+    /**
+     * @brief 将数据完整写入文件描述符，调用方持有m_writeMutex
+    */
+    void writeAll(const char* data, size_t len);
+private:
+    std::string m_filename;
+    int m_fd = -1;
+    OverflowPolicy m_policy;
+    LogLevel::level m_dropLevel;
+
+    // 所有线程注册的缓冲区及后台刷盘线程
+    LogRingBufferGroup m_buffers;
+    // 保证write调用之间的顺序，drain从取出到写完一直持有
+    Mutex m_writeMutex;
+    // 后台线程的批量缓冲
+    std::string m_batch;
+
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_blocked;
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_writeErrors;
+};
+
+} // noobnet
+
+#endif // !__NOOBNET_LOG_ASYNC_
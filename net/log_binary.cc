@@ -0,0 +1,711 @@
+#include "log_binary.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <functional>
+
+namespace noobnet {
+
+std::atomic<int> LogArgs::s_capturing {0};
+
+const char BinaryLogAppender::s_magic[8] = {'N', 'O', 'O', 'B', 'L', 'O', 'G', 1};
+
+namespace {
+
+enum Length {
+    LEN_NONE,
+    LEN_HH,
+    LEN_H,
+    LEN_L,
+    LEN_LL,
+    LEN_J,
+    LEN_Z,
+    LEN_T,
+    LEN_LD
+};
+
+// 重建的转换说明的最大长度
+static const size_t s_spec_max = 48;
+
+/**
+ * @brief 一个转换说明，各部分指向原格式串
+*/
+struct Spec {
+    const char* flags;
+    size_t flags_len;
+    const char* width;
+    size_t width_len;
+    bool width_star;
+    bool has_prec;
+    const char* prec;
+    size_t prec_len;
+    bool prec_star;
+    Length length;
+    char conv;
+    // 转换字符之后的位置
+    const char* end;
+};
+
+/**
+ * @brief 解析'%'之后的转换说明，不支持的写法返回false
+*/
+static bool ParseSpec(const char* p, Spec& s) {
+    const char* begin = p;
+    s.flags = p;
+    while (*p && strchr("-+ #0'", *p)) {
+        ++p;
+    }
+    s.flags_len = p - s.flags;
+
+    s.width = p;
+    s.width_star = *p == '*';
+    if (s.width_star) {
+        ++p;
+    } else {
+        while (isdigit(*p)) {
+            ++p;
+        }
+    }
+    s.width_len = p - s.width;
+    // 不支持 %1$d 形式的位置参数
+    if (*p == '$') {
+        return false;
+    }
+
+    s.has_prec = *p == '.';
+    s.prec_star = false;
+    s.prec = p;
+    s.prec_len = 0;
+    if (s.has_prec) {
+        ++p;
+        s.prec = p;
+        s.prec_star = *p == '*';
+        if (s.prec_star) {
+            ++p;
+        } else {
+            while (isdigit(*p)) {
+                ++p;
+            }
+        }
+        s.prec_len = p - s.prec;
+    }
+
+    s.length = LEN_NONE;
+    switch (*p) {
+    case 'h':
+        s.length = p[1] == 'h' ? LEN_HH : LEN_H;
+        p += s.length == LEN_HH ? 2 : 1;
+        break;
+    case 'l':
+        s.length = p[1] == 'l' ? LEN_LL : LEN_L;
+        p += s.length == LEN_LL ? 2 : 1;
+        break;
+    case 'q':
+        s.length = LEN_LL;
+        ++p;
+        break;
+    case 'j':
+        s.length = LEN_J;
+        ++p;
+        break;
+    case 'z':
+    case 'Z':
+        s.length = LEN_Z;
+        ++p;
+        break;
+    case 't':
+        s.length = LEN_T;
+        ++p;
+        break;
+    case 'L':
+        s.length = LEN_LD;
+        ++p;
+        break;
+    default:
+        break;
+    }
+
+    s.conv = *p;
+    if (!s.conv || !strchr("diouxXeEfFgGaAcsp", s.conv)) {
+        return false;
+    }
+    bool is_float = strchr("eEfFgGaA", s.conv) != nullptr;
+    if (s.length == LEN_LD && !is_float) {
+        return false;
+    }
+    if (is_float && s.length != LEN_NONE && s.length != LEN_L && s.length != LEN_LD) {
+        return false;
+    }
+    // 宽字符不支持
+    if ((s.conv == 'c' || s.conv == 's' || s.conv == 'p') && s.length != LEN_NONE) {
+        return false;
+    }
+    s.end = p + 1;
+    return (size_t)(s.end - begin) < s_spec_max - 8;
+}
+
+/**
+ * @brief 生成交给snprintf的转换说明，'*'保留，由调用方提供对应的参数
+*/
+static void BuildSpec(const Spec& s, const char* length, bool force_prec_star, char* out) {
+    char* p = out;
+    *p++ = '%';
+    memcpy(p, s.flags, s.flags_len);
+    p += s.flags_len;
+    memcpy(p, s.width, s.width_len);
+    p += s.width_len;
+    if (force_prec_star) {
+        *p++ = '.';
+        *p++ = '*';
+    } else if (s.has_prec) {
+        *p++ = '.';
+        memcpy(p, s.prec, s.prec_len);
+        p += s.prec_len;
+    }
+    size_t n = strlen(length);
+    memcpy(p, length, n);
+    p += n;
+    *p++ = s.conv;
+    *p = '\0';
+}
+
+/**
+ * @brief 按'*'参数的个数调用snprintf
+*/
+template<class T>
+static int Print(char* buf, size_t size, const char* spec, const int* stars, int nstars, T v) {
+    switch (nstars) {
+    case 0:
+        return snprintf(buf, size, spec, v);
+    case 1:
+        return snprintf(buf, size, spec, stars[0], v);
+    default:
+        return snprintf(buf, size, spec, stars[0], stars[1], v);
+    }
+}
+
+template<class T>
+static bool Append(LogStream& out, const char* spec, const int* stars, int nstars, T v) {
+    char buf[256];
+    int n = Print(buf, sizeof(buf), spec, stars, nstars, v);
+    if (n < 0) {
+        return false;
+    }
+    if ((size_t)n < sizeof(buf)) {
+        out.append(buf, n);
+        return true;
+    }
+    std::vector<char> big(n + 1);
+    Print(&big[0], big.size(), spec, stars, nstars, v);
+    out.append(&big[0], n);
+    return true;
+}
+
+static int64_t GetSigned(va_list& ap, Length length) {
+    switch (length) {
+    case LEN_HH:
+        return (signed char)va_arg(ap, int);
+    case LEN_H:
+        return (short)va_arg(ap, int);
+    case LEN_L:
+        return va_arg(ap, long);
+    case LEN_LL:
+        return va_arg(ap, long long);
+    case LEN_J:
+        return va_arg(ap, intmax_t);
+    case LEN_Z:
+        return va_arg(ap, ssize_t);
+    case LEN_T:
+        return va_arg(ap, ptrdiff_t);
+    default:
+        return va_arg(ap, int);
+    }
+}
+
+static uint64_t GetUnsigned(va_list& ap, Length length) {
+    switch (length) {
+    case LEN_HH:
+        return (unsigned char)va_arg(ap, unsigned int);
+    case LEN_H:
+        return (unsigned short)va_arg(ap, unsigned int);
+    case LEN_L:
+        return va_arg(ap, unsigned long);
+    case LEN_LL:
+        return va_arg(ap, unsigned long long);
+    case LEN_J:
+        return va_arg(ap, uintmax_t);
+    case LEN_Z:
+        return va_arg(ap, size_t);
+    case LEN_T:
+        return (uint64_t)va_arg(ap, ptrdiff_t);
+    default:
+        return va_arg(ap, unsigned int);
+    }
+}
+
+} // namespace
+
+void LogArgs::PutVarint(LogStream& out, uint64_t v) {
+    char buf[10];
+    size_t n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (char)v;
+    out.append(buf, n);
+}
+
+void LogArgs::PutString(LogStream& out, const char* data, size_t len) {
+    PutVarint(out, len);
+    out.append(data, len);
+}
+
+bool LogArgs::GetVarint(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LogArgs::GetString(const char*& p, const char* end, const char*& data, size_t& len) {
+    uint64_t n = 0;
+    if (!GetVarint(p, end, n) || n > (uint64_t)(end - p)) {
+        return false;
+    }
+    data = p;
+    len = n;
+    p += n;
+    return true;
+}
+
+bool LogArgs::Encode(LogStream& out, const char* fmt, va_list al) {
+    // 参数作为va_list传入后在x86_64上退化为指针，复制一份才能按引用传给辅助函数
+    va_list ap;
+    va_copy(ap, al);
+    bool ok = true;
+    for (const char* p = fmt; *p && ok; ++p) {
+        if (*p != '%') {
+            continue;
+        }
+        if (p[1] == '%') {
+            ++p;
+            continue;
+        }
+        Spec s;
+        if (!ParseSpec(p + 1, s)) {
+            ok = false;
+            break;
+        }
+        if (s.width_star) {
+            PutVarint(out, ZigZag(va_arg(ap, int)));
+        }
+        int prec = -1;
+        if (s.prec_star) {
+            prec = va_arg(ap, int);
+            PutVarint(out, ZigZag(prec));
+        } else if (s.has_prec) {
+            prec = atoi(std::string(s.prec, s.prec_len).c_str());
+        }
+        switch (s.conv) {
+        case 'd':
+        case 'i':
+            PutVarint(out, ZigZag(GetSigned(ap, s.length)));
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            PutVarint(out, GetUnsigned(ap, s.length));
+            break;
+        case 'c':
+            PutVarint(out, (unsigned char)va_arg(ap, int));
+            break;
+        case 'p':
+            PutVarint(out, (uintptr_t)va_arg(ap, void*));
+            break;
+        case 's': {
+            const char* str = va_arg(ap, const char*);
+            if (!str) {
+                str = "(null)";
+            }
+            // 有精度时字符串不一定以'\0'结尾
+            size_t len = prec >= 0 ? strnlen(str, prec) : strlen(str);
+            PutString(out, str, len);
+            break;
+        }
+        default: {
+            double d = s.length == LEN_LD ? (double)va_arg(ap, long double) : va_arg(ap, double);
+            out.append((const char*)&d, sizeof(d));
+            break;
+        }
+        }
+        p = s.end - 1;
+    }
+    va_end(ap);
+    return ok;
+}
+
+bool LogArgs::Render(const char* fmt, const char* data, size_t len, LogStream& out) {
+    const char* end = data + len;
+    const char* literal = fmt;
+    const char* p = fmt;
+    for (; *p; ++p) {
+        if (*p != '%') {
+            continue;
+        }
+        out.append(literal, p - literal);
+        if (p[1] == '%') {
+            out.append("%", 1);
+            ++p;
+            literal = p + 1;
+            continue;
+        }
+        Spec s;
+        if (!ParseSpec(p + 1, s)) {
+            return false;
+        }
+        int stars[2];
+        int nstars = 0;
+        uint64_t v = 0;
+        if (s.width_star) {
+            if (!GetVarint(data, end, v)) {
+                return false;
+            }
+            stars[nstars++] = (int)UnZigZag(v);
+        }
+        if (s.prec_star) {
+            if (!GetVarint(data, end, v)) {
+                return false;
+            }
+            stars[nstars++] = (int)UnZigZag(v);
+        }
+        char spec[s_spec_max];
+        bool ok = true;
+        switch (s.conv) {
+        case 'd':
+        case 'i':
+            BuildSpec(s, "ll", false, spec);
+            ok = GetVarint(data, end, v)
+                && Append(out, spec, stars, nstars, (long long)UnZigZag(v));
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            BuildSpec(s, "ll", false, spec);
+            ok = GetVarint(data, end, v)
+                && Append(out, spec, stars, nstars, (unsigned long long)v);
+            break;
+        case 'c':
+            BuildSpec(s, "", false, spec);
+            ok = GetVarint(data, end, v)
+                && Append(out, spec, stars, nstars, (int)v);
+            break;
+        case 'p':
+            BuildSpec(s, "", false, spec);
+            ok = GetVarint(data, end, v)
+                && Append(out, spec, stars, nstars, (void*)(uintptr_t)v);
+            break;
+        case 's': {
+            // 编码时已按精度截断，这里用实际长度作为精度
+            const char* str = nullptr;
+            size_t n = 0;
+            if (!GetString(data, end, str, n)) {
+                return false;
+            }
+            BuildSpec(s, "", true, spec);
+            nstars = s.width_star ? 1 : 0;
+            stars[nstars++] = (int)n;
+            ok = Append(out, spec, stars, nstars, str);
+            break;
+        }
+        default: {
+            double d = 0;
+            if (end - data < (ptrdiff_t)sizeof(d)) {
+                return false;
+            }
+            memcpy(&d, data, sizeof(d));
+            data += sizeof(d);
+            BuildSpec(s, "", false, spec);
+            ok = Append(out, spec, stars, nstars, d);
+            break;
+        }
+        }
+        if (!ok) {
+            return false;
+        }
+        p = s.end - 1;
+        literal = s.end;
+    }
+    out.append(literal, p - literal);
+    return true;
+}
+
+BinaryLogAppender::BinaryLogAppender(const std::string& filename, uint32_t buffer_size,
+                                     uint32_t flush_interval)
+    :m_filename(filename)
+    ,m_bufferSize(buffer_size)
+    ,m_flushInterval(std::max(flush_interval, 1u))
+    ,m_stopping(false)
+    ,m_events(0)
+    ,m_writeErrors(0) {
+    m_fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        std::cout << "BinaryLogAppender open file error: " << m_filename
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+    }
+    // 每次打开都开始新的一段，调用点id重新编号
+    m_buf.append(s_magic, sizeof(s_magic));
+    LogArgs::AddCapture();
+    m_thread.reset(new Thread(std::bind(&BinaryLogAppender::run, this), "log_binary"));
+}
+
+BinaryLogAppender::~BinaryLogAppender() {
+    LogArgs::DelCapture();
+    m_stopping = true;
+    m_semophore.notify();
+    m_thread->join();
+    Mutex::Lock lock(m_writeMutex);
+    writeBuffer();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+void BinaryLogAppender::writeBuffer() {
+    const char* data = m_buf.data();
+    size_t len = m_buf.size();
+    while (len > 0 && m_fd >= 0) {
+        ssize_t rt = ::write(m_fd, data, len);
+        if (rt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.add(LogMetrics::ERRORS);
+            break;
+        }
+        data += rt;
+        len -= rt;
+    }
+    m_buf.clear();
+}
+
+void BinaryLogAppender::flush() {
+    Mutex::Lock lock(m_writeMutex);
+    writeBuffer();
+}
+
+void BinaryLogAppender::run() {
+    while (!m_stopping) {
+        m_semophore.timedwait(m_flushInterval);
+        if (m_stopping) {
+            break;
+        }
+        flush();
+    }
+}
+
+void BinaryLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) {
+    if (level < m_level) {
+        return;
+    }
+    Site key;
+    key.file = event.getFile() ? event.getFile() : "";
+    key.line = event.getLineID();
+    key.level = level;
+    key.logger = logger.get();
+    key.fmt = event.getFormat();
+
+    Mutex::Lock lock(m_writeMutex);
+    auto it = m_sites.find(key);
+    uint32_t id = 0;
+    if (it == m_sites.end()) {
+        id = m_sites.size();
+        m_sites.insert(std::make_pair(key, id));
+        m_buf.append("S", 1);
+        LogArgs::PutVarint(m_buf, id);
+        LogArgs::PutString(m_buf, key.file, strlen(key.file));
+        LogArgs::PutVarint(m_buf, (uint32_t)key.line);
+        LogArgs::PutVarint(m_buf, level);
+        LogArgs::PutString(m_buf, logger->getName().c_str(), logger->getName().size());
+        LogArgs::PutString(m_buf, key.fmt ? key.fmt : "", key.fmt ? strlen(key.fmt) : 0);
+    } else {
+        id = it->second;
+    }
+
+    uint32_t name_id = 0;
+    const char* name = event.getThreadName();
+    auto nit = m_threadNames.find(name);
+    if (nit == m_threadNames.end()) {
+        name_id = m_threadNames.size();
+        m_threadNames.insert(std::make_pair(name, name_id));
+        m_buf.append("T", 1);
+        LogArgs::PutVarint(m_buf, name_id);
+        LogArgs::PutString(m_buf, name, strlen(name));
+    } else {
+        name_id = nit->second;
+    }
+
+    uint64_t time = event.getTimeUs();
+    size_t size = m_buf.size();
+    m_buf.append("E", 1);
+    LogArgs::PutVarint(m_buf, id);
+    LogArgs::PutVarint(m_buf, LogArgs::ZigZag((int64_t)(time - m_lastTime)));
+    m_lastTime = time;
+    LogArgs::PutVarint(m_buf, event.getElapse());
+    LogArgs::PutVarint(m_buf, event.getThreadID());
+    LogArgs::PutVarint(m_buf, name_id);
+    LogArgs::PutVarint(m_buf, event.getFiberID());
+    if (key.fmt) {
+        LogArgs::PutString(m_buf, event.getArgsData(), event.getArgsSize());
+    } else {
+        LogArgs::PutString(m_buf, event.getContentData(), event.getContentSize());
+    }
+    m_events.fetch_add(1, std::memory_order_relaxed);
+    countBytes(logger, m_buf.size() - size);
+    if (m_buf.size() >= m_bufferSize) {
+        writeBuffer();
+    }
+}
+
+std::string BinaryLogAppender::toYamlString() {
+    Mutex::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "BinaryLogAppender";
+    node["file"] = m_filename;
+    node["buffer_size"] = m_bufferSize;
+    node["flush_interval"] = m_flushInterval;
+    if (m_level != LogLevel::UNKOWN) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+BinaryLogReader::BinaryLogReader(const std::string& pattern)
+    :m_formatter(new LogFormatter(pattern)) {
+}
+
+int64_t BinaryLogReader::decode(const char* data, size_t len, LogStream& out) {
+    const char* p = data;
+    const char* end = data + len;
+    int64_t count = 0;
+    while (p < end) {
+        const char* record = p;
+        char tag = *p;
+        if (tag == BinaryLogAppender::s_magic[0]) {
+            if ((size_t)(end - p) < sizeof(BinaryLogAppender::s_magic)) {
+                break;
+            }
+            if (memcmp(p, BinaryLogAppender::s_magic, sizeof(BinaryLogAppender::s_magic))) {
+                return -1;
+            }
+            p += sizeof(BinaryLogAppender::s_magic);
+            m_sites.clear();
+            m_threadNames.clear();
+            m_lastTime = 0;
+            continue;
+        }
+        ++p;
+        uint64_t id = 0;
+        if (tag == 'S') {
+            uint64_t line = 0;
+            uint64_t level = 0;
+            const char* file = nullptr;
+            const char* name = nullptr;
+            const char* fmt = nullptr;
+            size_t file_len = 0;
+            size_t name_len = 0;
+            size_t fmt_len = 0;
+            if (!LogArgs::GetVarint(p, end, id)
+                    || !LogArgs::GetString(p, end, file, file_len)
+                    || !LogArgs::GetVarint(p, end, line)
+                    || !LogArgs::GetVarint(p, end, level)
+                    || !LogArgs::GetString(p, end, name, name_len)
+                    || !LogArgs::GetString(p, end, fmt, fmt_len)) {
+                p = record;
+                break;
+            }
+            if (id != m_sites.size()) {
+                return -1;
+            }
+            Site site;
+            site.file.assign(file, file_len);
+            site.line = line;
+            site.level = (LogLevel::level)level;
+            site.fmt.assign(fmt, fmt_len);
+            std::string logger_name(name, name_len);
+            std::shared_ptr<Logger>& logger = m_loggers[logger_name];
+            if (!logger) {
+                logger.reset(new Logger(logger_name));
+            }
+            site.logger = logger;
+            m_sites.push_back(site);
+        } else if (tag == 'T') {
+            const char* name = nullptr;
+            size_t name_len = 0;
+            if (!LogArgs::GetVarint(p, end, id)
+                    || !LogArgs::GetString(p, end, name, name_len)) {
+                p = record;
+                break;
+            }
+            if (id != m_threadNames.size()) {
+                return -1;
+            }
+            m_threadNames.push_back(std::string(name, name_len));
+        } else if (tag == 'E') {
+            uint64_t name_id = 0;
+            uint64_t delta = 0;
+            uint64_t elapse = 0;
+            uint64_t thread = 0;
+            uint64_t fiber = 0;
+            const char* payload = nullptr;
+            size_t payload_len = 0;
+            if (!LogArgs::GetVarint(p, end, id)
+                    || !LogArgs::GetVarint(p, end, delta)
+                    || !LogArgs::GetVarint(p, end, elapse)
+                    || !LogArgs::GetVarint(p, end, thread)
+                    || !LogArgs::GetVarint(p, end, name_id)
+                    || !LogArgs::GetVarint(p, end, fiber)
+                    || !LogArgs::GetString(p, end, payload, payload_len)) {
+                p = record;
+                break;
+            }
+            if (id >= m_sites.size() || name_id >= m_threadNames.size()) {
+                return -1;
+            }
+            Site& site = m_sites[id];
+            m_lastTime += LogArgs::UnZigZag(delta);
+            LogEvent::ptr event(new LogEvent(site.file.c_str(), site.line, elapse,
+                        thread, fiber, 0, site.logger, site.level));
+            event->setTimeUs(m_lastTime);
+            event->setThreadName(m_threadNames[name_id].c_str());
+            if (site.fmt.empty()) {
+                event->getSS().append(payload, payload_len);
+            } else {
+                LogArgs::Render(site.fmt.c_str(), payload, payload_len, event->getSS());
+            }
+            m_formatter->format(out, site.logger, site.level, *event);
+            ++count;
+        } else {
+            return -1;
+        }
+    }
+    return count;
+}
+
+} // noobnet
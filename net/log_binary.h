@@ -0,0 +1,206 @@
+#ifndef __NOOBNET_LOG_BINARY_
+#define __NOOBNET_LOG_BINARY_
+
+#include "log.h"
+#include "mutex.h"
+#include "thread.h"
+
+#include <stdarg.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <stdint.h>
+
+namespace noobnet {
+
+/**
+ * @brief printf风格参数的二进制编码
+ * @details 按格式串的转换说明依次取出参数：整数编码为varint（有符号数先做zigzag），
+ *          浮点数保存为8字节double，字符串保存为长度+内容，'*'指定的宽度和精度也按整数编码。
+ *          文本只在需要时按同一个格式串重新生成，输出与vsnprintf一致
+*/
+class LogArgs {
+public:
+    /**
+     * @brief 编码参数并追加到out
+     * @return 格式串含有不支持的转换说明（%n、宽字符等）时返回false，此时out中的内容无效
+    */
+    static bool Encode(LogStream& out, const char* fmt, va_list ap);
+
+    /**
+     * @brief 按格式串把编码后的参数还原为文本并追加到out
+     * @return 参数数据不完整时返回false，已生成的部分仍保留在out中
+    */
+    static bool Render(const char* fmt, const char* data, size_t len, LogStream& out);
+
+    /**
+     * @brief 是否需要捕获参数，存在二进制appender时为true
+    */
+    static bool IsCapturing() { return s_capturing.load(std::memory_order_relaxed) > 0; }
+    static void AddCapture() { ++s_capturing; }
+    static void DelCapture() { --s_capturing; }
+
+    static void PutVarint(LogStream& out, uint64_t v);
+    static void PutString(LogStream& out, const char* data, size_t len);
+    static bool GetVarint(const char*& p, const char* end, uint64_t& v);
+    static bool GetString(const char*& p, const char* end, const char*& data, size_t& len);
+    static uint64_t ZigZag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+    static int64_t UnZigZag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+private:
+    static std::atomic<int> s_capturing;
+};
+
+/**
+ * @brief 二进制日志输出地
+ * @details 文件由若干段组成，每次打开文件时写入一个文件头开始新的一段。段内记录：
+ *          - 调用点记录 'S' id file line level logger fmt ：每个调用点只写一次
+ *          - 线程名记录 'T' id name ：每个线程名只写一次
+ *          - 事件记录 'E' id 时间差(zigzag) elapse thread 线程名id fiber 负载长度 负载
+ *          printf风格的调用点负载是编码后的参数，流式调用点负载是文本内容。
+ *          不使用formatter，文本由离线工具 log_decode 按指定的pattern还原。
+ *          缓冲未满时由后台线程每隔flush_interval毫秒写出，记录不会长时间停留在内存中
+*/
+class BinaryLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<BinaryLogAppender> ptr;
+
+    //文件头，同时作为新一段的开始标记
+    static const char s_magic[8];
+
+    /**
+     * @brief 构造函数
+     * @param[in] filename 输出文件
+     * @param[in] buffer_size 缓冲的字节数，超过后写入文件，0表示每条都立即写入
+     * @param[in] flush_interval 数据在缓冲中停留的最长时间（毫秒），由后台线程写出
+    */
+    BinaryLogAppender(const std::string& filename, uint32_t buffer_size = 64 * 1024,
+                      uint32_t flush_interval = 100);
+
+    /**
+     * @brief 析构函数，写出缓冲中剩余的数据
+    */
+    ~BinaryLogAppender();
+
+    void log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) override;
+    std::string toYamlString() override;
+
+    /**
+     * @brief 写出缓冲中的数据
+    */
+    void flush();
+
+    const std::string& getFilename() const { return m_filename; }
+    uint32_t getBufferSize() const { return m_bufferSize; }
+    uint32_t getFlushInterval() const { return m_flushInterval; }
+
+    /**
+     * @brief 已写入的事件数
+    */
+    uint64_t getEvents() const { return m_events.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief write失败的次数
+    */
+    uint64_t getWriteErrors() const { return m_writeErrors.load(std::memory_order_relaxed); }
+private:
+    /**
+     * @brief 调用点，格式串和文件名都是字符串常量，直接按地址区分
+     * @details 只有LogEvent::formatLiteral会捕获格式串，运行时生成的格式串总是以文本写入，
+     *          不会因为复用同一块缓冲区而错用之前的格式串，也不会让调用点无限增长
+    */
+    struct Site {
+        const char* file;
+        int32_t line;
+        LogLevel::level level;
+        const Logger* logger;
+        const char* fmt;
+
+        bool operator==(const Site& o) const {
+            return file == o.file && line == o.line && level == o.level
+                && logger == o.logger && fmt == o.fmt;
+        }
+    };
+
+    struct SiteHash {
+        size_t operator()(const Site& s) const {
+            size_t h = std::hash<const void*>()(s.file);
+            h = h * 31 + s.line;
+            h = h * 31 + s.level;
+            h = h * 31 + std::hash<const void*>()(s.logger);
+            h = h * 31 + std::hash<const void*>()(s.fmt);
+            return h;
+        }
+    };
+
+    /**
+     * @brief 将m_buf写入文件，调用方需持有m_writeMutex
+    */
+    void writeBuffer();
+
+    /**
+     * @brief 后台线程执行函数，每隔flush_interval毫秒写出缓冲
+    */
+    void run();
+private:
+    std::string m_filename;
+    int m_fd = -1;
+    uint32_t m_bufferSize;
+    uint32_t m_flushInterval;
+
+    Thread::ptr m_thread;
+    Semophore m_semophore;
+    std::atomic<bool> m_stopping;
+
+    // 保护以下所有成员
+    Mutex m_writeMutex;
+    LogStream m_buf;
+    std::unordered_map<Site, uint32_t, SiteHash> m_sites;
+    // 线程名是常驻字符串，按地址区分
+    std::unordered_map<const char*, uint32_t> m_threadNames;
+    uint64_t m_lastTime = 0;
+
+    std::atomic<uint64_t> m_events;
+    std::atomic<uint64_t> m_writeErrors;
+};
+
+/**
+ * @brief 读取二进制日志并按pattern还原为文本
+*/
+class BinaryLogReader {
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] pattern 与LogFormatter相同的格式
+    */
+    BinaryLogReader(const std::string& pattern);
+
+    /**
+     * @brief 解析一段数据（可以是整个文件），把还原的文本追加到out
+     * @return 解析出的事件数，数据损坏时返回-1，结尾不完整的记录会被忽略
+    */
+    int64_t decode(const char* data, size_t len, LogStream& out);
+
+    LogFormatter::ptr getFormatter() const { return m_formatter; }
+private:
+    struct Site {
+        std::string file;
+        int32_t line;
+        LogLevel::level level;
+        std::shared_ptr<Logger> logger;
+        std::string fmt;
+    };
+private:
+    LogFormatter::ptr m_formatter;
+    std::vector<Site> m_sites;
+    // deque扩容时不移动已有元素，事件可以直接引用其中的字符串
+    std::deque<std::string> m_threadNames;
+    std::map<std::string, std::shared_ptr<Logger>> m_loggers;
+    uint64_t m_lastTime = 0;
+};
+
+} // noobnet
+
+#endif // !__NOOBNET_LOG_BINARY_
@@ -0,0 +1,282 @@
+#include "log_console.h"
+#include "utils.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace noobnet {
+
+// 单个数据块的大小，一块对应writev的一个iovec
+static const size_t s_console_block_size = 64 * 1024;
+// 非阻塞模式下析构时最多等待可写的时间
+static const uint64_t s_console_drain_ms = 1000;
+
+#ifdef IOV_MAX
+static const size_t s_console_iov_max = IOV_MAX;
+#else
+static const size_t s_console_iov_max = 1024;
+#endif
+
+ConsoleLogAppender::ConsoleLogAppender(bool to_stderr, uint32_t batch_size,
+                                       uint32_t flush_interval, bool nonblock, uint32_t backlog)
+    :m_stderr(to_stderr)
+    ,m_batchSize(std::max(batch_size, 1u))
+    ,m_flushInterval(std::max(flush_interval, 1u))
+    ,m_nonblock(nonblock)
+    ,m_backlogLimit(backlog)
+    ,m_flushing(false)
+    ,m_blocked(false)
+    ,m_stopping(false)
+    ,m_backlog(0)
+    ,m_maxBacklog(0)
+    ,m_flushes(0)
+    ,m_lastFlushUs(0)
+    ,m_maxFlushUs(0)
+    ,m_totalFlushUs(0)
+    ,m_written(0)
+    ,m_dropped(0)
+    ,m_wouldBlock(0)
+    ,m_writeErrors(0) {
+    int fd = m_stderr ? STDERR_FILENO : STDOUT_FILENO;
+    m_fd = fd;
+    if (m_nonblock) {
+        // 直接给fd设置O_NONBLOCK会影响共享同一个打开文件的父进程和std::cout，
+        // 所以重新打开一份独立的打开文件；普通文件上非阻塞无意义，dup即可保持偏移一致
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            m_fd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        } else {
+            std::string path = "/proc/self/fd/" + std::to_string(fd);
+            m_fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_NONBLOCK | O_CLOEXEC);
+            if (m_fd < 0) {
+                // socket等无法重新打开的，退化为共享打开文件并设置O_NONBLOCK
+                m_fd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+                if (m_fd >= 0) {
+                    ::fcntl(m_fd, F_SETFL, ::fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+                }
+            }
+        }
+        if (m_fd < 0) {
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.add(LogMetrics::ERRORS);
+            std::cout << "ConsoleLogAppender open nonblock fd error: errno="
+                      << errno << " " << strerror(errno) << std::endl;
+            m_fd = fd;
+        } else {
+            m_ownFd = true;
+        }
+    }
+    m_thread.reset(new Thread(std::bind(&ConsoleLogAppender::run, this), "log_console"));
+}
+
+ConsoleLogAppender::~ConsoleLogAppender() {
+    m_stopping = true;
+    m_semophore.notify();
+    m_thread->join();
+
+    if (m_nonblock) {
+        uint64_t deadline = GetMonotonicUS() + s_console_drain_ms * 1000;
+        flush();
+        while (getBacklog() > 0 && GetMonotonicUS() < deadline) {
+            struct pollfd pfd = {m_fd, POLLOUT, 0};
+            ::poll(&pfd, 1, 100);
+            flush();
+        }
+    } else {
+        flush();
+    }
+    if (m_ownFd) {
+        ::close(m_fd);
+    }
+}
+
+void ConsoleLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) {
+    if (level < m_level) {
+        return;
+    }
+    LogFormatter::ptr fmt;
+    {
+        Mutex::Lock lock(m_mutex);
+        fmt = m_formatter;
+    }
+    if (!fmt) {
+        return;
+    }
+    LogStream buf(true);
+    formatEvent(fmt, buf, logger, level, event);
+
+    size_t len = buf.size();
+    uint64_t pending;
+    {
+        Mutex::Lock lock(m_blocksMutex);
+        pending = m_backlog.load(std::memory_order_relaxed);
+        if (m_nonblock && pending + len > m_backlogLimit) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (m_blocks.empty() || m_blocks.back().size() + len > s_console_block_size) {
+            m_blocks.push_back(std::string());
+            m_blocks.back().reserve(std::max(len, s_console_block_size));
+        }
+        m_blocks.back().append(buf.data(), len);
+        pending = m_backlog.fetch_add(len, std::memory_order_relaxed) + len;
+    }
+    if (pending > m_maxBacklog.load(std::memory_order_relaxed)) {
+        m_maxBacklog.store(pending, std::memory_order_relaxed);
+    }
+    // 非阻塞模式下对端不可写时由后台线程等待，写线程不再重复尝试
+    if (pending >= m_batchSize && !m_blocked.load(std::memory_order_relaxed)) {
+        flush();
+    }
+}
+
+void ConsoleLogAppender::flush() {
+    if (m_nonblock) {
+        if (m_flushing.exchange(true, std::memory_order_acquire)) {
+            return;
+        }
+        m_blocked.store(!doFlush(), std::memory_order_relaxed);
+        m_flushing.store(false, std::memory_order_release);
+    } else {
+        Mutex::Lock lock(m_writeMutex);
+        doFlush();
+    }
+}
+
+bool ConsoleLogAppender::doFlush() {
+    std::vector<std::string> blocks;
+    std::vector<struct iovec> iov;
+    while (true) {
+        size_t offset;
+        {
+            Mutex::Lock lock(m_blocksMutex);
+            if (m_blocks.empty()) {
+                return true;
+            }
+            size_t n = std::min(m_blocks.size(), s_console_iov_max);
+            blocks.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                blocks[i].swap(m_blocks.front());
+                m_blocks.pop_front();
+            }
+            offset = m_headOffset;
+            m_headOffset = 0;
+        }
+
+        iov.resize(blocks.size());
+        uint64_t total = 0;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            size_t skip = i == 0 ? offset : 0;
+            iov[i].iov_base = &blocks[i][skip];
+            iov[i].iov_len = blocks[i].size() - skip;
+            total += iov[i].iov_len;
+        }
+
+        struct iovec* cur = &iov[0];
+        int cnt = iov.size();
+        uint64_t left = total;
+        bool again = false;
+        while (cnt > 0) {
+            uint64_t begin = GetMonotonicUS();
+            ssize_t rt = ::writev(m_fd, cur, cnt);
+            uint64_t used = GetMonotonicUS() - begin;
+            m_flushes.fetch_add(1, std::memory_order_relaxed);
+            m_lastFlushUs.store(used, std::memory_order_relaxed);
+            m_totalFlushUs.fetch_add(used, std::memory_order_relaxed);
+            if (used > m_maxFlushUs.load(std::memory_order_relaxed)) {
+                m_maxFlushUs.store(used, std::memory_order_relaxed);
+            }
+            if (rt < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    m_wouldBlock.fetch_add(1, std::memory_order_relaxed);
+                    again = true;
+                } else {
+                    // 写失败的数据无法重试，直接丢弃
+                    m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+                    m_metrics.add(LogMetrics::ERRORS);
+                    m_backlog.fetch_sub(left, std::memory_order_relaxed);
+                    left = 0;
+                }
+                break;
+            }
+            m_written.fetch_add(rt, std::memory_order_relaxed);
+            m_backlog.fetch_sub(rt, std::memory_order_relaxed);
+            left -= rt;
+            while (cnt > 0 && (size_t)rt >= cur->iov_len) {
+                rt -= cur->iov_len;
+                ++cur;
+                --cnt;
+            }
+            if (cnt > 0) {
+                cur->iov_base = (char*)cur->iov_base + rt;
+                cur->iov_len -= rt;
+            }
+        }
+
+        if (left > 0) {
+            // 没写完的数据放回队首，保持顺序
+            size_t first = cur - &iov[0];
+            size_t head = (char*)cur->iov_base - &blocks[first][0];
+            Mutex::Lock lock(m_blocksMutex);
+            for (size_t i = blocks.size(); i > first; --i) {
+                m_blocks.push_front(std::string());
+                m_blocks.front().swap(blocks[i - 1]);
+            }
+            m_headOffset = head;
+        }
+        if (again) {
+            return false;
+        }
+    }
+}
+
+void ConsoleLogAppender::run() {
+    while (!m_stopping) {
+        if (m_blocked.load(std::memory_order_relaxed)) {
+            struct pollfd pfd = {m_fd, POLLOUT, 0};
+            ::poll(&pfd, 1, m_flushInterval);
+        } else {
+            m_semophore.timedwait(m_flushInterval);
+        }
+        if (m_stopping) {
+            break;
+        }
+        flush();
+    }
+}
+
+std::string ConsoleLogAppender::toYamlString() {
+    Mutex::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "ConsoleLogAppender";
+    node["stream"] = m_stderr ? "stderr" : "stdout";
+    node["batch_size"] = m_batchSize;
+    node["flush_interval"] = m_flushInterval;
+    if (m_nonblock) {
+        node["nonblock"] = true;
+        node["backlog"] = m_backlogLimit;
+    }
+    if (m_level != LogLevel::UNKOWN) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasformatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+} // noobnet
@@ -0,0 +1,154 @@
+#ifndef __NOOBNET_LOG_CONSOLE_
+#define __NOOBNET_LOG_CONSOLE_
+
+#include "log.h"
+#include "thread.h"
+#include "mutex.h"
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+namespace noobnet {
+
+/**
+ * @brief 批量写出的标准输出/标准错误日志输出地
+ * @details 写线程只把格式化好的行追加到内存中的块里，攒够batch_size字节由写线程顺手用一次writev写出，
+ *          不足时由后台线程每隔flush_interval毫秒写出一次。
+ *          开启nonblock时使用非阻塞的文件描述符，收集端卡住时数据留在内存里，
+ *          超过backlog字节后新日志直接丢弃，写线程永远不会阻塞在write上
+*/
+class ConsoleLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<ConsoleLogAppender> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] to_stderr 输出到标准错误，否则输出到标准输出
+     * @param[in] batch_size 攒批的字节数
+     * @param[in] flush_interval 最长攒批时间（毫秒）
+     * @param[in] nonblock 是否使用非阻塞写
+     * @param[in] backlog 内存中最多积压的字节数
+    */
+    ConsoleLogAppender(bool to_stderr = false,
+                       uint32_t batch_size = 64 * 1024,
+                       uint32_t flush_interval = 100,
+                       bool nonblock = false,
+                       uint32_t backlog = 4 * 1024 * 1024);
+
+    /**
+     * @brief 析构函数，写出剩余的数据
+    */
+    ~ConsoleLogAppender();
+
+    void log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) override;
+    std::string toYamlString() override;
+
+    /**
+     * @brief 写出积压的数据
+     * @details 阻塞模式下等待写完；非阻塞模式下写到EAGAIN为止，其他线程正在写时直接返回
+    */
+    void flush();
+
+    bool isStderr() const { return m_stderr; }
+    uint32_t getBatchSize() const { return m_batchSize; }
+    uint32_t getFlushInterval() const { return m_flushInterval; }
+    bool isNonblock() const { return m_nonblock; }
+    uint32_t getBacklogLimit() const { return m_backlogLimit; }
+
+    /**
+     * @brief 当前积压的字节数
+    */
+    uint64_t getBacklog() const { return m_backlog.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 积压字节数的最大值
+    */
+    uint64_t getMaxBacklog() const { return m_maxBacklog.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief writev调用次数
+    */
+    uint64_t getFlushes() const { return m_flushes.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 最近一次/最长一次/累计的writev耗时（微秒）
+    */
+    uint64_t getLastFlushUs() const { return m_lastFlushUs.load(std::memory_order_relaxed); }
+    uint64_t getMaxFlushUs() const { return m_maxFlushUs.load(std::memory_order_relaxed); }
+    uint64_t getTotalFlushUs() const { return m_totalFlushUs.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 已写出的字节数
+    */
+    uint64_t getWritten() const { return m_written.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 因积压超限被丢弃的日志条数
+    */
+    uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 非阻塞写遇到EAGAIN的次数
+    */
+    uint64_t getWouldBlock() const { return m_wouldBlock.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief write失败的次数
+    */
+    uint64_t getWriteErrors() const { return m_writeErrors.load(std::memory_order_relaxed); }
+private:
+    /**
+     * @brief 执行一轮写出，调用方需持有写出权
+     * @return 遇到EAGAIN时返回false
+    */
+    bool doFlush();
+
+    /**
+     * @brief 后台线程执行函数
+    */
+    void run();
+private:
+    bool m_stderr;
+    uint32_t m_batchSize;
+    uint32_t m_flushInterval;
+    bool m_nonblock;
+    uint32_t m_backlogLimit;
+    int m_fd = -1;
+    // 是否需要在析构时关闭m_fd
+    bool m_ownFd = false;
+
+    // 保护m_blocks
+    Mutex m_blocksMutex;
+    // 待写出的数据块，第一块从m_headOffset开始有效
+    std::deque<std::string> m_blocks;
+    size_t m_headOffset = 0;
+
+    // 阻塞模式下串行化写出
+    Mutex m_writeMutex;
+    // 非阻塞模式下的写出权
+    std::atomic<bool> m_flushing;
+    // 上次写出遇到了EAGAIN，后台线程需要等待可写
+    std::atomic<bool> m_blocked;
+
+    Thread::ptr m_thread;
+    Semophore m_semophore;
+    std::atomic<bool> m_stopping;
+
+    std::atomic<uint64_t> m_backlog;
+    std::atomic<uint64_t> m_maxBacklog;
+    std::atomic<uint64_t> m_flushes;
+    std::atomic<uint64_t> m_lastFlushUs;
+    std::atomic<uint64_t> m_maxFlushUs;
+    std::atomic<uint64_t> m_totalFlushUs;
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_wouldBlock;
+    std::atomic<uint64_t> m_writeErrors;
+};
+
+} // noobnet
+
+#endif // !__NOOBNET_LOG_CONSOLE_
@@ -0,0 +1,436 @@
+#include "log_flight.h"
+#include "config.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <algorithm>
+
+namespace noobnet {
+
+namespace {
+
+/**
+ * @brief 一条记录
+ * @details seq在写入前清0、写完后置为序号+1，转储时前后两次读到相同的seq才认为内容完整。
+ *          文件名和线程名都是常驻字符串，只保存指针
+*/
+struct Slot {
+    std::atomic<uint64_t> seq;
+    uint64_t time_us;
+    const char* file;
+    const char* thread_name;
+    int32_t line;
+    uint32_t thread;
+    uint32_t fiber;
+    uint32_t elapse;
+    uint8_t level;
+    uint8_t logger_len;
+    uint16_t len;
+    char logger[20];
+    char text[FlightRecorder::kRecordSize - 72];
+};
+
+static_assert(sizeof(Slot) == FlightRecorder::kRecordSize, "flight record size mismatch");
+
+/**
+ * @brief 一个线程的环形缓冲
+ * @details 创建后不释放，线程退出时归还，之后创建的线程可以复用同样大小的缓冲，
+ *          已写入的记录在复用前仍然会被转储
+*/
+struct Buffer {
+    uint32_t mask;
+    std::atomic<bool> used;
+    std::atomic<uint64_t> head;  //已写入的条数
+    Buffer* next;
+    Slot slots[1];
+};
+
+static const uint32_t s_default_capacity = 1024;
+static const uint32_t s_min_capacity = 16;
+
+static std::atomic<uint32_t> s_capacity {s_default_capacity};
+static std::atomic<Buffer*> s_buffers {nullptr};
+//同一时刻只允许一次转储
+static std::atomic<bool> s_dumping {false};
+//断言已经转储过，随后的SIGABRT不再重复
+static std::atomic<bool> s_assert_dumped {false};
+static std::atomic<bool> s_handlers_installed {false};
+//安装前的处理方式，转储后交还给它
+static struct sigaction s_old_actions[NSIG];
+
+//转储路径，信号处理函数中直接读取，修改只在持有s_file_mutex时进行
+static char s_dump_file[256] = "flight_recorder.log";
+static Mutex s_file_mutex;
+
+static Buffer* AcquireBuffer() {
+    uint32_t cap = s_capacity.load(std::memory_order_relaxed);
+    for (Buffer* b = s_buffers.load(std::memory_order_acquire); b; b = b->next) {
+        bool used = false;
+        if (b->mask + 1 == cap && !b->used.load(std::memory_order_relaxed)
+                && b->used.compare_exchange_strong(used, true)) {
+            return b;
+        }
+    }
+    size_t size = offsetof(Buffer, slots) + sizeof(Slot) * cap;
+    Buffer* b = (Buffer*)calloc(1, size);
+    if (!b) {
+        return nullptr;
+    }
+    b->mask = cap - 1;
+    b->used.store(true, std::memory_order_relaxed);
+    b->head.store(0, std::memory_order_relaxed);
+    b->next = s_buffers.load(std::memory_order_relaxed);
+    while (!s_buffers.compare_exchange_weak(b->next, b, std::memory_order_release)) {
+    }
+    return b;
+}
+
+/**
+ * @brief 线程本地的缓冲句柄，线程退出时归还缓冲
+*/
+struct LocalBuffer {
+    Buffer* buffer = nullptr;
+
+    ~LocalBuffer() {
+        if (buffer) {
+            buffer->used.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local LocalBuffer t_flight_buffer;
+
+/**
+ * @brief 转储用的输出缓冲，只使用write
+*/
+class DumpWriter {
+public:
+    DumpWriter(int fd) :m_fd(fd) {}
+    ~DumpWriter() { flush(); }
+
+    void append(const char* data, size_t len) {
+        while (len) {
+            if (m_len == sizeof(m_buf)) {
+                flush();
+            }
+            size_t n = std::min(len, sizeof(m_buf) - m_len);
+            memcpy(m_buf + m_len, data, n);
+            m_len += n;
+            data += n;
+            len -= n;
+        }
+    }
+
+    void append(const char* str) { append(str, strlen(str)); }
+
+    void append(char c) { append(&c, 1); }
+
+    //width不为0时左侧补0到指定宽度
+    void append(uint64_t v, int width = 0) {
+        char tmp[24];
+        int i = sizeof(tmp);
+        do {
+            tmp[--i] = '0' + v % 10;
+            v /= 10;
+        } while (v && i > 0);
+        while ((int)sizeof(tmp) - i < width && i > 0) {
+            tmp[--i] = '0';
+        }
+        append(tmp + i, sizeof(tmp) - i);
+    }
+
+    void flush() {
+        size_t off = 0;
+        while (off < m_len) {
+            ssize_t n = ::write(m_fd, m_buf + off, m_len - off);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            off += n;
+        }
+        m_len = 0;
+    }
+private:
+    int m_fd;
+    size_t m_len = 0;
+    char m_buf[4096];
+};
+
+/**
+ * @brief 输出UTC时间 YYYY-MM-DD HH:MM:SS.uuuuuu，不调用gmtime等非异步信号安全的函数
+*/
+static void AppendTime(DumpWriter& w, uint64_t us) {
+    uint64_t secs = us / 1000000;
+    int64_t days = secs / 86400;
+    uint64_t rem = secs % 86400;
+    //公历日期换算(days from civil的逆运算)
+    days += 719468;
+    int64_t era = days / 146097;
+    uint64_t doe = days - era * 146097;
+    uint64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint64_t mp = (5 * doy + 2) / 153;
+    uint64_t day = doy - (153 * mp + 2) / 5 + 1;
+    uint64_t month = mp < 10 ? mp + 3 : mp - 9;
+    uint64_t year = yoe + era * 400 + (month <= 2);
+
+    w.append(year, 4);
+    w.append('-');
+    w.append(month, 2);
+    w.append('-');
+    w.append(day, 2);
+    w.append(' ');
+    w.append(rem / 3600, 2);
+    w.append(':');
+    w.append(rem / 60 % 60, 2);
+    w.append(':');
+    w.append(rem % 60, 2);
+    w.append('.');
+    w.append(us % 1000000, 6);
+}
+
+/**
+ * @brief 转储一个缓冲中仍然完整的记录，从旧到新
+*/
+static int DumpBuffer(DumpWriter& w, Buffer* b) {
+    uint64_t head = b->head.load(std::memory_order_acquire);
+    uint64_t cap = b->mask + 1;
+    uint64_t begin = head > cap ? head - cap : 0;
+    int count = 0;
+    Slot copy;
+    for (uint64_t i = begin; i < head; ++i) {
+        const Slot& s = b->slots[i & b->mask];
+        if (s.seq.load(std::memory_order_acquire) != i + 1) {
+            continue;
+        }
+        memcpy((char*)&copy + sizeof(copy.seq), (const char*)&s + sizeof(s.seq),
+                sizeof(Slot) - sizeof(Slot::seq));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        //拷贝期间被所属线程覆盖
+        if (s.seq.load(std::memory_order_relaxed) != i + 1) {
+            continue;
+        }
+        AppendTime(w, copy.time_us);
+        w.append(' ');
+        w.append((uint64_t)copy.elapse);
+        w.append("ms ");
+        w.append(LogLevel::ToString((LogLevel::level)copy.level));
+        w.append(" [");
+        w.append(copy.logger, copy.logger_len);
+        w.append("] ");
+        w.append((uint64_t)copy.thread);
+        w.append(':');
+        w.append(copy.thread_name ? copy.thread_name : "");
+        w.append(' ');
+        w.append((uint64_t)copy.fiber);
+        w.append(' ');
+        w.append(copy.file ? copy.file : "");
+        w.append(':');
+        w.append((uint64_t)copy.line);
+        w.append(' ');
+        w.append(copy.text, copy.len);
+        w.append('\n');
+        ++count;
+    }
+    return count;
+}
+
+static const char* SignalName(int sig) {
+    switch (sig) {
+#define XX(name) \
+    case name: \
+        return #name;
+
+    XX(SIGSEGV);
+    XX(SIGBUS);
+    XX(SIGFPE);
+    XX(SIGILL);
+    XX(SIGABRT);
+#undef XX
+    default:
+        return "signal";
+    }
+}
+
+static void OnFatalSignal(int sig, siginfo_t* info, void* ctx) {
+    if (FlightRecorder::IsEnabled() && !s_assert_dumped.load(std::memory_order_relaxed)) {
+        FlightRecorder::Dump(SignalName(sig));
+    }
+    //恢复原来的处理方式，之后同一信号直接交给它
+    const struct sigaction& old = s_old_actions[sig];
+    ::sigaction(sig, &old, nullptr);
+    if (old.sa_flags & SA_SIGINFO) {
+        old.sa_sigaction(sig, info, ctx);
+        return;
+    }
+    if (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN) {
+        old.sa_handler(sig);
+        return;
+    }
+    //原来是默认处理或忽略，按默认方式终止进程
+    ::signal(sig, SIG_DFL);
+    ::raise(sig);
+}
+
+} // namespace
+
+void FlightRecorder::SetEnabled(bool v) {
+    LogSite::SetRecording(v);
+}
+
+void FlightRecorder::SetCapacity(uint32_t records) {
+    uint32_t cap = s_min_capacity;
+    while (cap < records && cap < (1u << 31)) {
+        cap <<= 1;
+    }
+    s_capacity.store(cap, std::memory_order_relaxed);
+}
+
+uint32_t FlightRecorder::GetCapacity() {
+    return s_capacity.load(std::memory_order_relaxed);
+}
+
+void FlightRecorder::SetDumpFile(const std::string& path) {
+    Mutex::Lock lock(s_file_mutex);
+    size_t n = std::min(path.size(), sizeof(s_dump_file) - 1);
+    memcpy(s_dump_file, path.c_str(), n);
+    s_dump_file[n] = '\0';
+}
+
+std::string FlightRecorder::GetDumpFile() {
+    Mutex::Lock lock(s_file_mutex);
+    return s_dump_file;
+}
+
+void FlightRecorder::InstallSignalHandlers() {
+    if (s_handlers_installed.exchange(true)) {
+        return;
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = &OnFatalSignal;
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    int sigs[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    for (int sig : sigs) {
+        ::sigaction(sig, &sa, &s_old_actions[sig]);
+    }
+}
+
+void FlightRecorder::Record(const LogEvent& event) {
+    Buffer* b = t_flight_buffer.buffer;
+    if (!b) {
+        b = t_flight_buffer.buffer = AcquireBuffer();
+        if (!b) {
+            return;
+        }
+    }
+    uint64_t n = b->head.load(std::memory_order_relaxed);
+    Slot& s = b->slots[n & b->mask];
+    s.seq.store(0, std::memory_order_relaxed);
+    //信号处理函数可能在同一线程中途打断写入
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s.time_us = event.getTimeUs();
+    s.file = event.getFile();
+    s.thread_name = event.getThreadName();
+    s.line = event.getLineID();
+    s.thread = event.getThreadID();
+    s.fiber = event.getFiberID();
+    s.elapse = event.getElapse();
+    s.level = event.getLevel();
+    const std::string& name = event.getLogger()->getName();
+    s.logger_len = std::min(name.size(), sizeof(s.logger));
+    memcpy(s.logger, name.c_str(), s.logger_len);
+    s.len = std::min(event.getContentSize(), sizeof(s.text));
+    memcpy(s.text, event.getContentData(), s.len);
+
+    s.seq.store(n + 1, std::memory_order_release);
+    b->head.store(n + 1, std::memory_order_release);
+}
+
+int FlightRecorder::Dump(const char* reason) {
+    if (s_dumping.exchange(true, std::memory_order_acquire)) {
+        return 0;
+    }
+    int fd = ::open(s_dump_file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        s_dumping.store(false, std::memory_order_release);
+        return -1;
+    }
+    int count = 0;
+    {
+        DumpWriter w(fd);
+        w.append("==== flight recorder dump pid=");
+        w.append((uint64_t)::getpid());
+        w.append(" reason: ");
+        w.append(reason ? reason : "");
+        w.append(" ====\n");
+        for (Buffer* b = s_buffers.load(std::memory_order_acquire); b; b = b->next) {
+            count += DumpBuffer(w, b);
+        }
+        w.append("==== end of flight recorder dump, ");
+        w.append((uint64_t)count);
+        w.append(" records ====\n");
+    }
+    ::close(fd);
+    s_dumping.store(false, std::memory_order_release);
+    return count;
+}
+
+void FlightRecorder::DumpOnAssert(const char* expr) {
+    if (!IsEnabled()) {
+        return;
+    }
+    std::string reason = std::string("ASSERTION: ") + expr;
+    Dump(reason.c_str());
+    s_assert_dumped.store(true, std::memory_order_relaxed);
+}
+
+uint64_t FlightRecorder::GetRecorded() {
+    uint64_t total = 0;
+    for (Buffer* b = s_buffers.load(std::memory_order_acquire); b; b = b->next) {
+        total += b->head.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+static noobnet::ConfigVar<bool>::ptr g_flight_enabled =
+    noobnet::Config::LookUp(false, "flight_recorder.enabled", "flight recorder enabled");
+static noobnet::ConfigVar<uint32_t>::ptr g_flight_capacity =
+    noobnet::Config::LookUp(s_default_capacity, "flight_recorder.capacity",
+            "flight recorder records per thread");
+static noobnet::ConfigVar<std::string>::ptr g_flight_file =
+    noobnet::Config::LookUp(std::string("flight_recorder.log"), "flight_recorder.file",
+            "flight recorder dump file");
+
+struct FlightRecorderIniter {
+    FlightRecorderIniter() {
+        //回调在新值生效前执行，只能使用参数中的新值
+        g_flight_enabled->addListener([] (const bool&, const bool& v) {
+            if (v) {
+                FlightRecorder::InstallSignalHandlers();
+            }
+            FlightRecorder::SetEnabled(v);
+        });
+        g_flight_capacity->addListener([] (const uint32_t&, const uint32_t& v) {
+            FlightRecorder::SetCapacity(v);
+        });
+        g_flight_file->addListener([] (const std::string&, const std::string& v) {
+            FlightRecorder::SetDumpFile(v);
+        });
+    }
+};
+
+static FlightRecorderIniter __flight_recorder_init_;
+
+} // noobnet
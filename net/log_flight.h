@@ -0,0 +1,79 @@
+#ifndef __NOOBNET_LOG_FLIGHT_
+#define __NOOBNET_LOG_FLIGHT_
+
+#include "log.h"
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+namespace noobnet {
+
+/**
+ * @brief 日志飞行记录器
+ * @details 开启后每个线程在内存中保留最近的若干条日志事件，包括被logger级别过滤掉的事件。
+ *          每条事件占一个定长槽位，只有所属线程写入，写入时不加锁、不分配内存、不做格式化。
+ *          SYS_ASSERT失败或收到致命信号时把所有线程的记录追加写入文件，
+ *          转储过程只使用异步信号安全的系统调用
+*/
+class FlightRecorder {
+public:
+    /**
+     * @brief 单条记录的大小，超出部分的内容被截断
+    */
+    static const size_t kRecordSize = 256;
+
+    /**
+     * @brief 开启或关闭记录
+     * @details 开启时日志宏对被级别过滤、节流或关闭的事件也会生成内容，只写入记录器。
+     *          也可以通过配置项flight_recorder.enabled/capacity/file设置，
+     *          配置开启时同时安装信号处理函数
+    */
+    static void SetEnabled(bool v);
+    static bool IsEnabled() { return LogSite::IsRecording(); }
+
+    /**
+     * @brief 设置每个线程保留的记录条数，向上取整到2的幂，只对之后创建的缓冲生效
+    */
+    static void SetCapacity(uint32_t records);
+    static uint32_t GetCapacity();
+
+    /**
+     * @brief 设置转储文件路径，长度超过255字节时截断
+    */
+    static void SetDumpFile(const std::string& path);
+    static std::string GetDumpFile();
+
+    /**
+     * @brief 为SIGSEGV/SIGBUS/SIGFPE/SIGILL/SIGABRT安装转储处理函数，
+     *        转储后恢复安装前的处理方式并交给它，原来是默认处理时重新发出信号，
+     *        重复调用无效果
+    */
+    static void InstallSignalHandlers();
+
+    /**
+     * @brief 把事件写入当前线程的缓冲
+    */
+    static void Record(const LogEvent& event);
+
+    /**
+     * @brief 把所有线程的记录追加写入转储文件，异步信号安全
+     * @param[in] reason 写在转储开头的原因
+     * @return 写出的记录条数，打开文件失败返回-1
+    */
+    static int Dump(const char* reason);
+
+    /**
+     * @brief 断言失败时转储，之后的SIGABRT不再重复转储
+    */
+    static void DumpOnAssert(const char* expr);
+
+    /**
+     * @brief 已记录的事件总数
+    */
+    static uint64_t GetRecorded();
+};
+
+} // noobnet
+
+#endif // !__NOOBNET_LOG_FLIGHT_
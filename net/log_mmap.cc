@@ -0,0 +1,287 @@
+#include "log_mmap.h"
+#include "epoch.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <functional>
+
+namespace noobnet {
+
+// 后台线程的同步周期
+static const uint64_t s_mmap_sync_ms = 1000;
+
+MmapFileLogAppender::Chunk::Chunk(uint64_t i, char* a, uint64_t s)
+    :index(i)
+    ,addr(a)
+    ,size(s)
+    ,filled(0) {
+}
+
+MmapFileLogAppender::Chunk::~Chunk() {
+    ::munmap(addr, size);
+}
+
+MmapFileLogAppender::MmapFileLogAppender(const std::string& filename, uint64_t chunk_size)
+    :m_filename(filename)
+    ,m_offset(0)
+    ,m_stopping(false)
+    ,m_mappedChunks(0)
+    ,m_writeErrors(0) {
+    for (size_t i = 0; i < s_slots; ++i) {
+        m_chunks[i] = nullptr;
+    }
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    m_chunkSize = std::max(chunk_size, page);
+    m_chunkSize = (m_chunkSize + page - 1) / page * page;
+
+    m_fd = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.add(LogMetrics::ERRORS);
+        std::cout << "MmapFileLogAppender open file error: " << m_filename
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+    } else {
+        m_startOffset = findEnd();
+        m_offset = m_startOffset;
+    }
+    m_thread.reset(new Thread(std::bind(&MmapFileLogAppender::run, this), "log_mmap"));
+}
+
+MmapFileLogAppender::~MmapFileLogAppender() {
+    m_stopping = true;
+    m_semophore.notify();
+    m_thread->join();
+
+    // 析构时已没有写线程，直接释放
+    for (size_t i = 0; i < s_slots; ++i) {
+        if (m_owners[i]) {
+            ::msync(m_owners[i]->addr, m_owners[i]->size, MS_SYNC);
+        }
+        m_chunks[i] = nullptr;
+        m_owners[i].reset();
+    }
+    if (m_fd >= 0) {
+        // 去掉预扩展但未写入的部分
+        if (::ftruncate(m_fd, m_offset)) {
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.add(LogMetrics::ERRORS);
+        }
+        ::close(m_fd);
+    }
+}
+
+uint64_t MmapFileLogAppender::findEnd() {
+    struct stat st;
+    if (fstat(m_fd, &st) || st.st_size == 0) {
+        return 0;
+    }
+    // 上次异常退出时文件尾部会留下预扩展的0，向前找到最后一个非0字节
+    char buf[64 * 1024];
+    uint64_t end = st.st_size;
+    while (end > 0) {
+        uint64_t begin = end > sizeof(buf) ? end - sizeof(buf) : 0;
+        ssize_t n = ::pread(m_fd, buf, end - begin, begin);
+        if (n <= 0) {
+            return end;
+        }
+        for (ssize_t i = n - 1; i >= 0; --i) {
+            if (buf[i] != '\0') {
+                return begin + i + 1;
+            }
+        }
+        end = begin;
+    }
+    return 0;
+}
+
+MmapFileLogAppender::Chunk* MmapFileLogAppender::getChunk(uint64_t index, Chunk::ptr& hold) {
+    Chunk* c = m_chunks[index % s_slots].load(std::memory_order_acquire);
+    if (c && c->index == index) {
+        return c;
+    }
+    hold = mapChunk(index);
+    return hold.get();
+}
+
+MmapFileLogAppender::Chunk::ptr MmapFileLogAppender::mapChunk(uint64_t index) {
+    Mutex::Lock lock(m_mapMutex);
+    Chunk::ptr& owner = m_owners[index % s_slots];
+    Chunk::ptr old = owner;
+    if (old && old->index == index) {
+        return old;
+    }
+    if (m_fd < 0) {
+        return nullptr;
+    }
+    uint64_t begin = index * m_chunkSize;
+    // 预先分配磁盘空间，避免写映射区时因磁盘满触发SIGBUS
+    if (::fallocate(m_fd, 0, begin, m_chunkSize)) {
+        struct stat st;
+        if ((errno != EOPNOTSUPP && errno != ENOSYS) || fstat(m_fd, &st)
+                || ((uint64_t)st.st_size < begin + m_chunkSize
+                    && ::ftruncate(m_fd, begin + m_chunkSize))) {
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.add(LogMetrics::ERRORS);
+            return nullptr;
+        }
+    }
+    void* addr = ::mmap(nullptr, m_chunkSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, begin);
+    if (addr == MAP_FAILED) {
+        m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.add(LogMetrics::ERRORS);
+        return nullptr;
+    }
+    Chunk::ptr c(new Chunk(index, (char*)addr, m_chunkSize));
+    // 启动前已有的数据算作已写入
+    if (m_startOffset > begin) {
+        c->filled = std::min(m_startOffset - begin, m_chunkSize);
+    }
+    // 之前映射失败时跳过的字节
+    auto it = m_skipped.find(index);
+    if (it != m_skipped.end()) {
+        c->filled += it->second;
+        m_skipped.erase(it);
+    }
+    if (c->filled == c->size) {
+        {
+            Mutex::Lock lock(m_fullMutex);
+            m_full.push_back(index);
+        }
+        m_semophore.notify();
+    }
+    m_mappedChunks.fetch_add(1, std::memory_order_relaxed);
+    if (old && old->index > index) {
+        // 落后太多的写线程，单独映射，不占用槽位
+        return c;
+    }
+    m_chunks[index % s_slots].store(c.get(), std::memory_order_release);
+    owner = c;
+    if (old) {
+        // 被替换的旧块在所有写线程离开临界区后解除映射
+        ::msync(old->addr, old->size, MS_ASYNC);
+        Epoch::Retire(old);
+    }
+    return c;
+}
+
+void MmapFileLogAppender::fillChunk(Chunk* c, uint64_t n) {
+    if (c->filled.fetch_add(n, std::memory_order_acq_rel) + n == c->size) {
+        {
+            Mutex::Lock lock(m_fullMutex);
+            m_full.push_back(c->index);
+        }
+        m_semophore.notify();
+    }
+}
+
+void MmapFileLogAppender::skipChunk(uint64_t index, uint64_t n) {
+    m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+    m_metrics.add(LogMetrics::ERRORS);
+    Chunk::ptr c;
+    {
+        Mutex::Lock lock(m_mapMutex);
+        c = m_owners[index % s_slots];
+        if (!c || c->index != index) {
+            // 块还没有映射，留到映射时计入
+            m_skipped[index] += n;
+            return;
+        }
+    }
+    // 失败之后块已被其他线程映射
+    fillChunk(c.get(), n);
+}
+
+void MmapFileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) {
+    if (level < m_level) {
+        return;
+    }
+    LogFormatter::ptr fmt;
+    {
+        Mutex::Lock lock(m_mutex);
+        fmt = m_formatter;
+    }
+    if (!fmt) {
+        return;
+    }
+    LogStream buf(true);
+    formatEvent(fmt, buf, logger, level, event);
+
+    const char* data = buf.data();
+    uint64_t len = buf.size();
+    uint64_t offset = m_offset.fetch_add(len, std::memory_order_relaxed);
+    EpochGuard guard;
+    // 预留的区间可能跨越多个块，映射失败的部分也要计入，否则块永远不会写满
+    while (len > 0) {
+        uint64_t index = offset / m_chunkSize;
+        uint64_t pos = offset % m_chunkSize;
+        uint64_t n = std::min(len, m_chunkSize - pos);
+        Chunk::ptr hold;
+        Chunk* c = getChunk(index, hold);
+        if (c) {
+            memcpy(c->addr + pos, data, n);
+            fillChunk(c, n);
+        } else {
+            skipChunk(index, n);
+        }
+        offset += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void MmapFileLogAppender::run() {
+    while (!m_stopping) {
+        m_semophore.timedwait(s_mmap_sync_ms);
+        std::deque<uint64_t> full;
+        {
+            Mutex::Lock lock(m_fullMutex);
+            full.swap(m_full);
+        }
+        for (auto i : full) {
+            Mutex::Lock lock(m_mapMutex);
+            Chunk::ptr& owner = m_owners[i % s_slots];
+            if (owner && owner->index == i) {
+                ::msync(owner->addr, owner->size, MS_ASYNC);
+                m_chunks[i % s_slots].store(nullptr, std::memory_order_release);
+                Epoch::Retire(owner);
+                owner.reset();
+            }
+        }
+        if (m_fd < 0) {
+            continue;
+        }
+        // 提前映射当前块和下一个块，写线程基本不会走到mapChunk
+        uint64_t index = m_offset.load(std::memory_order_relaxed) / m_chunkSize;
+        Chunk::ptr hold;
+        EpochGuard guard;
+        Chunk* c = getChunk(index, hold);
+        if (c) {
+            ::msync(c->addr, c->size, MS_ASYNC);
+        }
+        getChunk(index + 1, hold);
+    }
+}
+
+std::string MmapFileLogAppender::toYamlString() {
+    Mutex::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "MmapFileLogAppender";
+    node["file"] = m_filename;
+    node["chunk_size"] = m_chunkSize;
+    if (m_level != LogLevel::UNKOWN) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasformatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+} // noobnet
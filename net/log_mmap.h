@@ -0,0 +1,142 @@
+#ifndef __NOOBNET_LOG_MMAP_
+#define __NOOBNET_LOG_MMAP_
+
+#include "log.h"
+#include "thread.h"
+#include "mutex.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+namespace noobnet {
+
+/**
+ * @brief 基于mmap的文件日志输出地
+ * @details 文件按块用fallocate预先扩展并映射到内存，写线程通过原子fetch_add预留
+ *          一段字节区间后直接memcpy到映射区，正常路径上没有系统调用也没有锁；
+ *          写满的块由后台线程msync并解除映射，同时提前映射下一个块。
+ *          数据写入映射区后即进入页缓存，进程崩溃也不会丢失
+*/
+class MmapFileLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<MmapFileLogAppender> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] filename 日志文件路径
+     * @param[in] chunk_size 每次扩展并映射的字节数，向上取整为页大小的倍数
+    */
+    MmapFileLogAppender(const std::string& filename, uint64_t chunk_size = 4 * 1024 * 1024);
+
+    /**
+     * @brief 析构函数，同步所有映射并把文件截断到实际写入的长度
+    */
+    ~MmapFileLogAppender();
+
+    void log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) override;
+    std::string toYamlString() override;
+
+    const std::string& getFilename() const { return m_filename; }
+    uint64_t getChunkSize() const { return m_chunkSize; }
+
+    /**
+     * @brief 已预留的文件长度（即下一条日志的写入位置）
+    */
+    uint64_t getOffset() const { return m_offset.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 累计映射过的块数
+    */
+    uint64_t getMappedChunks() const { return m_mappedChunks.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 扩展或映射文件失败的次数
+    */
+    uint64_t getWriteErrors() const { return m_writeErrors.load(std::memory_order_relaxed); }
+private:
+    /**
+     * @brief 文件中一个已映射的块，最后一个引用释放时解除映射
+    */
+    struct Chunk {
+        typedef std::shared_ptr<Chunk> ptr;
+        Chunk(uint64_t index, char* addr, uint64_t size);
+        ~Chunk();
+
+        uint64_t index;
+        char* addr;
+        uint64_t size;
+        // 已写入的字节数，等于size时说明块已写满
+        std::atomic<uint64_t> filled;
+    };
+
+    /**
+     * @brief 获取第index个块，不存在时扩展文件并映射
+     * @details 调用方必须处于EpochGuard内，槽位中的块直接返回裸指针，
+     *          不占用槽位的块由hold持有
+    */
+    Chunk* getChunk(uint64_t index, Chunk::ptr& hold);
+
+    /**
+     * @brief 扩展文件并映射第index个块
+    */
+    Chunk::ptr mapChunk(uint64_t index);
+
+    /**
+     * @brief 记录写入第index个块的n个字节，块写满时交给后台线程
+    */
+    void fillChunk(Chunk* c, uint64_t n);
+
+    /**
+     * @brief 映射失败时跳过第index个块中预留的n个字节，仍然计入已写入的字节数
+    */
+    void skipChunk(uint64_t index, uint64_t n);
+
+    /**
+     * @brief 启动时查找已有文件中最后一条日志的结尾
+    */
+    uint64_t findEnd();
+
+    /**
+     * @brief 后台线程执行函数
+    */
+    void run();
+private:
+    // 同时保留的块槽位数，第i块放在 i % s_slots 的位置
+    static const size_t s_slots = 8;
+
+    std::string m_filename;
+    int m_fd = -1;
+    uint64_t m_chunkSize;
+
+    // 启动时文件中已有数据的长度
+    uint64_t m_startOffset = 0;
+    // 下一条日志的写入位置
+    std::atomic<uint64_t> m_offset;
+    // 写线程在EpochGuard内读取槽位中的裸指针，被替换的块交给Epoch释放
+    std::atomic<Chunk*> m_chunks[s_slots];
+    // 槽位中块的所有权，只在持有m_mapMutex时修改
+    Chunk::ptr m_owners[s_slots];
+    // 串行化扩展与映射
+    Mutex m_mapMutex;
+    // 映射失败时跳过的字节数，块之后映射成功时计入filled
+    std::map<uint64_t, uint64_t> m_skipped;
+
+    // 已写满待同步的块
+    Mutex m_fullMutex;
+    std::deque<uint64_t> m_full;
+
+    Thread::ptr m_thread;
+    Semophore m_semophore;
+    std::atomic<bool> m_stopping;
+
+    std::atomic<uint64_t> m_mappedChunks;
+    std::atomic<uint64_t> m_writeErrors;
+};
+
+} // noobnet
+
+#endif // !__NOOBNET_LOG_MMAP_
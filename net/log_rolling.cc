@@ -0,0 +1,355 @@
+#include "log_rolling.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <zlib.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace noobnet {
+
+// 后台线程的检查周期
+static const uint64_t s_rolling_check_ms = 1000;
+
+/**
+ * @brief 将src压缩为gzip格式的dst，成功后删除src
+*/
+static bool GzipFile(const std::string& src, const std::string& dst) {
+    int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    gzFile out = gzopen(dst.c_str(), "wb6");
+    if (!out) {
+        ::close(in);
+        return false;
+    }
+    bool ok = true;
+    std::vector<char> buf(64 * 1024);
+    while (true) {
+        ssize_t n = ::read(in, &buf[0], buf.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (gzwrite(out, &buf[0], n) != n) {
+            ok = false;
+            break;
+        }
+    }
+    if (gzclose(out) != Z_OK) {
+        ok = false;
+    }
+    ::close(in);
+    if (ok) {
+        ::unlink(src.c_str());
+    } else {
+        ::unlink(dst.c_str());
+    }
+    return ok;
+}
+
+const char* RollingFileLogAppender::CompressToString(Compress c) {
+    switch (c) {
+    case GZIP:
+        return "gzip";
+    default:
+        return "none";
+    }
+}
+
+RollingFileLogAppender::Compress RollingFileLogAppender::CompressFromString(const std::string& str) {
+    std::string v = str;
+    std::transform(v.begin(), v.end(), v.begin(), ::tolower);
+    if (v == "gzip" || v == "gz") {
+        return GZIP;
+    }
+    return NONE;
+}
+
+RollingFileLogAppender::File::File(RollingFileLogAppender* o, int f, uint64_t s, uint64_t t)
+    :owner(o)
+    ,fd(f)
+    ,opened(t)
+    ,size(s)
+    ,rolling(false) {
+}
+
+RollingFileLogAppender::File::~File() {
+    ::close(fd);
+    if (!rolled.empty()) {
+        owner->onReleased(rolled);
+    }
+}
+
+RollingFileLogAppender::RollingFileLogAppender(const std::string& filename, uint64_t max_size,
+                                               uint32_t interval, uint32_t max_files, Compress compress)
+    :m_filename(filename)
+    ,m_maxSize(max_size)
+    ,m_interval(interval)
+    ,m_maxFiles(max_files)
+    ,m_compress(compress)
+    ,m_rotateRequested(false)
+    ,m_stopping(false)
+    ,m_rotations(0)
+    ,m_writeErrors(0) {
+    m_file = openFile();
+    loadHistory();
+    m_thread.reset(new Thread(std::bind(&RollingFileLogAppender::run, this), "log_rolling"));
+}
+
+RollingFileLogAppender::~RollingFileLogAppender() {
+    {
+        RWMutex::WriteLock lock(m_fileMutex);
+        m_file.reset();
+    }
+    m_stopping = true;
+    m_semophore.notify();
+    m_thread->join();
+}
+
+RollingFileLogAppender::File::ptr RollingFileLogAppender::openFile() {
+    int fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.add(LogMetrics::ERRORS);
+        std::cout << "RollingFileLogAppender open file error: " << m_filename
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    struct stat st;
+    uint64_t size = 0;
+    if (fstat(fd, &st) == 0) {
+        size = st.st_size;
+    }
+    return File::ptr(new File(this, fd, size, time(0)));
+}
+
+void RollingFileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) {
+    if (level < m_level) {
+        return;
+    }
+    LogFormatter::ptr fmt;
+    {
+        Mutex::Lock lock(m_mutex);
+        fmt = m_formatter;
+    }
+    if (!fmt) {
+        return;
+    }
+    LogStream buf(true);
+    formatEvent(fmt, buf, logger, level, event);
+
+    File::ptr file;
+    {
+        RWMutex::ReadLock lock(m_fileMutex);
+        file = m_file;
+    }
+    if (!file) {
+        m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.add(LogMetrics::ERRORS);
+        return;
+    }
+    // O_APPEND保证整行写入不会与其他线程交错
+    const char* data = buf.data();
+    size_t len = buf.size();
+    while (len > 0) {
+        ssize_t rt = ::write(file->fd, data, len);
+        if (rt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.add(LogMetrics::ERRORS);
+            return;
+        }
+        data += rt;
+        len -= rt;
+    }
+    uint64_t size = file->size.fetch_add(buf.size(), std::memory_order_relaxed) + buf.size();
+    if (m_maxSize && size >= m_maxSize && !file->rolling.exchange(true)) {
+        rotate();
+    }
+}
+
+void RollingFileLogAppender::rotate() {
+    m_rotateRequested = true;
+    m_semophore.notify();
+}
+
+std::string RollingFileLogAppender::rolledName() {
+    struct tm tm;
+    time_t now = time(0);
+    localtime_r(&now, &tm);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y%m%d-%H%M%S", &tm);
+    std::string base = m_filename + "." + buf;
+    std::string name = base;
+    // 同一秒内多次滚动时追加序号
+    for (int i = 1; access(name.c_str(), F_OK) == 0
+            || access((name + ".gz").c_str(), F_OK) == 0; ++i) {
+        name = base + "." + std::to_string(i);
+    }
+    return name;
+}
+
+void RollingFileLogAppender::doRotate() {
+    File::ptr cur;
+    {
+        RWMutex::ReadLock lock(m_fileMutex);
+        cur = m_file;
+    }
+    if (!cur) {
+        // 之前打开失败，重试
+        File::ptr nf = openFile();
+        RWMutex::WriteLock lock(m_fileMutex);
+        m_file = nf;
+        return;
+    }
+    if (cur->size == 0) {
+        cur->opened = time(0);
+        cur->rolling = false;
+        return;
+    }
+    std::string rolled = rolledName();
+    if (::rename(m_filename.c_str(), rolled.c_str())) {
+        m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.add(LogMetrics::ERRORS);
+        cur->rolling = false;
+        return;
+    }
+    File::ptr nf = openFile();
+    if (!nf) {
+        // 新文件打不开时继续写已改名的文件
+        cur->rolling = false;
+        return;
+    }
+    cur->rolled = rolled;
+    {
+        RWMutex::WriteLock lock(m_fileMutex);
+        m_file = nf;
+    }
+    // 仍在写旧文件的线程释放引用后，旧文件才会进入压缩队列
+    cur.reset();
+    m_rotations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RollingFileLogAppender::onReleased(const std::string& path) {
+    {
+        Mutex::Lock lock(m_jobsMutex);
+        m_jobs.push_back(path);
+    }
+    m_semophore.notify();
+}
+
+void RollingFileLogAppender::processRolled() {
+    std::deque<std::string> jobs;
+    {
+        Mutex::Lock lock(m_jobsMutex);
+        jobs.swap(m_jobs);
+    }
+    for (auto& i : jobs) {
+        std::string path = i;
+        if (m_compress == GZIP && GzipFile(i, i + ".gz")) {
+            path = i + ".gz";
+        }
+        m_history.push_back(path);
+    }
+    if (m_maxFiles) {
+        while (m_history.size() > m_maxFiles) {
+            ::unlink(m_history.front().c_str());
+            m_history.pop_front();
+        }
+    }
+}
+
+void RollingFileLogAppender::loadHistory() {
+    std::string dir = ".";
+    std::string base = m_filename;
+    size_t pos = m_filename.rfind('/');
+    if (pos != std::string::npos) {
+        dir = pos == 0 ? "/" : m_filename.substr(0, pos);
+        base = m_filename.substr(pos + 1);
+    }
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+    std::string prefix = base + ".";
+    std::vector<std::string> files;
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(d)) != nullptr) {
+        std::string name = dp->d_name;
+        // 只认 <file>.<YYYYmmdd-HHMMSS>... 形式的文件
+        if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0
+                && isdigit(name[prefix.size()])) {
+            files.push_back(pos == std::string::npos ? name : dir + "/" + name);
+        }
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+    m_history.assign(files.begin(), files.end());
+}
+
+void RollingFileLogAppender::run() {
+    while (true) {
+        m_semophore.timedwait(s_rolling_check_ms);
+        bool stopping = m_stopping;
+        if (!stopping) {
+            bool need = m_rotateRequested.exchange(false);
+            if (!need && m_interval) {
+                RWMutex::ReadLock lock(m_fileMutex);
+                need = m_file && (uint64_t)time(0) >= m_file->opened + m_interval;
+            }
+            if (need) {
+                doRotate();
+            }
+        }
+        processRolled();
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+std::string RollingFileLogAppender::toYamlString() {
+    Mutex::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "RollingFileLogAppender";
+    node["file"] = m_filename;
+    if (m_maxSize) {
+        node["max_size"] = m_maxSize;
+    }
+    if (m_interval) {
+        node["interval"] = m_interval;
+    }
+    if (m_maxFiles) {
+        node["max_files"] = m_maxFiles;
+    }
+    if (m_compress != NONE) {
+        node["compress"] = CompressToString(m_compress);
+    }
+    if (m_level != LogLevel::UNKOWN) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasformatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+} // noobnet
@@ -0,0 +1,160 @@
+#ifndef __NOOBNET_LOG_ROLLING_
+#define __NOOBNET_LOG_ROLLING_
+
+#include "log.h"
+#include "thread.h"
+#include "mutex.h"
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+namespace noobnet {
+
+/**
+ * @brief 按大小/时间滚动的文件日志输出地
+ * @details 写线程只在读锁内取得当前文件的引用，随后用O_APPEND的write(2)整行写入；
+ *          滚动由后台线程完成：先rename当前文件，再打开新文件并替换引用，
+ *          仍在写旧文件的线程会写进已改名的文件，不会丢失也不会重复。
+ *          旧文件的最后一个引用释放后才会交给后台线程压缩和清理
+*/
+class RollingFileLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<RollingFileLogAppender> ptr;
+
+    /**
+     * @brief 滚动后文件的压缩方式
+    */
+    enum Compress {
+        NONE = 0,
+        GZIP = 1
+    };
+
+    static const char* CompressToString(Compress c);
+    static Compress CompressFromString(const std::string& str);
+
+    /**
+     * @brief 构造函数
+     * @param[in] filename 日志文件路径
+     * @param[in] max_size 单个文件的最大字节数，0表示不按大小滚动
+     * @param[in] interval 滚动间隔（秒），0表示不按时间滚动
+     * @param[in] max_files 保留的历史文件个数，0表示不清理
+     * @param[in] compress 历史文件的压缩方式
+    */
+    RollingFileLogAppender(const std::string& filename,
+                           uint64_t max_size = 0,
+                           uint32_t interval = 0,
+                           uint32_t max_files = 0,
+                           Compress compress = NONE);
+
+    /**
+     * @brief 析构函数，等待后台线程处理完剩余的压缩任务
+    */
+    ~RollingFileLogAppender();
+
+    void log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) override;
+    std::string toYamlString() override;
+
+    /**
+     * @brief 请求立即滚动，由后台线程异步完成
+    */
+    void rotate();
+
+    const std::string& getFilename() const { return m_filename; }
+    uint64_t getMaxSize() const { return m_maxSize; }
+    uint32_t getInterval() const { return m_interval; }
+    uint32_t getMaxFiles() const { return m_maxFiles; }
+    Compress getCompress() const { return m_compress; }
+
+    /**
+     * @brief 已完成的滚动次数
+    */
+    uint64_t getRotations() const { return m_rotations.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 写入或打开文件失败的次数
+    */
+    uint64_t getWriteErrors() const { return m_writeErrors.load(std::memory_order_relaxed); }
+private:
+    /**
+     * @brief 打开的日志文件，最后一个引用释放时关闭，已滚动的文件交给后台线程处理
+    */
+    struct File {
+        typedef std::shared_ptr<File> ptr;
+        File(RollingFileLogAppender* owner, int fd, uint64_t size, uint64_t opened);
+        ~File();
+
+        RollingFileLogAppender* owner;
+        int fd;
+        uint64_t opened;
+        std::atomic<uint64_t> size;
+        // 是否已经请求过滚动
+        std::atomic<bool> rolling;
+        // 滚动后的文件名，为空表示仍是当前文件
+        std::string rolled;
+    };
+
+    /**
+     * @brief 打开m_filename
+    */
+    File::ptr openFile();
+
+    /**
+     * @brief 执行一次滚动（后台线程调用）
+    */
+    void doRotate();
+
+    /**
+     * @brief 已滚动的文件被完全释放，加入待处理队列
+    */
+    void onReleased(const std::string& path);
+
+    /**
+     * @brief 压缩并按保留个数清理历史文件（后台线程调用）
+    */
+    void processRolled();
+
+    /**
+     * @brief 启动时加载已存在的历史文件
+    */
+    void loadHistory();
+
+    /**
+     * @brief 生成滚动后的文件名
+    */
+    std::string rolledName();
+
+    /**
+     * @brief 后台线程执行函数
+    */
+    void run();
+private:
+    std::string m_filename;
+    uint64_t m_maxSize;
+    uint32_t m_interval;
+    uint32_t m_maxFiles;
+    Compress m_compress;
+
+    // 保护m_file，只在取引用和替换时持有
+    RWMutex m_fileMutex;
+    File::ptr m_file;
+
+    // 待压缩/清理的文件
+    Mutex m_jobsMutex;
+    std::deque<std::string> m_jobs;
+    // 已完成处理的历史文件，按时间从旧到新
+    std::deque<std::string> m_history;
+
+    Thread::ptr m_thread;
+    Semophore m_semophore;
+    std::atomic<bool> m_rotateRequested;
+    std::atomic<bool> m_stopping;
+    std::atomic<uint64_t> m_rotations;
+    std::atomic<uint64_t> m_writeErrors;
+};
+
+} // noobnet
+
+#endif // !__NOOBNET_LOG_ROLLING_
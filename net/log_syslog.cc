@@ -0,0 +1,353 @@
+#include "log_syslog.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include <algorithm>
+#include <functional>
+
+namespace noobnet {
+
+// 单条报文的最大字节数，超出部分截断
+static const size_t s_syslog_max_message = 8192;
+// 每次sendmmsg最多发送的报文数
+static const size_t s_syslog_batch = 64;
+// 连接失败后的重试间隔
+static const uint64_t s_syslog_reconnect_us = 1000 * 1000;
+
+/**
+ * @brief 线程本地缓存的RFC3164时间戳 "Mmm dd hh:mm:ss"
+*/
+struct SyslogTimeCache {
+    uint64_t sec = 0;
+    char buf[32];
+    size_t len = 0;
+};
+
+static thread_local SyslogTimeCache t_syslog_time;
+
+// 缓存的进程id，避免每条日志一次getpid系统调用
+static std::atomic<pid_t> s_syslog_pid {0};
+
+static pid_t GetSyslogPid() {
+    pid_t pid = s_syslog_pid.load(std::memory_order_relaxed);
+    if (!pid) {
+        pid = ::getpid();
+        s_syslog_pid.store(pid, std::memory_order_relaxed);
+    }
+    return pid;
+}
+
+//fork后子进程的进程id变化，清除缓存
+struct SyslogPidIniter {
+    SyslogPidIniter() {
+        pthread_atfork(nullptr, nullptr, [] () {
+            s_syslog_pid.store(0, std::memory_order_relaxed);
+        });
+    }
+};
+
+static SyslogPidIniter __syslog_pid_init_;
+
+static const struct {
+    const char* name;
+    int code;
+} s_syslog_facilities[] = {
+    {"kern", 0}, {"user", 1}, {"mail", 2}, {"daemon", 3},
+    {"auth", 4}, {"syslog", 5}, {"lpr", 6}, {"news", 7},
+    {"uucp", 8}, {"cron", 9}, {"authpriv", 10}, {"ftp", 11},
+    {"local0", 16}, {"local1", 17}, {"local2", 18}, {"local3", 19},
+    {"local4", 20}, {"local5", 21}, {"local6", 22}, {"local7", 23}
+};
+
+int SyslogLogAppender::FacilityFromString(const std::string& str) {
+    std::string v = str;
+    std::transform(v.begin(), v.end(), v.begin(), ::tolower);
+    for (auto& i : s_syslog_facilities) {
+        if (v == i.name) {
+            return i.code;
+        }
+    }
+    return -1;
+}
+
+int SyslogLogAppender::LevelToSeverity(LogLevel::level level) {
+    switch (level) {
+    case LogLevel::FATAL:
+        return 2;   // crit
+    case LogLevel::ERROR:
+        return 3;   // err
+    case LogLevel::WARN:
+        return 4;   // warning
+    case LogLevel::INFO:
+        return 6;   // info
+    default:
+        return 7;   // debug
+    }
+}
+
+SyslogLogAppender::SyslogLogAppender(const std::string& address, const std::string& facility,
+                                     const std::string& tag, size_t queue_size,
+                                     uint32_t flush_interval)
+    :m_address(address)
+    ,m_facilityName(facility)
+    ,m_tag(tag)
+    ,m_flushInterval(std::max(flush_interval, 1u))
+    ,m_buffers(queue_size)
+    ,m_sent(0)
+    ,m_dropped(0)
+    ,m_sendDropped(0)
+    ,m_sendCalls(0)
+    ,m_sendErrors(0) {
+    m_facility = FacilityFromString(facility);
+    if (m_facility < 0) {
+        std::cout << "SyslogLogAppender unknown facility: " << facility << std::endl;
+        m_facility = 1;
+        m_facilityName = "user";
+    }
+    if (m_tag.empty()) {
+        m_tag = program_invocation_short_name;
+    }
+    memset(&m_addr, 0, sizeof(m_addr));
+    connect();
+    m_buffers.start(std::bind(&SyslogLogAppender::drain, this), m_flushInterval, "log_syslog");
+}
+
+SyslogLogAppender::~SyslogLogAppender() {
+    m_buffers.stop();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+bool SyslogLogAppender::connect() {
+    m_lastConnectUs = GetMonotonicUS();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    if (m_addrLen == 0) {
+        if (m_address.compare(0, 5, "unix:") == 0) {
+            struct sockaddr_un* addr = (struct sockaddr_un*)&m_addr;
+            std::string path = m_address.substr(5);
+            if (path.empty() || path.size() >= sizeof(addr->sun_path)) {
+                std::cout << "SyslogLogAppender invalid address: " << m_address << std::endl;
+                return false;
+            }
+            addr->sun_family = AF_UNIX;
+            memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+            m_addrLen = offsetof(struct sockaddr_un, sun_path) + path.size() + 1;
+        } else if (m_address.compare(0, 4, "udp:") == 0) {
+            std::string hostport = m_address.substr(4);
+            size_t pos = hostport.rfind(':');
+            if (pos == std::string::npos) {
+                std::cout << "SyslogLogAppender invalid address: " << m_address << std::endl;
+                return false;
+            }
+            std::string host = hostport.substr(0, pos);
+            std::string port = hostport.substr(pos + 1);
+            if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+                host = host.substr(1, host.size() - 2);
+            }
+            struct addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_DGRAM;
+            hints.ai_flags = AI_NUMERICSERV;
+            struct addrinfo* res = nullptr;
+            int rt = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+            if (rt || !res) {
+                std::cout << "SyslogLogAppender resolve error: " << m_address
+                          << " " << gai_strerror(rt) << std::endl;
+                return false;
+            }
+            memcpy(&m_addr, res->ai_addr, res->ai_addrlen);
+            m_addrLen = res->ai_addrlen;
+            freeaddrinfo(res);
+        } else {
+            std::cout << "SyslogLogAppender invalid address: " << m_address << std::endl;
+            return false;
+        }
+    }
+    m_fd = ::socket(m_addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) {
+        m_sendErrors.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.add(LogMetrics::ERRORS);
+        return false;
+    }
+    if (::connect(m_fd, (struct sockaddr*)&m_addr, m_addrLen)) {
+        m_sendErrors.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.add(LogMetrics::ERRORS);
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void SyslogLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) {
+    if (level < m_level) {
+        return;
+    }
+    LogFormatter::ptr fmt;
+    {
+        Mutex::Lock lock(m_mutex);
+        fmt = m_formatter;
+    }
+
+    // 4字节长度 + "<PRI>Mmm dd hh:mm:ss tag[pid]: " + 内容
+    LogStream msg(true);
+    uint32_t len = 0;
+    msg.append((const char*)&len, sizeof(len));
+    msg << '<' << m_facility * 8 + LevelToSeverity(level) << '>';
+    SyslogTimeCache& tc = t_syslog_time;
+    if (tc.sec != event.getTime() || tc.len == 0) {
+        struct tm tm;
+        time_t t = event.getTime();
+        localtime_r(&t, &tm);
+        tc.len = strftime(tc.buf, sizeof(tc.buf), "%b %e %H:%M:%S ", &tm);
+        tc.sec = event.getTime();
+    }
+    msg.append(tc.buf, tc.len);
+    msg << m_tag << '[' << GetSyslogPid() << "]: ";
+    if (fmt) {
+        formatEvent(fmt, msg, logger, level, event);
+    } else {
+        msg.append(event.getContentData(), event.getContentSize());
+    }
+    // 报文不需要结尾的换行
+    size_t size = msg.size();
+    while (size > sizeof(len) && msg.data()[size - 1] == '\n') {
+        --size;
+    }
+    size = std::min(size, sizeof(len) + s_syslog_max_message);
+    len = size - sizeof(len);
+    memcpy((char*)msg.data(), &len, sizeof(len));
+
+    LogRingBuffer::ptr buf = m_buffers.getLocalBuffer();
+    if (!buf->push(msg.data(), size)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_buffers.notify();
+}
+
+void SyslogLogAppender::flush() {
+    m_buffers.flush();
+}
+
+void SyslogLogAppender::send() {
+    // 按长度前缀切分报文
+    std::vector<struct iovec> iovs;
+    const char* p = m_batch.data();
+    const char* end = p + m_batch.size();
+    while (p + sizeof(uint32_t) <= end) {
+        uint32_t len;
+        memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        struct iovec iov;
+        iov.iov_base = (void*)p;
+        iov.iov_len = len;
+        iovs.push_back(iov);
+        p += len;
+    }
+    if (iovs.empty()) {
+        return;
+    }
+
+    if (m_fd < 0 && GetMonotonicUS() - m_lastConnectUs >= s_syslog_reconnect_us) {
+        connect();
+    }
+    if (m_fd < 0) {
+        m_sendDropped.fetch_add(iovs.size(), std::memory_order_relaxed);
+        return;
+    }
+
+    struct mmsghdr msgs[s_syslog_batch];
+    size_t done = 0;
+    uint64_t deadline = 0;
+    while (done < iovs.size()) {
+        size_t n = std::min(iovs.size() - done, s_syslog_batch);
+        memset(msgs, 0, sizeof(msgs[0]) * n);
+        for (size_t i = 0; i < n; ++i) {
+            msgs[i].msg_hdr.msg_iov = &iovs[done + i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int rt = ::sendmmsg(m_fd, msgs, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+        m_sendCalls.fetch_add(1, std::memory_order_relaxed);
+        if (rt > 0) {
+            m_sent.fetch_add(rt, std::memory_order_relaxed);
+            done += rt;
+            deadline = 0;
+            continue;
+        }
+        if (rt < 0 && errno == EINTR) {
+            continue;
+        }
+        // 发送队列满时等待可写，连续flush_interval没有进展才认为收集端卡住，期间写线程继续写入各自的缓冲区
+        if (rt < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            uint64_t now = GetMonotonicUS();
+            if (deadline == 0) {
+                deadline = now + m_flushInterval * 1000ul;
+            }
+            struct pollfd pfd;
+            pfd.fd = m_fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            if (now < deadline && ::poll(&pfd, 1, (deadline - now + 999) / 1000) > 0) {
+                continue;
+            }
+        }
+        // 收集端卡住或不可达，丢弃本轮剩余的报文
+        if (rt < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            m_sendErrors.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.add(LogMetrics::ERRORS);
+            if (errno != EMSGSIZE && errno != ENOBUFS) {
+                // 收集端重启后需要重新连接
+                ::close(m_fd);
+                m_fd = -1;
+            }
+        }
+        break;
+    }
+    if (done < iovs.size()) {
+        m_sendDropped.fetch_add(iovs.size() - done, std::memory_order_relaxed);
+    }
+}
+
+size_t SyslogLogAppender::drain() {
+    size_t total = m_buffers.pop(m_batch);
+    if (!m_batch.empty()) {
+        send();
+        m_batch.clear();
+    }
+    return total;
+}
+
+std::string SyslogLogAppender::toYamlString() {
+    Mutex::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "SyslogLogAppender";
+    node["address"] = m_address;
+    node["facility"] = m_facilityName;
+    node["tag"] = m_tag;
+    node["queue_size"] = m_buffers.getQueueSize();
+    node["flush_interval"] = m_flushInterval;
+    if (m_level != LogLevel::UNKOWN) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasformatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+} // noobnet
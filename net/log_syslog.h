@@ -0,0 +1,140 @@
+#ifndef __NOOBNET_LOG_SYSLOG_
+#define __NOOBNET_LOG_SYSLOG_
+
+#include "log.h"
+#include "log_async.h"
+#include "thread.h"
+#include "mutex.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include <sys/socket.h>
+
+namespace noobnet {
+
+/**
+ * @brief 把日志以syslog报文发送到本机收集端的输出地
+ * @details 地址为 "unix:/dev/log" 形式的UNIX数据报套接字，或 "udp:127.0.0.1:514" 形式的UDP地址。
+ *          写线程只把生成好的报文写入自己的环形缓冲区，缓冲区满时直接丢弃并计数；
+ *          后台线程汇总所有缓冲区，每次用一个sendmmsg发出一批报文。
+ *          套接字是非阻塞的，发送队列满时后台线程等待可写，
+ *          连续flush_interval毫秒没有进展则丢弃本轮剩余的报文，Logger::log永远不会被阻塞
+*/
+class SyslogLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<SyslogLogAppender> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] address 收集端地址，"unix:路径" 或 "udp:主机:端口"
+     * @param[in] facility syslog facility名称，如user、daemon、local0
+     * @param[in] tag 报文中的程序名，为空时使用进程名
+     * @param[in] queue_size 每个线程环形缓冲区的字节数
+     * @param[in] flush_interval 后台线程空闲时的最长休眠时间（毫秒）
+    */
+    SyslogLogAppender(const std::string& address = "unix:/dev/log",
+                      const std::string& facility = "user",
+                      const std::string& tag = "",
+                      size_t queue_size = 256 * 1024,
+                      uint32_t flush_interval = 100);
+
+    /**
+     * @brief 析构函数，发送剩余的报文
+    */
+    ~SyslogLogAppender();
+
+    void log(std::shared_ptr<Logger> logger, LogLevel::level level, const LogEvent& event) override;
+    std::string toYamlString() override;
+
+    /**
+     * @brief 阻塞直到调用时已入队的报文全部处理完
+    */
+    void flush();
+
+    /**
+     * @brief facility名称与编号的转换，未知名称返回-1
+    */
+    static int FacilityFromString(const std::string& str);
+
+    /**
+     * @brief 日志级别对应的syslog严重程度
+    */
+    static int LevelToSeverity(LogLevel::level level);
+
+    const std::string& getAddress() const { return m_address; }
+    const std::string& getFacility() const { return m_facilityName; }
+    const std::string& getTag() const { return m_tag; }
+    size_t getQueueSize() const { return m_buffers.getQueueSize(); }
+    uint32_t getFlushInterval() const { return m_flushInterval; }
+
+    /**
+     * @brief 已发送的报文数
+    */
+    uint64_t getSent() const { return m_sent.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 因缓冲区满被丢弃的报文数
+    */
+    uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 因收集端不可写或不可达被丢弃的报文数
+    */
+    uint64_t getSendDropped() const { return m_sendDropped.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief sendmmsg调用次数
+    */
+    uint64_t getSendCalls() const { return m_sendCalls.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 发送失败（不含EAGAIN）的次数
+    */
+    uint64_t getSendErrors() const { return m_sendErrors.load(std::memory_order_relaxed); }
+private:
+    /**
+     * @brief 解析地址并连接，失败时关闭套接字，之后由后台线程定期重试
+    */
+    bool connect();
+
+    /**
+     * @brief 取出所有缓冲区的报文并发送
+     * @return 本轮取出的字节数
+    */
+    size_t drain();
+
+    /**
+     * @brief 分批发送m_batch中的报文
+    */
+    void send();
+private:
+    std::string m_address;
+    std::string m_facilityName;
+    int m_facility;
+    std::string m_tag;
+    uint32_t m_flushInterval;
+
+    // 只由后台线程访问
+    int m_fd = -1;
+    struct sockaddr_storage m_addr;
+    socklen_t m_addrLen = 0;
+    uint64_t m_lastConnectUs = 0;
+    // 本轮取出的报文，每条前面是4字节的长度
+    std::string m_batch;
+
+    // 所有线程注册的缓冲区及后台发送线程
+    LogRingBufferGroup m_buffers;
+
+    std::atomic<uint64_t> m_sent;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_sendDropped;
+    std::atomic<uint64_t> m_sendCalls;
+    std::atomic<uint64_t> m_sendErrors;
+};
+
+} // noobnet
+
+#endif // !__NOOBNET_LOG_SYSLOG_
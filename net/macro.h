@@ -2,6 +2,7 @@
 #define __NOOBNET_MACRO_
 
 #include "log.h"
+#include "log_flight.h"
 #include "utils.h"
 #include <assert.h>
 
@@ -10,6 +11,7 @@
         SYS_LOG_ERROR(SYS_LOG_ROOT()) << "ASSERTION: " #x \
             << "\nbacktrace:\n" \
             << noobnet::BacktraceToString(100, 2, "   "); \
+        noobnet::FlightRecorder::DumpOnAssert(#x); \
         assert(x); \
     }
 
@@ -19,7 +21,8 @@
             << "\n" << w \
             << "\nbacktrace:\n" \
             << noobnet::BacktraceToString(100, 2, "   "); \
-        assert(x);
+        noobnet::FlightRecorder::DumpOnAssert(#x); \
+        assert(x); \
     }
 
 #endif // !__NOOBNET_MACRO_
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "mutex.h"
 
+#include <stdexcept>
+#include <errno.h>
+#include <time.h>
+
 namespace noobnet {
 
 Semophore::Semophore(uint32_t count) {
@@ -18,6 +22,27 @@ void Semophore::wait() {
     }
 }
 
+bool Semophore::timedwait(uint64_t ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000;
+    }
+    while (sem_timedwait(&m_semophore, &ts)) {
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == ETIMEDOUT) {
+            return false;
+        }
+        throw std::logic_error("sem_timedwait error");
+    }
+    return true;
+}
+
 void Semophore::notify() {
     if (sem_post(&m_semophore)) {
         throw std::logic_error("sem_post error");
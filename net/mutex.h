@@ -33,6 +33,13 @@ public:
     */
     void wait();
 
+    /**
+     * @brief 限时获取信号量
+     * @param[in] ms 最长等待的毫秒数
+     * @return 获取成功返回true，超时返回false
+    */
+    bool timedwait(uint64_t ms);
+
     /**
      * @brief 释放信号量
     */
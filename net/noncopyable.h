@@ -1,5 +1,5 @@
 #ifndef __NOOBNET_NONCOPYABLE_
-#define __NOOBNET_NOCOPYABLE_
+#define __NOOBNET_NONCOPYABLE_
 
 namespace noobnet {
 /**
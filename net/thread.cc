@@ -1,12 +1,32 @@
 #include "thread.h"
 #include "utils.h"
 #include "log.h"
+#include <set>
 
 
 namespace noobnet {
 
 static thread_local Thread* t_thread = nullptr;
 static thread_local std::string t_thread_name = "UNKNOWN";
+static thread_local pid_t t_thread_id = 0;
+static thread_local const char* t_thread_name_cstr = nullptr;
+
+//线程名只增不删，保存在这里的字符串在进程退出前不会释放
+static const char* InternThreadName(const std::string& name) {
+    static Mutex s_mutex;
+    static std::set<std::string>* s_names = new std::set<std::string>;
+    Mutex::Lock lock(s_mutex);
+    return s_names->insert(name).first->c_str();
+}
+
+//fork后子进程的线程id变化，清除缓存
+struct ThreadIdIniter {
+    ThreadIdIniter() {
+        pthread_atfork(nullptr, nullptr, [] () { t_thread_id = 0; });
+    }
+};
+
+static ThreadIdIniter __thread_id_init_;
 
 static noobnet::Logger::ptr g_logger = SYS_LOG_NAME("system");
 
@@ -18,6 +38,20 @@ const std::string& Thread::GetName() {
     return t_thread_name;
 }
 
+pid_t Thread::GetId() {
+    if (!t_thread_id) {
+        t_thread_id = noobnet::GetThreadId();
+    }
+    return t_thread_id;
+}
+
+const char* Thread::GetNameCStr() {
+    if (!t_thread_name_cstr) {
+        t_thread_name_cstr = InternThreadName(t_thread_name);
+    }
+    return t_thread_name_cstr;
+}
+
 void Thread::SetName(const std::string& name) {
     if (name.empty()) {
         return;
@@ -26,6 +60,7 @@ void Thread::SetName(const std::string& name) {
         t_thread->m_name = name;
     }
     t_thread_name = name;
+    t_thread_name_cstr = InternThreadName(name);
 }
 
 Thread::Thread(std::function<void()> cb, const std::string& name) 
@@ -65,7 +100,9 @@ void* Thread::run(void* arg) {
     Thread* thread = (Thread*)arg;
     t_thread = thread;
     t_thread_name = thread->m_name;
-    thread->m_pid = noobnet::GetThreadId();
+    t_thread_name_cstr = InternThreadName(thread->m_name);
+    t_thread_id = noobnet::GetThreadId();
+    thread->m_pid = t_thread_id;
     pthread_setname_np(pthread_self(), thread->m_name.substr(0, 15).c_str());
 
     std::function<void()> cb;
@@ -5,6 +5,7 @@
 #include <pthread.h>
 #include <functional>
 #include <memory>
+#include <string>
 #include "mutex.h"
 
 namespace noobnet {
@@ -23,6 +24,16 @@ public:
     static Thread* GetThis();
     static const std::string& GetName();
     static void SetName(const std::string& name);
+
+    /**
+     * @brief 当前线程的内核线程id，首次调用后缓存在线程本地变量中
+    */
+    static pid_t GetId();
+
+    /**
+     * @brief 当前线程名的常驻副本，线程退出后指针仍然有效，可以直接保存在日志事件中
+    */
+    static const char* GetNameCStr();
 private:
     Thread(const Thread&) = delete;
     Thread(const Thread&&) = delete;
@@ -2,6 +2,8 @@
 #include "log.h"
 #include <unistd.h>
 #include <sys/syscall.h>
+#include <time.h>
+#include <atomic>
 
 #ifndef _GNU_SOURCE
     #define _GNU_SOURCE
@@ -17,6 +19,59 @@ pid_t GetThreadId() {
     return syscall(SYS_gettid);
 }
 
+static thread_local uint64_t t_fiber_id = 0;
+
+uint64_t GetFiberId() {
+    return t_fiber_id;
+}
+
+void SetFiberId(uint64_t id) {
+    t_fiber_id = id;
+}
+
+// 墙上时间相对单调时钟的偏移，及上次校准时的单调时间
+static std::atomic<int64_t> s_clock_offset_us {0};
+static std::atomic<uint64_t> s_clock_synced_us {0};
+static const uint64_t s_clock_sync_interval_us = 60 * 1000 * 1000ul;
+
+uint64_t GetMonotonicUS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
+
+// 进程启动时的单调时间，作为elapse的起点
+static const uint64_t s_process_start_us = GetMonotonicUS();
+
+uint64_t MonotonicToRealUS(uint64_t mono) {
+    uint64_t synced = s_clock_synced_us.load(std::memory_order_relaxed);
+    if (synced == 0 || mono - synced > s_clock_sync_interval_us) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        int64_t offset = (int64_t)(ts.tv_sec * 1000000ul + ts.tv_nsec / 1000) - (int64_t)mono;
+        s_clock_offset_us.store(offset, std::memory_order_relaxed);
+        s_clock_synced_us.store(mono, std::memory_order_relaxed);
+        return mono + offset;
+    }
+    return mono + s_clock_offset_us.load(std::memory_order_relaxed);
+}
+
+uint32_t MonotonicToElapsedMS(uint64_t mono) {
+    return mono > s_process_start_us ? (mono - s_process_start_us) / 1000 : 0;
+}
+
+uint32_t GetElapsedMS() {
+    return MonotonicToElapsedMS(GetMonotonicUS());
+}
+
+uint64_t GetCurrentUS() {
+    return MonotonicToRealUS(GetMonotonicUS());
+}
+
+uint64_t GetCurrentMS() {
+    return GetCurrentUS() / 1000;
+}
+
 static std::string demangle(const char* str) {
     size_t size = 0;
     int status = 0;
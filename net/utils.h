@@ -6,6 +6,7 @@
 #include <execinfo.h>
 #include <vector>
 #include <string>
+#include <stdint.h>
 
 namespace noobnet {
 
@@ -17,6 +18,48 @@ const char* TypeToName() {
 
 pid_t GetThreadId();
 
+/**
+ * @brief 当前线程上运行的协程id，不在协程中时为0
+*/
+uint64_t GetFiberId();
+
+/**
+ * @brief 协程切换时设置当前线程上运行的协程id
+*/
+void SetFiberId(uint64_t id);
+
+/**
+ * @brief 当前墙上时间（微秒）
+ * @details 由单调时钟加上与系统时钟的偏移得到，偏移每分钟校准一次，
+ *          同一进程内不会因为系统时间被调整而大幅跳变
+*/
+uint64_t GetCurrentUS();
+
+/**
+ * @brief 单调时钟（微秒），经vDSO读取，不产生系统调用
+*/
+uint64_t GetMonotonicUS();
+
+/**
+ * @brief 将GetMonotonicUS()得到的时间换算为墙上时间（微秒）
+*/
+uint64_t MonotonicToRealUS(uint64_t mono_us);
+
+/**
+ * @brief 将GetMonotonicUS()得到的时间换算为进程启动至今的毫秒数
+*/
+uint32_t MonotonicToElapsedMS(uint64_t mono_us);
+
+/**
+ * @brief 进程启动至今的毫秒数
+*/
+uint32_t GetElapsedMS();
+
+/**
+ * @brief 当前墙上时间（毫秒）
+*/
+uint64_t GetCurrentMS();
+
 void Backtrace(std::vector<std::string>& vec, int size = 64, int skip = 1);
 
 std::string BacktraceToString(int size = 64, int skip = 2, const std::string& prefix = "");
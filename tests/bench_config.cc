@@ -0,0 +1,110 @@
+#include "../net/config.h"
+#include "../net/thread.h"
+#include <atomic>
+#include <time.h>
+#include <sched.h>
+
+//每种组合运行的时间
+static const uint64_t s_run_ms = 200;
+static const int s_max_threads = 64;
+
+static uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+//原来的读取方式：读锁保护下拷贝整个值
+template<class T>
+class LegacyVar {
+public:
+    LegacyVar(const T& v) :m_val(v) {}
+    const T getValue() {
+        noobnet::RWMutex::ReadLock lock(m_mutex);
+        return m_val;
+    }
+private:
+    T m_val;
+    noobnet::RWMutex m_mutex;
+};
+
+static volatile uint64_t s_sink = 0;
+
+//threads个线程循环调用cb，返回每秒的总读取次数
+static uint64_t run(int threads, std::function<uint64_t()> cb) {
+    std::atomic<bool> go {false};
+    std::atomic<bool> stop {false};
+    std::atomic<uint64_t> total {0};
+    std::vector<noobnet::Thread::ptr> thrs;
+    for (int i = 0; i < threads; ++i) {
+        thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread([&]() {
+            uint64_t n = 0;
+            uint64_t sum = 0;
+            //所有线程创建完成后才开始计数
+            while (!go) {
+                sched_yield();
+            }
+            while (!stop.load(std::memory_order_relaxed)) {
+                sum += cb();
+                ++n;
+            }
+            s_sink = sum;
+            total += n;
+        }, "bench_" + std::to_string(i))));
+    }
+    uint64_t begin = NowNs();
+    go = true;
+    while (NowNs() - begin < s_run_ms * 1000000) {
+        usleep(1000);
+    }
+    stop = true;
+    for (auto& i : thrs) {
+        i->join();
+    }
+    return total * 1000000000.0 / (NowNs() - begin);
+}
+
+static void report(const char* name, std::function<uint64_t()> cb) {
+    for (int t = 1; t <= s_max_threads; t *= 2) {
+        std::cout << name << ", threads=" << t << ": " << run(t, cb) << " reads/s" << std::endl;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    std::map<std::string, int> routes;
+    for (int i = 0; i < 100; ++i) {
+        routes["/api/v1/route_" + std::to_string(i)] = i;
+    }
+
+    LegacyVar<int> legacy_int(8080);
+    LegacyVar<std::map<std::string, int>> legacy_map(routes);
+    noobnet::ConfigVar<int>::ptr var_int =
+        noobnet::Config::LookUp(8080, "bench.port", "bench port");
+    noobnet::ConfigVar<std::map<std::string, int>>::ptr var_map =
+        noobnet::Config::LookUp(routes, "bench.routes", "bench routes");
+
+    report("int, rwlock copy (before)", [&]() -> uint64_t {
+        return legacy_int.getValue();
+    });
+    report("int, getValue", [&]() -> uint64_t {
+        return var_int->getValue();
+    });
+    report("map, rwlock copy (before)", [&]() -> uint64_t {
+        return legacy_map.getValue().size();
+    });
+    report("map, getSnapshot", [&]() -> uint64_t {
+        return var_map->getSnapshot()->size();
+    });
+
+    //线程本地缓存的句柄
+    noobnet::ConfigHandle<int> handle_int(var_int);
+    noobnet::ConfigHandle<std::map<std::string, int>> handle_map(var_map);
+    report("int, ConfigHandle", [&]() -> uint64_t {
+        return handle_int.get();
+    });
+    report("map, ConfigHandle", [&]() -> uint64_t {
+        return handle_map->size();
+    });
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "../net/config.h"
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * 大配置文件的加载耗时
+ * 用法: bench_config_load [-s 服务数] [-r 每个服务的路由数] [-n 轮数]
+ * 生成一个包含大路由表的配置，比较原来的加载方式（ListAllMember拷贝节点、
+ * 非标量节点序列化后再逐层YAML::Load）与LoadFromYaml按节点直接转换的耗时
+*/
+
+static uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+typedef std::map<std::string, std::vector<std::string>> Upstreams;
+typedef std::map<std::string, std::map<std::string, int>> Routes;
+
+//原来的字符串转换：容器的每个元素序列化后再解析一遍
+template<class T>
+class LegacyCast {
+public:
+    T operator() (const std::string& str) {
+        return boost::lexical_cast<T>(str);
+    }
+};
+
+template<class T>
+class LegacyCast<std::vector<T>> {
+public:
+    std::vector<T> operator() (const std::string& str) {
+        YAML::Node node = YAML::Load(str);
+        std::vector<T> vec;
+        std::stringstream ss;
+        for (size_t i = 0; i < node.size(); ++i) {
+            ss.str("");
+            ss << node[i];
+            vec.push_back(LegacyCast<T>()(ss.str()));
+        }
+        return vec;
+    }
+};
+
+template<class T>
+class LegacyCast<std::map<std::string, T>> {
+public:
+    std::map<std::string, T> operator() (const std::string& str) {
+        YAML::Node node = YAML::Load(str);
+        std::map<std::string, T> vec;
+        std::stringstream ss;
+        for (auto i = node.begin(); i != node.end(); ++i) {
+            ss.str("");
+            ss << i->second;
+            vec.insert(std::make_pair(i->first.Scalar(), LegacyCast<T>()(ss.str())));
+        }
+        return vec;
+    }
+};
+
+static void ListAllMember(const std::string& prefix, const YAML::Node& node,
+                          std::list<std::pair<std::string, const YAML::Node>>& output) {
+    if (prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789") != std::string::npos) {
+        return;
+    }
+    output.push_back(std::make_pair(prefix, node));
+    if (node.IsMap()) {
+        for (auto i = node.begin(); i != node.end(); ++i) {
+            ListAllMember(prefix.empty() ? i->first.Scalar() :
+                prefix + "." + i->first.Scalar(), i->second, output);
+        }
+    }
+}
+
+//原来的LoadFromYaml，配置项不注册到Config中
+static void LegacyLoad(const YAML::Node& root,
+                       std::map<std::string, noobnet::ConfigVarBase::ptr>& vars) {
+    std::list<std::pair<std::string, const YAML::Node>> all_nodes;
+    ListAllMember("", root, all_nodes);
+    for (auto& it : all_nodes) {
+        auto var = vars.find(it.first);
+        if (var == vars.end()) {
+            continue;
+        }
+        if (it.second.IsScalar()) {
+            var->second->fromString(it.second.Scalar());
+        } else {
+            std::stringstream ss;
+            ss << it.second;
+            var->second->fromString(ss.str());
+        }
+    }
+}
+
+static std::string generate(int services, int routes) {
+    std::stringstream ss;
+    ss << "bench:\n  port: 8080\n  name: bench_load\n  upstreams:\n";
+    for (int i = 0; i < services; ++i) {
+        ss << "    service_" << i << ":\n";
+        for (int j = 0; j < routes; ++j) {
+            ss << "      - 10." << i / 256 % 256 << "." << i % 256 << "." << j << ":" << 8000 + j << "\n";
+        }
+    }
+    ss << "  routes:\n";
+    for (int i = 0; i < services; ++i) {
+        ss << "    route_" << i << ":\n";
+        for (int j = 0; j < routes; ++j) {
+            ss << "      method_" << j << ": " << i * routes + j << "\n";
+        }
+    }
+    return ss.str();
+}
+
+int main(int argc, char* argv[])
+{
+    int services = 2000;
+    int routes = 16;
+    int rounds = 3;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:r:n:")) != -1) {
+        switch (opt) {
+            case 's': services = std::max(1, atoi(optarg)); break;
+            case 'r': routes = std::max(1, atoi(optarg)); break;
+            case 'n': rounds = std::max(1, atoi(optarg)); break;
+            default:
+                std::cerr << "usage: " << argv[0] << " [-s services] [-r routes] [-n rounds]" << std::endl;
+                return 1;
+        }
+    }
+
+    std::string text = generate(services, routes);
+    std::cout << "services=" << services << " routes=" << routes
+              << " bytes=" << text.size() << std::endl;
+
+    auto port = noobnet::Config::LookUp(0, "bench.port", "bench port");
+    auto upstreams = noobnet::Config::LookUp(Upstreams(), "bench.upstreams", "bench upstreams");
+    auto routes_var = noobnet::Config::LookUp(Routes(), "bench.routes", "bench routes");
+
+    typedef noobnet::ConfigVar<Upstreams, LegacyCast<Upstreams>> LegacyUpstreams;
+    typedef noobnet::ConfigVar<Routes, LegacyCast<Routes>> LegacyRoutes;
+    std::map<std::string, noobnet::ConfigVarBase::ptr> legacy_vars;
+    legacy_vars["bench.port"].reset(new noobnet::ConfigVar<int, LegacyCast<int>>(0, "bench.port"));
+    LegacyUpstreams::ptr legacy_upstreams(new LegacyUpstreams(Upstreams(), "bench.upstreams"));
+    LegacyRoutes::ptr legacy_routes(new LegacyRoutes(Routes(), "bench.routes"));
+    legacy_vars["bench.upstreams"] = legacy_upstreams;
+    legacy_vars["bench.routes"] = legacy_routes;
+
+    uint64_t parse = 0;
+    uint64_t legacy = 0;
+    uint64_t node = 0;
+    for (int i = 0; i < rounds; ++i) {
+        uint64_t begin = NowNs();
+        YAML::Node root = YAML::Load(text);
+        parse += NowNs() - begin;
+
+        //值相同时setValue不做修改，每轮开始前恢复为空
+        legacy_upstreams->setValue(Upstreams());
+        legacy_routes->setValue(Routes());
+        begin = NowNs();
+        LegacyLoad(root, legacy_vars);
+        legacy += NowNs() - begin;
+
+        upstreams->setValue(Upstreams());
+        routes_var->setValue(Routes());
+        begin = NowNs();
+        noobnet::Config::LoadFromYaml(root);
+        node += NowNs() - begin;
+    }
+
+    bool ok = port->getValue() == 8080
+        && *upstreams->getSnapshot() == *legacy_upstreams->getSnapshot()
+        && *routes_var->getSnapshot() == *legacy_routes->getSnapshot()
+        && (int)routes_var->getSnapshot()->size() == services;
+    std::cout << "YAML::Load: " << parse / rounds / 1000 << " us" << std::endl;
+    std::cout << "apply, string round trip (before): " << legacy / rounds / 1000 << " us" << std::endl;
+    std::cout << "apply, LoadFromYaml: " << node / rounds / 1000 << " us" << std::endl;
+    std::cout << "startup (parse + apply): " << (parse + legacy) / rounds / 1000 << " us -> "
+              << (parse + node) / rounds / 1000 << " us" << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+#include "../net/log.h"
+#include <sys/time.h>
+#include <time.h>
+
+static const char* s_pattern = "%d%T[%p]%T%c%T%m%T%n";
+static const int s_loops = 1000000;
+
+static uint64_t NowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+//改造前的实现：虚函数格式项 + std::stringstream + 返回std::string，只保留默认格式用到的项
+class LegacyItem {
+public:
+    typedef std::shared_ptr<LegacyItem> ptr;
+    virtual ~LegacyItem() {}
+    virtual void format(std::ostream& os, const noobnet::Logger::ptr& logger,
+                        noobnet::LogLevel::level level, const noobnet::LogEvent::ptr& event) = 0;
+};
+
+#define XX(name, expr) \
+    class name : public LegacyItem { \
+    public: \
+        void format(std::ostream& os, const noobnet::Logger::ptr& logger, \
+                    noobnet::LogLevel::level level, const noobnet::LogEvent::ptr& event) override { \
+            expr; \
+        } \
+    };
+
+XX(LegacyDate, struct tm tm; time_t t = event->getTime(); localtime_r(&t, &tm); char buf[64]; \
+   strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm); os << buf)
+XX(LegacyTab, os << "\t")
+XX(LegacyOpen, os << "[")
+XX(LegacyClose, os << "]")
+XX(LegacyLevel, os << noobnet::LogLevel::ToString(level))
+XX(LegacyName, os << logger->getName())
+XX(LegacyMessage, os << event->getContent())
+XX(LegacyNewLine, os << std::endl)
+#undef XX
+
+class LegacyFormatter {
+public:
+    //对应 %d%T[%p]%T%c%T%m%T%n
+    LegacyFormatter() {
+        m_items = {LegacyItem::ptr(new LegacyDate), LegacyItem::ptr(new LegacyTab),
+                   LegacyItem::ptr(new LegacyOpen), LegacyItem::ptr(new LegacyLevel),
+                   LegacyItem::ptr(new LegacyClose), LegacyItem::ptr(new LegacyTab),
+                   LegacyItem::ptr(new LegacyName), LegacyItem::ptr(new LegacyTab),
+                   LegacyItem::ptr(new LegacyMessage), LegacyItem::ptr(new LegacyTab),
+                   LegacyItem::ptr(new LegacyNewLine)};
+    }
+
+    std::string format(const noobnet::Logger::ptr& logger, noobnet::LogLevel::level level,
+                       const noobnet::LogEvent::ptr& event) {
+        std::stringstream ss;
+        for (auto& i : m_items) {
+            i->format(ss, logger, level, event);
+        }
+        return ss.str();
+    }
+private:
+    std::vector<LegacyItem::ptr> m_items;
+};
+
+static void report(const char* name, uint64_t us, size_t bytes) {
+    std::cout << name << ": " << s_loops << " events in " << us / 1000.0 << " ms, "
+              << (us * 1000.0 / s_loops) << " ns/event, "
+              << (uint64_t)(s_loops * 1000000.0 / us) << " events/s, "
+              << bytes / s_loops << " bytes/event" << std::endl;
+}
+
+int main(int argc, char const *argv[])
+{
+    noobnet::Logger::ptr logger(new noobnet::Logger("bench"));
+    noobnet::LogFormatter::ptr fmt(new noobnet::LogFormatter(s_pattern));
+
+    noobnet::LogEvent::ptr event(new noobnet::LogEvent(__FILE__, __LINE__,
+                0, 1, 2, time(0), logger, noobnet::LogLevel::INFO));
+    event->getSS() << "request done uri=/index.html status=" << 200 << " cost=" << 1.25;
+
+    //旧路径：FormatterItem + std::stringstream + 返回std::string
+    LegacyFormatter legacy;
+    size_t bytes = 0;
+    uint64_t begin = NowUs();
+    for (int i = 0; i < s_loops; ++i) {
+        bytes += legacy.format(logger, noobnet::LogLevel::INFO, event).size();
+    }
+    report("stringstream", NowUs() - begin, bytes);
+
+    //新路径：编译后的指令直接写入复用的缓冲
+    bytes = 0;
+    noobnet::LogStream buf(true);
+    begin = NowUs();
+    for (int i = 0; i < s_loops; ++i) {
+        buf.clear();
+        fmt->format(buf, logger, noobnet::LogLevel::INFO, *event);
+        bytes += buf.size();
+    }
+    report("compiled", NowUs() - begin, bytes);
+
+    //带5个结构化字段的事件：文本 key=value 与 JSON
+    noobnet::LogEvent::ptr kv(new noobnet::LogEvent(__FILE__, __LINE__,
+                0, 1, 2, time(0), logger, noobnet::LogLevel::INFO));
+    kv->getSS() << "request done";
+    kv->with("uri", "/index.html").with("status", 200).with("cost", 1.25)
+        .with("bytes", 5120u).with("keepalive", true);
+
+    noobnet::LogFormatter::ptr text(new noobnet::LogFormatter("%d%T[%p]%T%c%T%m%T%K%n"));
+    bytes = 0;
+    begin = NowUs();
+    for (int i = 0; i < s_loops; ++i) {
+        buf.clear();
+        text->format(buf, logger, noobnet::LogLevel::INFO, *kv);
+        bytes += buf.size();
+    }
+    report("fields text", NowUs() - begin, bytes);
+
+    noobnet::LogFormatter::ptr json(new noobnet::LogFormatter("%J%n"));
+    bytes = 0;
+    begin = NowUs();
+    for (int i = 0; i < s_loops; ++i) {
+        buf.clear();
+        json->format(buf, logger, noobnet::LogLevel::INFO, *kv);
+        bytes += buf.size();
+    }
+    report("fields json", NowUs() - begin, bytes);
+    return 0;
+}
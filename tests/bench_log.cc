@@ -0,0 +1,276 @@
+#include "../net/log.h"
+#include "../net/thread.h"
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <fstream>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/**
+ * 日志吞吐与单次调用延迟
+ * 用法: bench_log [-t 最大线程数] [-n 每线程条数] [-f csv|json] [-o 输出文件] [-a null,stdout,file]
+ * 线程数从1开始翻倍直到最大线程数；每种组合先跑一轮不计时的吞吐，再跑一轮逐条计时的延迟。
+ * 结果每行一条记录，便于不同版本之间对比
+*/
+
+static const char* s_file = "/tmp/noobnet_bench_log.txt";
+static const char* s_pattern = "%d%T%t%T%N%T[%p]%T[%c]%T%f:%l%T%m%n";
+
+//只格式化不写出，衡量I/O之前的全部开销
+class NullLogAppender : public noobnet::LogAppender {
+public:
+    typedef std::shared_ptr<NullLogAppender> ptr;
+    void log(std::shared_ptr<noobnet::Logger> logger, noobnet::LogLevel::level level,
+             const noobnet::LogEvent& event) override {
+        if (level >= m_level) {
+            noobnet::LogStream buf(true);
+            m_formatter->format(buf, logger, level, event);
+            m_bytes.fetch_add(buf.size(), std::memory_order_relaxed);
+        }
+    }
+    std::string toYamlString() override { return ""; }
+private:
+    std::atomic<uint64_t> m_bytes {0};
+};
+
+static inline uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+struct Case {
+    std::string appender;
+    //stream、fmt 或 print
+    std::string macro;
+    //enabled 或 disabled
+    std::string level;
+    int threads = 0;
+    uint64_t events = 0;
+    double seconds = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+static noobnet::Logger::ptr s_logger;
+static int s_events = 200000;
+static uint64_t s_timer_ns = 0;
+
+static void log_stream(noobnet::LogLevel::level level, int i) {
+    SYS_LOG_LEVEL(s_logger, level) << "request done uri=/index.html status=" << 200
+        << " cost=" << 1.25 << " seq=" << i;
+}
+
+static void log_fmt(noobnet::LogLevel::level level, int i) {
+    SYS_LOG_FMT_LEVEL(s_logger, level, "request done uri=%s status=%d cost=%.2f seq=%d",
+            "/index.html", 200, 1.25, i);
+}
+
+static void log_print(noobnet::LogLevel::level level, int i) {
+    SYS_LOG_PRINT_LEVEL(s_logger, level, "request done uri={} status={} cost={} seq={}",
+            "/index.html", 200, 1.25, i);
+}
+
+/**
+ * @brief 用threads个线程各执行cb s_events次
+ * @param[in] latency 非空时逐条计时，每个线程写入各自的区间
+ * @return 所有线程开始到全部结束的秒数
+*/
+static double run_threads(int threads, std::function<void(int)> cb, std::vector<uint64_t>* latency) {
+    std::atomic<int> ready {0};
+    std::atomic<bool> go {false};
+    std::vector<noobnet::Thread::ptr> thrs;
+    for (int t = 0; t < threads; ++t) {
+        uint64_t* out = latency ? latency->data() + (size_t)t * s_events : nullptr;
+        thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread([&, out]() {
+            ++ready;
+            while (!go) {
+            }
+            if (out) {
+                for (int i = 0; i < s_events; ++i) {
+                    uint64_t begin = NowNs();
+                    cb(i);
+                    out[i] = NowNs() - begin;
+                }
+            } else {
+                for (int i = 0; i < s_events; ++i) {
+                    cb(i);
+                }
+            }
+        }, "bench_" + std::to_string(t))));
+    }
+    while (ready != threads) {
+    }
+    uint64_t begin = NowNs();
+    go = true;
+    for (auto& i : thrs) {
+        i->join();
+    }
+    return (NowNs() - begin) / 1e9;
+}
+
+static uint64_t percentile(std::vector<uint64_t>& v, double p) {
+    size_t idx = std::min(v.size() - 1, (size_t)(v.size() * p));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+static Case run_case(const std::string& appender, const std::string& macro, bool enabled, int threads) {
+    Case c;
+    c.appender = appender;
+    c.macro = macro;
+    c.level = enabled ? "enabled" : "disabled";
+    c.threads = threads;
+    c.events = (uint64_t)threads * s_events;
+
+    //logger为INFO级别，disabled用DEBUG
+    noobnet::LogLevel::level level = enabled ? noobnet::LogLevel::INFO : noobnet::LogLevel::DEBUG;
+    std::function<void(int)> cb;
+    if (macro == "stream") {
+        cb = std::bind(&log_stream, level, std::placeholders::_1);
+    } else if (macro == "fmt") {
+        cb = std::bind(&log_fmt, level, std::placeholders::_1);
+    } else {
+        cb = std::bind(&log_print, level, std::placeholders::_1);
+    }
+
+    c.seconds = run_threads(threads, cb, nullptr);
+    std::vector<uint64_t> latency((size_t)threads * s_events);
+    run_threads(threads, cb, &latency);
+    c.max = *std::max_element(latency.begin(), latency.end());
+    c.p50 = percentile(latency, 0.5);
+    c.p99 = percentile(latency, 0.99);
+    c.p999 = percentile(latency, 0.999);
+    return c;
+}
+
+static void write_case(std::ostream& os, const Case& c, bool json, bool first) {
+    uint64_t eps = c.seconds > 0 ? (uint64_t)(c.events / c.seconds) : 0;
+    if (json) {
+        os << (first ? "[\n" : ",\n") << "  {\"appender\": \"" << c.appender
+           << "\", \"macro\": \"" << c.macro << "\", \"level\": \"" << c.level
+           << "\", \"threads\": " << c.threads << ", \"events\": " << c.events
+           << ", \"seconds\": " << c.seconds << ", \"events_per_sec\": " << eps
+           << ", \"p50_ns\": " << c.p50 << ", \"p99_ns\": " << c.p99
+           << ", \"p999_ns\": " << c.p999 << ", \"max_ns\": " << c.max
+           << ", \"timer_ns\": " << s_timer_ns << "}";
+    } else {
+        if (first) {
+            os << "appender,macro,level,threads,events,seconds,events_per_sec,"
+                  "p50_ns,p99_ns,p999_ns,max_ns,timer_ns\n";
+        }
+        os << c.appender << "," << c.macro << "," << c.level << "," << c.threads << ","
+           << c.events << "," << c.seconds << "," << eps << "," << c.p50 << ","
+           << c.p99 << "," << c.p999 << "," << c.max << "," << s_timer_ns << "\n";
+    }
+    os.flush();
+}
+
+//两次取时间之间的开销，延迟数据中包含这部分
+static uint64_t timer_overhead() {
+    uint64_t min = UINT64_MAX;
+    for (int i = 0; i < 100000; ++i) {
+        uint64_t begin = NowNs();
+        min = std::min(min, NowNs() - begin);
+    }
+    return min;
+}
+
+static std::vector<std::string> split(const std::string& str) {
+    std::vector<std::string> rt;
+    size_t begin = 0;
+    while (begin <= str.size()) {
+        size_t end = str.find(',', begin);
+        if (end == std::string::npos) {
+            end = str.size();
+        }
+        if (end > begin) {
+            rt.push_back(str.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return rt;
+}
+
+int main(int argc, char* argv[])
+{
+    int max_threads = std::min(8u, std::max(1u, std::thread::hardware_concurrency()));
+    bool json = false;
+    std::string output;
+    std::string appenders = "null,stdout,file";
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:f:o:a:")) != -1) {
+        switch (opt) {
+            case 't': max_threads = std::max(1, atoi(optarg)); break;
+            case 'n': s_events = std::max(1, atoi(optarg)); break;
+            case 'f': json = std::string(optarg) == "json"; break;
+            case 'o': output = optarg; break;
+            case 'a': appenders = optarg; break;
+            default:
+                std::cerr << "usage: " << argv[0] << " [-t max_threads] [-n events_per_thread]"
+                          << " [-f csv|json] [-o file] [-a null,stdout,file]" << std::endl;
+                return 1;
+        }
+    }
+
+    //stdout appender的输出丢到/dev/null，结果写到原来的标准输出或-o指定的文件
+    int saved = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+    std::ofstream ofs;
+    if (output.empty()) {
+        output = "/dev/fd/" + std::to_string(saved);
+    }
+    ofs.open(output);
+    if (!ofs) {
+        std::cerr << "open " << output << " failed" << std::endl;
+        return 1;
+    }
+
+    s_timer_ns = timer_overhead();
+    std::vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);
+
+    bool first = true;
+    for (auto& name : split(appenders)) {
+        noobnet::LogAppender::ptr appender;
+        if (name == "null") {
+            appender.reset(new NullLogAppender);
+        } else if (name == "stdout") {
+            appender.reset(new noobnet::StdoutLogAppender);
+        } else if (name == "file") {
+            unlink(s_file);
+            appender.reset(new noobnet::FileLogAppender(s_file));
+        } else {
+            std::cerr << "unknown appender " << name << std::endl;
+            continue;
+        }
+        appender->setFormater(noobnet::LogFormatter::ptr(new noobnet::LogFormatter(s_pattern)));
+        s_logger.reset(new noobnet::Logger("bench_" + name));
+        s_logger->setLevel(noobnet::LogLevel::INFO);
+        s_logger->addAppender(appender);
+
+        for (auto& macro : {"stream", "fmt", "print"}) {
+            for (bool enabled : {false, true}) {
+                for (int t : thread_counts) {
+                    write_case(ofs, run_case(name, macro, enabled, t), json, first);
+                    first = false;
+                }
+            }
+        }
+        s_logger->clearAppenders();
+    }
+    if (json) {
+        ofs << (first ? "[\n]\n" : "\n]\n");
+    }
+    unlink(s_file);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "../net/log.h"
+#include <sys/time.h>
+
+static const int s_loops = 10000000;
+
+//原来的logger：级别是普通成员，getLevel直接返回，不经过解析和代数检查
+struct LegacyLogger {
+    noobnet::LogLevel::level m_level = noobnet::LogLevel::INFO;
+    noobnet::LogLevel::level getLevel() { return m_level; }
+};
+
+//原来的宏：每次都读取logger的级别
+#define SYS_LOG_LEGACY_DEBUG(legacy, logger) \
+  if (legacy->getLevel() <= noobnet::LogLevel::DEBUG)  \
+    noobnet::LogEventWrap(__FILE__, __LINE__,\
+    0, 1, 2, noobnet::GetCurrentUS(), logger, noobnet::LogLevel::DEBUG).getSS()
+
+static volatile int s_sink = 0;
+
+static uint64_t NowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+static void report(const char* name, uint64_t us) {
+    std::cout << name << ": " << s_loops << " calls in " << us / 1000.0 << " ms, "
+              << (us * 1000.0 / s_loops) << " ns/call" << std::endl;
+}
+
+static void legacy(std::shared_ptr<LegacyLogger> legacy, noobnet::Logger::ptr logger) {
+    for (int i = 0; i < s_loops; ++i) {
+        SYS_LOG_LEGACY_DEBUG(legacy, logger) << "value " << i;
+        s_sink = i;
+    }
+}
+
+static void site(noobnet::Logger::ptr logger) {
+    for (int i = 0; i < s_loops; ++i) {
+        SYS_LOG_DEBUG(logger) << "value " << i;
+        s_sink = i;
+    }
+}
+
+static void site_off(noobnet::Logger::ptr logger) {
+    for (int i = 0; i < s_loops; ++i) {
+        SYS_LOG_DEBUG(logger) << "value " << i;
+        s_sink = i;
+    }
+}
+
+//相当于以 -DLOG_MIN_LEVEL=WARN 编译
+#undef SYS_LOG_MIN_LEVEL
+#define SYS_LOG_MIN_LEVEL 2
+static void compiled_out(noobnet::Logger::ptr logger) {
+    for (int i = 0; i < s_loops; ++i) {
+        SYS_LOG_DEBUG(logger) << "value " << i;
+        s_sink = i;
+    }
+}
+
+static void baseline() {
+    for (int i = 0; i < s_loops; ++i) {
+        s_sink = i;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    noobnet::Logger::ptr logger(new noobnet::Logger("bench"));
+    logger->setLevel(noobnet::LogLevel::INFO);
+
+    uint64_t begin = NowUs();
+    baseline();
+    report("empty loop", NowUs() - begin);
+
+    begin = NowUs();
+    legacy(std::make_shared<LegacyLogger>(), logger);
+    report("runtime level check (before)", NowUs() - begin);
+
+    begin = NowUs();
+    site(logger);
+    report("call-site flag, follow logger", NowUs() - begin);
+
+    //只关闭site_off里的调用点
+    site_off(logger);
+    std::string key;
+    for (auto& i : noobnet::LogSite::ListSites()) {
+        if (i.first.find("bench_log_disabled") != std::string::npos) {
+            key = i.first;
+        }
+    }
+    noobnet::LogSite::SetState(key, noobnet::LogSite::FORCE_OFF);
+    begin = NowUs();
+    site_off(logger);
+    report("call-site flag, forced off", NowUs() - begin);
+
+    begin = NowUs();
+    compiled_out(logger);
+    report("compile-time min level", NowUs() - begin);
+    return 0;
+}
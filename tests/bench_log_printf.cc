@@ -0,0 +1,74 @@
+#include "../net/log.h"
+#include <sys/time.h>
+#include <stdarg.h>
+
+static const int s_loops = 1000000;
+
+static uint64_t NowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+static void report(const char* name, uint64_t us, size_t bytes) {
+    std::cout << name << ": " << s_loops << " events in " << us / 1000.0 << " ms, "
+              << (us * 1000.0 / s_loops) << " ns/event, "
+              << bytes / s_loops << " bytes/event" << std::endl;
+}
+
+//原来的实现：vasprintf分配内存，再拷贝到事件的缓冲
+static void legacy_format(noobnet::LogEvent& event, const char* fmt, ...) {
+    va_list al;
+    va_start(al, fmt);
+    char* buf = nullptr;
+    int len = vasprintf(&buf, fmt, al);
+    if (len != -1) {
+        event.getSS().append(buf, len);
+        free(buf);
+    }
+    va_end(al);
+}
+
+int main(int argc, char const *argv[])
+{
+    noobnet::Logger::ptr logger(new noobnet::Logger("bench"));
+    std::string uri("/index.html");
+
+    //每次构造一个使用线程本地缓冲的事件，与日志宏的用法一致
+    size_t bytes = 0;
+    uint64_t begin = NowUs();
+    for (int i = 0; i < s_loops; ++i) {
+        noobnet::LogEvent event(__FILE__, __LINE__, 0, 1, 2, 0, logger, noobnet::LogLevel::INFO, true);
+        legacy_format(event, "request done uri=%s status=%d cost=%.2f seq=%d", uri.c_str(), 200, 1.25, i);
+        bytes += event.getContentSize();
+    }
+    report("vasprintf (before)", NowUs() - begin, bytes);
+
+    bytes = 0;
+    begin = NowUs();
+    for (int i = 0; i < s_loops; ++i) {
+        noobnet::LogEvent event(__FILE__, __LINE__, 0, 1, 2, 0, logger, noobnet::LogLevel::INFO, true);
+        event.format("request done uri=%s status=%d cost=%.2f seq=%d", uri.c_str(), 200, 1.25, i);
+        bytes += event.getContentSize();
+    }
+    report("vsnprintf into buffer", NowUs() - begin, bytes);
+
+    bytes = 0;
+    begin = NowUs();
+    for (int i = 0; i < s_loops; ++i) {
+        noobnet::LogEvent event(__FILE__, __LINE__, 0, 1, 2, 0, logger, noobnet::LogLevel::INFO, true);
+        event.print("request done uri={} status={} cost={} seq={}", uri, 200, 1.25, i);
+        bytes += event.getContentSize();
+    }
+    report("{} placeholders", NowUs() - begin, bytes);
+
+    bytes = 0;
+    begin = NowUs();
+    for (int i = 0; i < s_loops; ++i) {
+        noobnet::LogEvent event(__FILE__, __LINE__, 0, 1, 2, 0, logger, noobnet::LogLevel::INFO, true);
+        event.getSS() << "request done uri=" << uri << " status=" << 200 << " cost=" << 1.25 << " seq=" << i;
+        bytes += event.getContentSize();
+    }
+    report("stream", NowUs() - begin, bytes);
+    return 0;
+}
@@ -12,6 +12,29 @@ int main(int argc, const char** argv) {
 
     SYS_LOG_INFO(SYS_LOG_ROOT()) << "test 111";
 
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "int=" << -42 << " uint=" << 42u
+        << " ll=" << -9223372036854775807LL - 1 << " double=" << 3.14159
+        << " char=" << 'c' << " ptr=" << (void*)0 << " str=" << std::string("s");
+    //超过线程本地缓冲的长日志
+    {
+        noobnet::LogStream ss(true);
+        for (int i = 0; i < 1000; ++i) {
+            ss << "0123456789";
+        }
+        SYS_LOG_INFO(SYS_LOG_ROOT()) << "long stream size=" << ss.size()
+            << " tail=" << std::string(ss.data() + ss.size() - 10, 10);
+    }
+
+    //调用点开关：logger为INFO时单独打开一条DEBUG，只会输出 i=1
+    logger->setLevel(noobnet::LogLevel::INFO);
+    std::string site = std::string(__FILE__) + ":" + std::to_string(__LINE__ + 2);
+    for (int i = 0; i < 3; ++i) {
+        SYS_LOG_DEBUG(logger) << "site debug i=" << i;
+        noobnet::LogSite::SetState(site, i == 0 ? noobnet::LogSite::FORCE_ON
+                                                : noobnet::LogSite::FORCE_OFF);
+    }
+    noobnet::LogSite::SetState(site, noobnet::LogSite::FOLLOW);
+
     //SYS_LOG_FMT_INFO(logger, "this is diy test%S", "heheheh");
 
     return 0;
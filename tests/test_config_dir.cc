@@ -0,0 +1,174 @@
+#include "../net/config.h"
+#include <fstream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+static const std::string s_dir = "/tmp/noobnet_test_config_dir";
+
+//统计转换次数的配置类型，用来确认没有变化的配置项不会被重新解析
+struct Counted {
+    int value = 0;
+    bool operator==(const Counted& rhs) const { return value == rhs.value; }
+};
+
+static int s_casts = 0;
+
+namespace noobnet {
+template<>
+class LexicalCast<YAML::Node, Counted> {
+public:
+    Counted operator() (const YAML::Node& node) {
+        ++s_casts;
+        Counted c;
+        c.value = node.as<int>();
+        return c;
+    }
+};
+
+template<>
+class LexicalCast<std::string, Counted> {
+public:
+    Counted operator() (const std::string& str) {
+        return LexicalCast<YAML::Node, Counted>()(YAML::Load(str));
+    }
+};
+
+template<>
+class LexicalCast<Counted, std::string> {
+public:
+    std::string operator() (const Counted& v) {
+        return std::to_string(v.value);
+    }
+};
+}
+
+noobnet::ConfigVar<Counted>::ptr g_a_port =
+    noobnet::Config::LookUp(Counted(), "dir.a.port", "dir a port");
+noobnet::ConfigVar<Counted>::ptr g_a_timeout =
+    noobnet::Config::LookUp(Counted(), "dir.a.timeout", "dir a timeout");
+noobnet::ConfigVar<std::vector<std::string>>::ptr g_a_hosts =
+    noobnet::Config::LookUp(std::vector<std::string>(), "dir.a.hosts", "dir a hosts");
+noobnet::ConfigVar<std::string>::ptr g_b_name =
+    noobnet::Config::LookUp(std::string(), "dir.b.name", "dir b name");
+noobnet::ConfigVar<Counted>::ptr g_c =
+    noobnet::Config::LookUp(Counted(), "dir.c", "dir c");
+noobnet::ConfigVar<int>::ptr g_d =
+    noobnet::Config::LookUp(0, "dir.d", "dir d");
+noobnet::ConfigVar<bool>::ptr g_flag =
+    noobnet::Config::LookUp(false, "dir.flag", "dir flag");
+noobnet::ConfigVar<std::map<std::string, int>>::ptr g_e =
+    noobnet::Config::LookUp(std::map<std::string, int>(), "dir.e", "dir e");
+noobnet::ConfigVar<int>::ptr g_e_x =
+    noobnet::Config::LookUp(0, "dir.e.x", "dir e x");
+
+//写入文件并指定修改时间，避免同一时钟周期内的两次写入修改时间相同
+static void write_file(const std::string& name, const std::string& content, time_t mtime) {
+    std::string path = s_dir + "/" + name;
+    std::ofstream(path) << content;
+    struct timespec ts[2];
+    ts[0].tv_sec = ts[1].tv_sec = mtime;
+    ts[0].tv_nsec = ts[1].tv_nsec = 0;
+    utimensat(AT_FDCWD, path.c_str(), ts, 0);
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    system(("rm -rf " + s_dir).c_str());
+    mkdir(s_dir.c_str(), 0755);
+    mkdir((s_dir + "/sub").c_str(), 0755);
+
+    write_file("a.yml", "dir:\n  a:\n    port: 80\n    timeout: 10\n    hosts: [x, y]\n", 1000);
+    write_file("b.yml", "dir:\n  b:\n    name: foo\n", 1000);
+    write_file("sub/c.yml", "dir.c: 1\n", 1000);
+    write_file("d.txt", "dir:\n  d: 1\n", 1000);
+
+    int changes = 0;
+    g_a_hosts->addListener([&changes](const std::vector<std::string>&, const std::vector<std::string>&) {
+        ++changes;
+    });
+
+    noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_a_port->getValue().value == 80 && g_a_timeout->getValue().value == 10;
+    ok &= g_a_hosts->getValue().size() == 2 && g_b_name->getValue() == "foo";
+    ok &= g_c->getValue().value == 1 && g_d->getValue() == 0;
+    ok &= s_casts == 3 && changes == 1;
+
+    //没有变化的目录不做任何事
+    noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= s_casts == 3;
+
+    //只改了修改时间
+    write_file("a.yml", "dir:\n  a:\n    port: 80\n    timeout: 10\n    hosts: [x, y]\n", 2000);
+    noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= s_casts == 3;
+
+    //只有变化的配置项重新解析
+    write_file("a.yml", "dir:\n  a:\n    port: 81\n    timeout: 10\n    hosts: [x, y]\n", 3000);
+    noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_a_port->getValue().value == 81 && s_casts == 4 && changes == 1;
+
+    //解析失败时保留原来的值，修复后重新加载
+    write_file("b.yml", "dir:\n  b:\n    name: [bar\n", 3000);
+    noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_b_name->getValue() == "foo";
+    write_file("b.yml", "dir:\n  b:\n    name: bar\n", 4000);
+    noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_b_name->getValue() == "bar";
+
+    //多个文件的修改一起应用，删除的文件不影响当前的值
+    write_file("a.yml", "dir:\n  a:\n    port: 82\n    timeout: 10\n    hosts: [x, y, z]\n", 5000);
+    write_file("sub/c.yml", "dir.c: 2\n", 5000);
+    noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_a_port->getValue().value == 82 && g_c->getValue().value == 2;
+    ok &= g_a_hosts->getValue().size() == 3 && changes == 2 && s_casts == 6;
+    unlink((s_dir + "/sub/c.yml").c_str());
+    noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_c->getValue().value == 2 && s_casts == 6;
+
+    //force重新解析所有文件
+    noobnet::Config::LoadFromConfDir(s_dir, true);
+    ok &= s_casts == 8 && g_a_port->getValue().value == 82;
+
+    //同名配置项以排序靠后的文件为准，即使只修改了靠前的文件
+    write_file("a.yml", "dir:\n  a:\n    port: 82\n    timeout: 10\n    hosts: [x, y, z]\n"
+        "  b:\n    name: froma\n", 6000);
+    ok &= noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_b_name->getValue() == "bar" && s_casts == 8;
+
+    //转换失败时保留原来的值并返回false，文件修复前每次都重新尝试
+    write_file("sub/c.yml", "dir.c: abc\n", 7000);
+    ok &= !noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_c->getValue().value == 2 && s_casts == 9;
+    ok &= !noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_c->getValue().value == 2 && s_casts == 10;
+    write_file("sub/c.yml", "dir.c: 3\n", 8000);
+    ok &= noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_c->getValue().value == 3 && s_casts == 11;
+
+    //注册过的节点下面注册的配置项同样加载
+    write_file("e.yml", "dir:\n  e:\n    x: 5\n    y: 6\n", 9000);
+    ok &= noobnet::Config::LoadFromConfDir(s_dir);
+    ok &= g_e->getValue().size() == 2 && g_e_x->getValue() == 5;
+
+    //回调中可以注册新的配置项
+    int count = 0;
+    noobnet::Config::Visit([&count](noobnet::ConfigVarBase::ptr var) {
+        if (var->getName().compare(0, 4, "dir.") == 0) {
+            ++count;
+        }
+        noobnet::Config::LookUp(0, "dir.visit", "dir visit");
+    });
+    ok &= count == 9;
+
+    //bool输出1/0，输出的内容和YAML的写法都能读回
+    ok &= g_flag->toString() == "0";
+    ok &= g_flag->fromString("1") && g_flag->getValue() && g_flag->toString() == "1";
+    ok &= g_flag->fromString("false") && !g_flag->getValue();
+
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "casts=" << s_casts << " changes=" << changes
+        << " ok=" << ok;
+    system(("rm -rf " + s_dir).c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include "../net/config.h"
+#include "../net/thread.h"
+#include "../net/epoch.h"
+#include <atomic>
+#include <time.h>
+
+static const int s_threads = 4;
+static const int s_loops = 1000000;
+
+noobnet::ConfigVar<int>::ptr g_int =
+    noobnet::Config::LookUp(1, "handle.int", "handle int");
+noobnet::ConfigVar<std::map<std::string, int>>::ptr g_map =
+    noobnet::Config::LookUp(std::map<std::string, int>{{"a", 1}}, "handle.map", "handle map");
+
+static noobnet::ConfigHandle<int> s_int(g_int);
+static noobnet::ConfigHandle<std::map<std::string, int>> s_map(g_map);
+
+std::atomic<bool> g_stop {false};
+std::atomic<uint64_t> g_bad {0};
+
+static uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+//读线程：map中每个值都等于"n"的值，读到的快照必须完整
+void reader() {
+    while (!g_stop) {
+        const std::map<std::string, int>& m = s_map.get();
+        int n = m.at("n");
+        for (auto& i : m) {
+            if (i.first != "n" && i.second != n) {
+                ++g_bad;
+            }
+        }
+        if (s_int.get() < 1) {
+            ++g_bad;
+        }
+        //不经过句柄直接读取
+        std::shared_ptr<const std::map<std::string, int>> snapshot = g_map->getSnapshot();
+        if (snapshot->size() > 2 && snapshot->at("k0") != snapshot->at("n")) {
+            ++g_bad;
+        }
+        if (g_int->getValue() < 1) {
+            ++g_bad;
+        }
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    ok &= s_int.get() == 1 && s_map->size() == 1;
+    uint64_t version = g_int->getVersion();
+    g_int->setValue(2);
+    ok &= g_int->getVersion() > version && *s_int == 2;
+    //值不变时代数不变
+    version = g_int->getVersion();
+    g_int->setValue(2);
+    ok &= g_int->getVersion() == version;
+    //不同配置项的代数不同
+    ok &= g_int->getVersion() != g_map->getVersion();
+
+    //通过配置文件修改
+    noobnet::Config::LoadFromYaml(YAML::Load("handle:\n  int: 3\n  map:\n    n: 0\n    x: 0\n"));
+    ok &= s_int.get() == 3 && s_map->size() == 2 && s_map->at("n") == 0;
+
+    std::vector<noobnet::Thread::ptr> thrs;
+    for (int i = 0; i < s_threads; ++i) {
+        thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread(&reader, "reader_" + std::to_string(i))));
+    }
+    for (int i = 1; i <= 200; ++i) {
+        std::map<std::string, int> m;
+        m["n"] = i;
+        for (int j = 0; j < 50; ++j) {
+            m["k" + std::to_string(j)] = i;
+        }
+        g_map->setValue(m);
+        g_int->setValue(3 + i);
+    }
+    g_stop = true;
+    for (auto& i : thrs) {
+        i->join();
+    }
+    ok &= g_bad == 0 && s_map->at("n") == 200 && s_int.get() == 203;
+
+    //持有的旧快照在替换并回收之后仍然有效
+    std::shared_ptr<const std::map<std::string, int>> held = g_map->getSnapshot();
+    g_map->setValue(std::map<std::string, int>{{"n", 300}});
+    noobnet::Epoch::Synchronize();
+    ok &= held->at("n") == 200 && held->size() == 51 && g_map->getSnapshot()->at("n") == 300;
+    ok &= noobnet::Epoch::GetPending() == 0;
+
+    //下标复用后不会读到其他配置项的缓存
+    {
+        noobnet::ConfigVar<int>::ptr other = noobnet::Config::LookUp(100, "handle.other", "");
+        {
+            noobnet::ConfigHandle<int> h(g_int);
+            ok &= h.get() == 203;
+        }
+        noobnet::ConfigHandle<int> h(other);
+        ok &= h.get() == 100;
+    }
+
+    uint64_t sum = 0;
+    uint64_t begin = NowNs();
+    for (int i = 0; i < s_loops; ++i) {
+        sum += g_int->getValue();
+    }
+    uint64_t value_ns = NowNs() - begin;
+    begin = NowNs();
+    for (int i = 0; i < s_loops; ++i) {
+        sum += s_int.get();
+    }
+    uint64_t handle_ns = NowNs() - begin;
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "getValue: " << value_ns / (double)s_loops << " ns/read, handle: "
+        << handle_ns / (double)s_loops << " ns/read, sum=" << sum << " bad=" << g_bad;
+    ok &= handle_ns < value_ns;
+    return ok ? 0 : 1;
+}
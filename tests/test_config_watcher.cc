@@ -0,0 +1,87 @@
+#include "../net/config.h"
+#include "../net/config_watcher.h"
+#include <fstream>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static const std::string s_dir = "/tmp/noobnet_test_config_watcher";
+
+noobnet::ConfigVar<int>::ptr g_port =
+    noobnet::Config::LookUp(0, "watch.port", "watch port");
+noobnet::ConfigVar<std::string>::ptr g_name =
+    noobnet::Config::LookUp(std::string(), "watch.sub.name", "watch sub name");
+
+static void write_file(const std::string& name, const std::string& content) {
+    std::ofstream(s_dir + "/" + name) << content;
+}
+
+//等待加载次数达到n，超时返回false
+static bool wait_reloads(noobnet::ConfigWatcher& w, uint64_t n) {
+    for (int i = 0; i < 200 && w.getReloads() < n; ++i) {
+        usleep(10 * 1000);
+    }
+    return w.getReloads() >= n;
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    system(("rm -rf " + s_dir).c_str());
+    mkdir(s_dir.c_str(), 0755);
+    write_file("a.yml", "watch:\n  port: 80\n");
+
+    int changes = 0;
+    g_port->addListener([&changes](const int&, const int&) {
+        ++changes;
+    });
+
+    noobnet::ConfigWatcher watcher(s_dir, 50);
+    ok &= g_port->getValue() == 80 && watcher.getReloads() == 0 && changes == 1;
+
+    //一连串的写入只触发一次加载
+    for (int i = 1; i <= 5; ++i) {
+        write_file("a.yml", "watch:\n  port: " + std::to_string(8080 + i) + "\n");
+        usleep(5 * 1000);
+    }
+    ok &= wait_reloads(watcher, 1);
+    usleep(200 * 1000);
+    ok &= watcher.getReloads() == 1 && g_port->getValue() == 8085 && changes == 2;
+
+    //解析失败保留原来的值
+    write_file("a.yml", "watch:\n  port: [1\n");
+    ok &= wait_reloads(watcher, 2);
+    ok &= watcher.getParseFailures() == 1 && g_port->getValue() == 8085;
+    write_file("a.yml", "watch:\n  port: 90\n");
+    ok &= wait_reloads(watcher, 3);
+    ok &= watcher.getParseFailures() == 1 && g_port->getValue() == 90 && changes == 3;
+
+    //类型不对的值同样计入失败，保留原来的值
+    write_file("a.yml", "watch:\n  port: abc\n");
+    ok &= wait_reloads(watcher, 4);
+    ok &= watcher.getParseFailures() == 2 && g_port->getValue() == 90 && changes == 3;
+    write_file("a.yml", "watch:\n  port: 90\n");
+    ok &= wait_reloads(watcher, 5);
+    ok &= watcher.getParseFailures() == 2 && g_port->getValue() == 90 && changes == 3;
+
+    //其他文件的变化不触发加载
+    uint64_t events = watcher.getEvents();
+    write_file("a.yml.swp", "x");
+    usleep(200 * 1000);
+    ok &= watcher.getEvents() > events && watcher.getReloads() == 5;
+
+    //新建的子目录
+    mkdir((s_dir + "/sub").c_str(), 0755);
+    usleep(100 * 1000);
+    write_file("sub/b.yml", "watch.sub.name: hot\n");
+    for (int i = 0; i < 200 && g_name->getValue() != "hot"; ++i) {
+        usleep(10 * 1000);
+    }
+    ok &= g_name->getValue() == "hot";
+
+    ok &= watcher.getTotalReloadUs() >= watcher.getMaxReloadUs()
+        && watcher.getMaxReloadUs() >= watcher.getLastReloadUs();
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "\n" << watcher.metricsToYamlString();
+    ok &= watcher.metricsToYamlString().find("parse_failures: 2") != std::string::npos;
+    system(("rm -rf " + s_dir).c_str());
+    return ok ? 0 : 1;
+}
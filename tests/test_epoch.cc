@@ -0,0 +1,178 @@
+#include "../net/log.h"
+#include "../net/epoch.h"
+#include "../net/thread.h"
+#include <atomic>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static const int s_readers = 4;
+static const int s_updates = 2000;
+static const uint64_t s_magic = 0x5a5a5a5a5a5a5a5aul;
+
+//析构时清除标记并记录所在的线程，读者读到清除后的标记说明读到了已释放的对象
+struct Value {
+    uint64_t magic = s_magic;
+    int id = 0;
+    ~Value();
+};
+
+std::atomic<const Value*> g_value {nullptr};
+std::atomic<bool> g_stop {false};
+std::atomic<uint64_t> g_reads {0};
+std::atomic<uint64_t> g_bad {0};
+std::atomic<uint64_t> g_destroyed {0};
+std::atomic<uint64_t> g_off_thread {0};
+
+Value::~Value() {
+    magic = 0;
+    ++g_destroyed;
+    if (noobnet::Thread::GetName() == "epoch_reclaim") {
+        ++g_off_thread;
+    }
+}
+
+void reader() {
+    while (!g_stop) {
+        noobnet::EpochGuard guard;
+        const Value* v = g_value.load();
+        if (v->magic != s_magic) {
+            ++g_bad;
+        }
+        //嵌套的临界区
+        {
+            noobnet::EpochGuard inner;
+            if (g_value.load()->magic != s_magic) {
+                ++g_bad;
+            }
+        }
+        if (v->magic != s_magic) {
+            ++g_bad;
+        }
+        ++g_reads;
+    }
+}
+
+//进程退出时的释放在子进程中检查，析构的顺序写入管道
+static int s_pipe = -1;
+
+struct Marker {
+    char c = 0;
+    ~Marker() {
+        if (write(s_pipe, &c, 1) != 1) {
+            _exit(2);
+        }
+    }
+};
+
+static std::shared_ptr<const Marker> make_marker(char c) {
+    std::shared_ptr<Marker> m(new Marker);
+    m->c = c;
+    return m;
+}
+
+//在第一次Retire之前构造，因此在回收线程停止之后析构
+struct LateRetire {
+    ~LateRetire() {
+        noobnet::Epoch::Retire(make_marker('L'));
+    }
+};
+
+//子进程：读者停在临界区内时退出，期望的顺序是读者离开(R)、剩余对象释放(D)、停止后交出的对象释放(L)
+static bool exit_order() {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        s_pipe = fds[1];
+        static LateRetire s_late;
+        std::atomic<bool>* entered = new std::atomic<bool>(false);
+        new noobnet::Thread([entered] () {
+            noobnet::EpochGuard guard;
+            *entered = true;
+            usleep(200 * 1000);
+            char c = 'R';
+            if (write(s_pipe, &c, 1) != 1) {
+                _exit(2);
+            }
+        }, "holder");
+        while (!*entered) {
+            usleep(1000);
+        }
+        noobnet::Epoch::Retire(make_marker('D'));
+        exit(0);
+    }
+    close(fds[1]);
+    std::string order;
+    char c;
+    while (read(fds[0], &c, 1) == 1) {
+        order.push_back(c);
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "exit order=" << order;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 && order == "RDL";
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    //必须在本进程第一次Retire之前fork，子进程里才没有继承来的回收线程状态
+    ok &= exit_order();
+    std::shared_ptr<const Value> cur(new Value);
+    g_value.store(cur.get());
+
+    std::vector<noobnet::Thread::ptr> thrs;
+    for (int i = 0; i < s_readers; ++i) {
+        thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread(&reader, "reader_" + std::to_string(i))));
+    }
+    for (int i = 1; i <= s_updates; ++i) {
+        std::shared_ptr<Value> next(new Value);
+        next->id = i;
+        g_value.store(next.get());
+        noobnet::Epoch::Retire(cur);
+        cur = next;
+        if (i % 100 == 0) {
+            usleep(1000);
+        }
+    }
+    g_stop = true;
+    for (auto& i : thrs) {
+        i->join();
+    }
+
+    noobnet::Epoch::Synchronize();
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "reads=" << g_reads << " bad=" << g_bad
+        << " destroyed=" << g_destroyed << " off_thread=" << g_off_thread
+        << " pending=" << noobnet::Epoch::GetPending();
+    ok &= g_bad == 0 && g_reads > 0;
+    //交出的对象全部在回收线程上释放
+    ok &= g_destroyed == (uint64_t)s_updates && g_off_thread == (uint64_t)s_updates;
+    ok &= noobnet::Epoch::GetPending() == 0;
+
+    //有读者停在临界区内时，之后交出的对象不会被释放
+    std::atomic<bool> entered {false};
+    std::atomic<bool> leave {false};
+    noobnet::Thread::ptr holder(new noobnet::Thread([&entered, &leave] () {
+        noobnet::EpochGuard guard;
+        entered = true;
+        while (!leave) {
+            usleep(1000);
+        }
+    }, "holder"));
+    while (!entered) {
+        usleep(1000);
+    }
+    noobnet::Epoch::Retire(cur);
+    cur.reset();
+    usleep(50 * 1000);
+    ok &= g_destroyed == (uint64_t)s_updates && noobnet::Epoch::GetPending() == 1;
+    leave = true;
+    holder->join();
+    noobnet::Epoch::Synchronize();
+    ok &= g_destroyed == (uint64_t)s_updates + 1 && noobnet::Epoch::GetPending() == 0;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include "../net/log.h"
+#include "../net/log_async.h"
+#include "../net/thread.h"
+#include <fstream>
+#include <unistd.h>
+
+static const char* s_file = "/tmp/noobnet_test_log_async.txt";
+static const int s_threads = 4;
+static const int s_lines = 20000;
+
+noobnet::Logger::ptr g_logger = SYS_LOG_NAME("async_test");
+
+void run() {
+    for (int i = 0; i < s_lines; ++i) {
+        SYS_LOG_INFO(g_logger) << "async line " << i;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    unlink(s_file);
+    noobnet::AsyncLogAppender::ptr appender(
+        new noobnet::AsyncLogAppender(s_file, 64 * 1024));
+    g_logger->addAppender(appender);
+
+    std::vector<noobnet::Thread::ptr> thrs;
+    for (int i = 0; i < s_threads; ++i) {
+        thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread(&run, "async_" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    appender->flush();
+
+    //超过缓冲区容量的日志同步写出，不能跑到同一线程之前的日志前面
+    SYS_LOG_INFO(g_logger) << "async before big";
+    SYS_LOG_INFO(g_logger) << "async big " << std::string(128 * 1024, 'x');
+    appender->flush();
+
+    std::ifstream ifs(s_file);
+    std::string line;
+    int count = 0;
+    int before = -1;
+    int big = -1;
+    while (std::getline(ifs, line)) {
+        if (line.find("async before big") != std::string::npos) {
+            before = count;
+        } else if (line.find("async big ") != std::string::npos) {
+            big = count;
+        }
+        ++count;
+    }
+    count -= 2;
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "lines=" << count
+        << " expect=" << s_threads * s_lines
+        << " written=" << appender->getWritten()
+        << " blocked=" << appender->getBlocked()
+        << " dropped=" << appender->getDropped()
+        << " depth=" << appender->getQueueDepth();
+    return count == s_threads * s_lines && before >= 0 && big > before ? 0 : 1;
+}
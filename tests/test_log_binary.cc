@@ -0,0 +1,137 @@
+#include "../net/log.h"
+#include "../net/log_binary.h"
+#include "../net/thread.h"
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <algorithm>
+
+static const char* s_file = "/tmp/noobnet_test_log_binary.bin";
+static const char* s_text = "/tmp/noobnet_test_log_binary.txt";
+static const char* s_pattern = "%d{%Y-%m-%d %H:%M:%S.%6}%T%t%T%N%T%F%T[%p]%T%c%T%f:%l%T%m%n";
+static const int s_threads = 4;
+static const int s_lines = 2000;
+
+noobnet::Logger::ptr g_logger = SYS_LOG_NAME("binary_test");
+
+static std::string read_file(const char* path) {
+    std::ifstream ifs(path, std::ios::binary);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+//两个appender各自加锁，多线程下行的先后顺序可能不同，排序后再比较
+static std::vector<std::string> sorted_lines(const std::string& str) {
+    std::vector<std::string> lines;
+    std::stringstream ss(str);
+    std::string line;
+    while (std::getline(ss, line)) {
+        lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+void run() {
+    for (int i = 0; i < s_lines; ++i) {
+        SYS_LOG_FMT_INFO(g_logger, "fmt %d %s %.3f", i, "abc", i * 0.5);
+        SYS_LOG_INFO(g_logger) << "stream " << i;
+    }
+}
+
+//printf风格参数编码后还原的结果应与vsnprintf一致
+static bool check_render(const char* fmt, ...) {
+    va_list al;
+    va_start(al, fmt);
+    va_list copy;
+    va_copy(copy, al);
+    char expect[512];
+    vsnprintf(expect, sizeof(expect), fmt, copy);
+    va_end(copy);
+
+    noobnet::LogStream args;
+    noobnet::LogStream text;
+    bool ok = noobnet::LogArgs::Encode(args, fmt, al)
+        && noobnet::LogArgs::Render(fmt, args.data(), args.size(), text);
+    va_end(al);
+    if (!ok || text.str() != expect) {
+        SYS_LOG_ERROR(SYS_LOG_ROOT()) << "render mismatch fmt=" << fmt
+            << " expect=" << expect << " got=" << text.str();
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    const char buf[] = {'x', 'y', 'z'};
+    ok &= check_render("plain text 100%%");
+    ok &= check_render("%d %i %5d %-5d| %+d %05d", -1, 42, 7, 7, 3, -12);
+    ok &= check_render("%hhd %hd %ld %lld %zu %jd", 300, 70000, -5l, 1ll << 40, (size_t)9, (intmax_t)-9);
+    ok &= check_render("%u %o %x %X %#x %lu", 3000000000u, 8u, 255u, 255u, 255u, ~0ul);
+    ok &= check_render("%f %.2f %10.3e %g %Lf", 3.14159, 2.5, 12345.678, 0.0001, (long double)1.5);
+    ok &= check_render("%s|%10s|%-10s|%.2s|%.*s|%*d", "hi", "right", "left", "abcdef", 3, buf, -6, 4);
+    ok &= check_render("%c%c %p %s", 'o', 'k', (void*)0x1234, (const char*)nullptr);
+
+    unlink(s_file);
+    unlink(s_text);
+    noobnet::BinaryLogAppender::ptr binary(new noobnet::BinaryLogAppender(s_file, 4096));
+    noobnet::FileLogAppender::ptr text(new noobnet::FileLogAppender(s_text));
+    text->setFormater(noobnet::LogFormatter::ptr(new noobnet::LogFormatter(s_pattern)));
+    g_logger->addAppender(binary);
+    g_logger->addAppender(text);
+
+    std::vector<noobnet::Thread::ptr> thrs;
+    for (int i = 0; i < s_threads; ++i) {
+        thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread(&run, "binary_" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    SYS_LOG_FMT_WARN(g_logger, "unsupported %m conversion falls back to text %d", 1);
+    //运行时生成的格式串复用同一块缓冲区，宏按文本写入
+    char dyn[32];
+    for (int i = 0; i < 2; ++i) {
+        snprintf(dyn, sizeof(dyn), "dynamic%d %%d", i);
+        SYS_LOG_FMT_INFO(g_logger, dyn, i);
+        const char* rt = dyn;
+        SYS_LOG_FMT_INFO(g_logger, rt, i + 10);
+        std::string str = std::string("string") + dyn;
+        SYS_LOG_FMT_INFO(g_logger, str.c_str(), i + 20);
+    }
+    g_logger->clearAppenders();
+    uint64_t events = binary->getEvents();
+    binary->flush();
+
+    std::string data = read_file(s_file);
+    noobnet::BinaryLogReader reader(s_pattern);
+    noobnet::LogStream out;
+    int64_t n = reader.decode(data.c_str(), data.size(), out);
+    std::string expect = read_file(s_text);
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "events=" << events << " decoded=" << n
+        << " binary=" << data.size() << " text=" << expect.size();
+    if (n != (int64_t)events || sorted_lines(out.str()) != sorted_lines(expect)) {
+        SYS_LOG_ERROR(SYS_LOG_ROOT()) << "decoded text differs from text appender";
+        ok = false;
+    }
+
+    //缓冲未满时由后台线程按时间写出，不需要调用flush
+    unlink(s_file);
+    binary.reset(new noobnet::BinaryLogAppender(s_file, 1024 * 1024, 20));
+    g_logger->addAppender(binary);
+    SYS_LOG_FMT_INFO(g_logger, "tick %d", 1);
+    g_logger->clearAppenders();
+    size_t size = 0;
+    for (int i = 0; i < 1000 && size == 0; ++i) {
+        usleep(1000);
+        noobnet::LogStream tick;
+        data = read_file(s_file);
+        if (reader.decode(data.c_str(), data.size(), tick) == 1) {
+            size = data.size();
+        }
+    }
+    ok &= size > 0 && binary->getEvents() == 1;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include "../net/log.h"
+#include "../net/log_console.h"
+#include "../net/utils.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <atomic>
+#include <thread>
+#include <iostream>
+
+//读取管道并统计行数
+static std::atomic<uint64_t> s_lines {0};
+static std::atomic<bool> s_reading {false};
+static std::atomic<bool> s_stop {false};
+
+static void reader(int fd) {
+    char buf[64 * 1024];
+    while (!s_stop) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (!s_reading || poll(&pfd, 1, 10) <= 0) {
+            usleep(1000);
+            continue;
+        }
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            s_lines += buf[i] == '\n';
+        }
+    }
+}
+
+//等待积压写完
+static bool drain(noobnet::ConsoleLogAppender::ptr ap) {
+    uint64_t begin = noobnet::GetMonotonicUS();
+    while (ap->getBacklog() > 0 && noobnet::GetMonotonicUS() - begin < 5 * 1000 * 1000) {
+        ap->flush();
+        usleep(1000);
+    }
+    return ap->getBacklog() == 0;
+}
+
+static void dump(const char* name, noobnet::ConsoleLogAppender::ptr ap) {
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << name << ": flushes=" << ap->getFlushes()
+        << " last_us=" << ap->getLastFlushUs() << " max_us=" << ap->getMaxFlushUs()
+        << " avg_us=" << (ap->getFlushes() ? ap->getTotalFlushUs() / ap->getFlushes() : 0)
+        << " written=" << ap->getWritten() << " max_backlog=" << ap->getMaxBacklog()
+        << " dropped=" << ap->getDropped() << " eagain=" << ap->getWouldBlock()
+        << " errors=" << ap->getWriteErrors();
+}
+
+int main(int argc, char const *argv[])
+{
+    int fds[2];
+    if (pipe(fds)) {
+        return 1;
+    }
+    //把标准输出换成管道，读端由reader统计
+    int saved = dup(STDOUT_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[1]);
+    std::thread t(reader, fds[0]);
+    std::cout.rdbuf()->pubsetbuf(nullptr, 0);
+
+    noobnet::Logger::ptr root = SYS_LOG_ROOT();
+    root->clearAppenders();
+    noobnet::LogAppender::ptr err(new noobnet::StdoutLogAppender);
+    bool ok = true;
+
+    //阻塞模式：按批写出，一行不丢
+    noobnet::Logger::ptr blocking = SYS_LOG_NAME("console_blocking");
+    noobnet::ConsoleLogAppender::ptr bc(new noobnet::ConsoleLogAppender(false, 4096, 10));
+    bc->setFormater(noobnet::LogFormatter::ptr(new noobnet::LogFormatter("%m%n")));
+    blocking->addAppender(bc);
+    s_reading = true;
+    for (int i = 0; i < 100000; ++i) {
+        SYS_LOG_ERROR(blocking) << "blocking line " << i;
+    }
+    ok &= drain(bc);
+    while (s_lines < 100000 && bc->getWriteErrors() == 0) {
+        usleep(1000);
+    }
+    ok &= s_lines == 100000 && bc->getDropped() == 0;
+    blocking->clearAppenders();
+
+    //非阻塞模式：读端停住时写线程不阻塞，超出积压上限的丢弃
+    s_reading = false;
+    s_lines = 0;
+    noobnet::Logger::ptr nonblock = SYS_LOG_NAME("console_nonblock");
+    noobnet::ConsoleLogAppender::ptr nc(new noobnet::ConsoleLogAppender(false, 4096, 10,
+                true, 256 * 1024));
+    nc->setFormater(noobnet::LogFormatter::ptr(new noobnet::LogFormatter("%m%n")));
+    nonblock->addAppender(nc);
+    uint64_t begin = noobnet::GetMonotonicUS();
+    for (int i = 0; i < 200000; ++i) {
+        SYS_LOG_ERROR(nonblock) << "nonblock line " << i;
+    }
+    uint64_t used = noobnet::GetMonotonicUS() - begin;
+    ok &= used < 2 * 1000 * 1000 && nc->getDropped() > 0 && nc->getWouldBlock() > 0
+        && nc->getMaxBacklog() <= 256 * 1024;
+    uint64_t dropped = nc->getDropped();
+    s_reading = true;
+    ok &= drain(nc);
+    while (s_lines + dropped < 200000 && noobnet::GetMonotonicUS() - begin < 10 * 1000 * 1000) {
+        usleep(1000);
+    }
+    ok &= s_lines + dropped == 200000;
+    nonblock->clearAppenders();
+
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    //追加器可能仍被线程缓存的快照持有，管道不会关闭，主动结束读线程
+    s_stop = true;
+    t.join();
+    close(fds[0]);
+
+    root->addAppender(err);
+    SYS_LOG_INFO(root) << "nonblock: 200000 lines in " << used << "us lines=" << s_lines;
+    dump("blocking", bc);
+    dump("nonblock", nc);
+    SYS_LOG_INFO(root) << (ok ? "test_log_console ok" : "test_log_console FAILED");
+    return ok ? 0 : 1;
+}
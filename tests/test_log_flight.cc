@@ -0,0 +1,153 @@
+#include "../net/log.h"
+#include "../net/log_flight.h"
+#include "../net/macro.h"
+#include "../net/config.h"
+#include "../net/thread.h"
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+static const char* s_file = "/tmp/noobnet_test_log_flight.txt";
+
+static const char* s_conf =
+    "flight_recorder:\n"
+    "  enabled: true\n"
+    "  capacity: 64\n"
+    "  file: /tmp/noobnet_test_log_flight.txt\n"
+    "logs:\n"
+    "  - name: flight_test\n"
+    "    level: ERROR\n";
+
+//统计真正提交给appender的条数
+class CountLogAppender : public noobnet::LogAppender {
+public:
+    typedef std::shared_ptr<CountLogAppender> ptr;
+    void log(std::shared_ptr<noobnet::Logger> logger, noobnet::LogLevel::level level,
+             const noobnet::LogEvent& event) override {
+        ++count;
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<uint64_t> count {0};
+};
+
+noobnet::Logger::ptr g_logger = SYS_LOG_NAME("flight_test");
+
+static std::string read_dump() {
+    std::ifstream ifs(s_file);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+static int count_of(const std::string& str, const std::string& sub) {
+    int n = 0;
+    for (size_t pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+void run() {
+    for (int i = 0; i < 100; ++i) {
+        SYS_LOG_DEBUG(g_logger) << "thread " << noobnet::Thread::GetName() << " " << i;
+    }
+}
+
+//记录器安装之前已有的处理函数，转储之后应当被调用
+static void previous_handler(int sig) {
+    int fd = open(s_file, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    const char msg[] = "previous handler\n";
+    if (fd < 0 || write(fd, msg, sizeof(msg) - 1) != sizeof(msg) - 1) {
+        _exit(2);
+    }
+    close(fd);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+//在子进程中触发崩溃，返回子进程的终止信号
+static int crash(bool assert_fail) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        SYS_LOG_DEBUG(g_logger) << "before crash " << assert_fail;
+        if (assert_fail) {
+            SYS_ASSERT(1 + 1 == 3);
+        } else {
+            ::raise(SIGSEGV);
+        }
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    unlink(s_file);
+    signal(SIGSEGV, &previous_handler);
+    noobnet::Config::LoadFromYaml(YAML::Load(s_conf));
+    bool ok = noobnet::FlightRecorder::IsEnabled()
+        && noobnet::FlightRecorder::GetCapacity() == 64
+        && noobnet::FlightRecorder::GetDumpFile() == s_file;
+
+    //低于logger级别的事件只进入记录器
+    CountLogAppender::ptr appender(new CountLogAppender);
+    g_logger->addAppender(appender);
+    for (int i = 0; i < 100; ++i) {
+        SYS_LOG_DEBUG(g_logger) << "filtered " << i;
+        SYS_LOG_FMT_WARN(g_logger, "fmt %d", i);
+    }
+    SYS_LOG_ERROR(g_logger) << "passed";
+    ok &= appender->count == 1;
+    ok &= noobnet::FlightRecorder::GetRecorded() >= 201;
+
+    //线程依次退出，缓冲被之后的线程复用
+    for (int i = 0; i < 4; ++i) {
+        noobnet::Thread::ptr thr(new noobnet::Thread(&run, "flight_" + std::to_string(i)));
+        thr->join();
+    }
+
+    int n = noobnet::FlightRecorder::Dump("test");
+    std::string dump = read_dump();
+    //每个缓冲只保留最近的64条
+    ok &= n == 2 * 64;
+    ok &= count_of(dump, "reason: test") == 1;
+    ok &= count_of(dump, "filtered ") == 31 && count_of(dump, " filtered 99\n") == 1;
+    ok &= count_of(dump, "WARN [flight_test]") == 32 && count_of(dump, " fmt 99\n") == 1;
+    ok &= count_of(dump, "DEBUG [flight_test]") == 31 + 64;
+    ok &= count_of(dump, ":flight_2 ") == 0 && count_of(dump, ":flight_3 ") == 64
+        && count_of(dump, "thread flight_3 99\n") == 1;
+    ok &= count_of(dump, "] passed\n") == 0 && count_of(dump, " passed\n") == 1;
+
+    //关闭后不再记录
+    noobnet::FlightRecorder::SetEnabled(false);
+    uint64_t recorded = noobnet::FlightRecorder::GetRecorded();
+    SYS_LOG_DEBUG(g_logger) << "not recorded";
+    ok &= noobnet::FlightRecorder::GetRecorded() == recorded;
+    noobnet::FlightRecorder::SetEnabled(true);
+
+    //信号和断言都只转储一次
+    unlink(s_file);
+    ok &= crash(false) == SIGSEGV;
+    dump = read_dump();
+    ok &= count_of(dump, "reason: SIGSEGV") == 1 && count_of(dump, "before crash 0") == 1;
+    ok &= count_of(dump, "previous handler") == 1
+        && dump.find("previous handler") > dump.find("before crash 0");
+
+    unlink(s_file);
+    ok &= crash(true) == SIGABRT;
+    dump = read_dump();
+    ok &= count_of(dump, "==== flight recorder dump") == 1
+        && count_of(dump, "reason: ASSERTION: 1 + 1 == 3") == 1
+        && count_of(dump, "before crash 1") == 1;
+
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "dumped=" << n << " recorded="
+        << noobnet::FlightRecorder::GetRecorded() << " ok=" << ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include "../net/log.h"
+#include "../net/config.h"
+#include "../net/utils.h"
+#include "../net/epoch.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//记录收到的条数和最后一条的logger名
+class CountLogAppender : public noobnet::LogAppender {
+public:
+    typedef std::shared_ptr<CountLogAppender> ptr;
+    void log(std::shared_ptr<noobnet::Logger> logger, noobnet::LogLevel::level level,
+             const noobnet::LogEvent& event) override {
+        ++count;
+        name = logger->getName();
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<uint64_t> count {0};
+    std::string name;
+};
+
+static const char* s_conf =
+    "logs:\n"
+    "  - name: net\n"
+    "    level: ERROR\n"
+    "  - name: net.http\n"
+    "    level: FATAL\n";
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    noobnet::Logger::ptr server = SYS_LOG_NAME("net.http.server");
+    noobnet::Logger::ptr http = SYS_LOG_NAME("net.http");
+    noobnet::Logger::ptr net = SYS_LOG_NAME("net");
+    //祖先在子logger之前自动创建
+    ok &= server->getParent() == http && http->getParent() == net
+        && net->getParent() == SYS_LOG_ROOT();
+
+    //级别沿层级继承
+    ok &= server->getLevel() == noobnet::LogLevel::DEBUG;
+    net->setLevel(noobnet::LogLevel::WARN);
+    ok &= server->getLevel() == noobnet::LogLevel::WARN;
+    http->setLevel(noobnet::LogLevel::INFO);
+    ok &= server->getLevel() == noobnet::LogLevel::INFO;
+    http->setLevel(noobnet::LogLevel::UNKOWN);
+    ok &= server->getLevel() == noobnet::LogLevel::WARN;
+
+    //appender取最近的非空祖先，输出时保留子logger的名字
+    CountLogAppender::ptr nc(new CountLogAppender);
+    net->addAppender(nc);
+    SYS_LOG_ERROR(server) << "to net";
+    SYS_LOG_DEBUG(server) << "filtered";
+    ok &= nc->count == 1 && nc->name == "net.http.server";
+    CountLogAppender::ptr sc(new CountLogAppender);
+    server->addAppender(sc);
+    SYS_LOG_ERROR(server) << "to server";
+    ok &= nc->count == 1 && sc->count == 1;
+    server->clearAppenders();
+    SYS_LOG_ERROR(server) << "to net again";
+    ok &= nc->count == 2 && sc->count == 1;
+
+    //调用点缓存的过滤结果在祖先的级别修改后失效，只会输出 i=1
+    for (int i = 0; i < 2; ++i) {
+        SYS_LOG_DEBUG(server) << "cached i=" << i;
+        net->setLevel(noobnet::LogLevel::DEBUG);
+    }
+    ok &= nc->count == 3;
+    net->setLevel(noobnet::LogLevel::WARN);
+
+    //配置修改后代数递增，缓存的解析结果失效
+    uint64_t generation = noobnet::Logger::GetGeneration();
+    noobnet::Config::LoadFromYaml(YAML::Load(s_conf));
+    ok &= noobnet::Logger::GetGeneration() > generation;
+    ok &= server->getLevel() == noobnet::LogLevel::FATAL;
+    ok &= SYS_LOG_NAME("net.tcp")->getLevel() == noobnet::LogLevel::ERROR;
+
+    //并发查找和创建
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> errors {0};
+    uint64_t begin = noobnet::GetMonotonicUS();
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t, &errors]() {
+            for (int i = 0; i < 100000; ++i) {
+                std::string name = "bench." + std::to_string(t) + "." + std::to_string(i % 100);
+                noobnet::Logger::ptr l = SYS_LOG_NAME(name);
+                if (l->getName() != name || l->getParent()->getName() != name.substr(0, name.rfind('.'))) {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (auto& i : threads) {
+        i.join();
+    }
+    uint64_t used = noobnet::GetMonotonicUS() - begin;
+    ok &= errors == 0;
+    //创建logger时替换下来的快照在读者离开后全部释放
+    noobnet::Epoch::Synchronize();
+    ok &= noobnet::Epoch::GetPending() == 0;
+
+    net->delAppender(nc);
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "400000 lookups in " << used << "us, "
+        << used * 1000.0 / 400000 << "ns/op";
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << (ok ? "test_log_hierarchy ok" : "test_log_hierarchy FAILED");
+    return ok ? 0 : 1;
+}
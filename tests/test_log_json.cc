@@ -0,0 +1,79 @@
+#include "../net/log.h"
+#include <cmath>
+
+//保存最后一条输出
+class CaptureLogAppender : public noobnet::LogAppender {
+public:
+    typedef std::shared_ptr<CaptureLogAppender> ptr;
+    void log(std::shared_ptr<noobnet::Logger> logger, noobnet::LogLevel::level level,
+             const noobnet::LogEvent& event) override {
+        noobnet::LogStream buf(true);
+        m_formatter->format(buf, logger, level, event);
+        last = buf.str();
+        legacy = m_formatter->format(logger, level, event);
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::string last;
+    std::string legacy;
+};
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    noobnet::Logger::ptr logger(new noobnet::Logger("json_test"));
+    CaptureLogAppender::ptr appender(new CaptureLogAppender);
+    appender->setFormater(noobnet::LogFormatter::ptr(new noobnet::LogFormatter("%J")));
+    logger->addAppender(appender);
+
+    SYS_LOG_KV_INFO(logger).with("uid", 42).with("cost", 1.5).with("ok", true)
+        .with("path", "/a \"b\"\n").with("neg", -7LL).with("big", 18446744073709551615ull)
+        << "done " << 1;
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << appender->last;
+    ok &= appender->last == appender->legacy;
+
+    //JSON是YAML的子集，用yaml-cpp检查输出能否被解析
+    YAML::Node n = YAML::Load(appender->last);
+    ok &= n["level"].as<std::string>() == "INFO";
+    ok &= n["logger"].as<std::string>() == "json_test";
+    ok &= n["message"].as<std::string>() == "done 1";
+    ok &= n["line"].as<int>() > 0 && n["thread"].as<uint32_t>() > 0;
+    ok &= n["time"].as<std::string>().size() == 26;
+    ok &= n["fields"]["uid"].as<int>() == 42;
+    ok &= n["fields"]["cost"].as<double>() == 1.5;
+    ok &= n["fields"]["ok"].as<bool>();
+    ok &= n["fields"]["path"].as<std::string>() == "/a \"b\"\n";
+    ok &= n["fields"]["neg"].as<int64_t>() == -7;
+    ok &= n["fields"]["big"].as<uint64_t>() == 18446744073709551615ull;
+
+    //控制字符转义，非有限浮点数输出为字符串，超出内部容量的字段
+    {
+        noobnet::LogEvent::ptr event(new noobnet::LogEvent(__FILE__, __LINE__,
+                    0, 1, 2, time(0), logger, noobnet::LogLevel::WARN));
+        event->getSS() << "ctl\x01";
+        event->with("nan", NAN).with("third", 1.0 / 3);
+        std::string big(1000, 'x');
+        for (int i = 0; i < 20; ++i) {
+            event->with(("k" + std::to_string(i)).c_str(), big);
+        }
+        logger->log(noobnet::LogLevel::WARN, event);
+        ok &= appender->last.find("\"ctl\\u0001\"") != std::string::npos;
+        n = YAML::Load(appender->last);
+        ok &= n["fields"]["nan"].as<std::string>() == "nan";
+        ok &= n["fields"]["third"].as<double>() == 1.0 / 3;
+        ok &= n["fields"]["k19"].as<std::string>() == big;
+        ok &= event->getFields().size() == 22;
+    }
+
+    //文本输出的key=value
+    appender->setFormater(noobnet::LogFormatter::ptr(new noobnet::LogFormatter("%m%T%K")));
+    SYS_LOG_KV_ERROR(logger).with("a", 1).with("s", "x y").with("e", "") << "text";
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << appender->last;
+    ok &= appender->last == "text\ta=1 s=\"x y\" e=\"\"";
+    ok &= appender->last == appender->legacy;
+
+    //没有字段的普通日志
+    SYS_LOG_ERROR(logger) << "plain";
+    ok &= appender->last == "plain\t";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#include "../net/log.h"
+#include "../net/thread.h"
+#include <unistd.h>
+
+static const char* s_file = "/tmp/noobnet_test_log_metrics.txt";
+static const int s_threads = 4;
+static const int s_lines = 10000;
+
+noobnet::Logger::ptr g_logger = SYS_LOG_NAME("metrics_test");
+
+void run() {
+    for (int i = 0; i < s_lines; ++i) {
+        SYS_LOG_INFO(g_logger) << "metrics " << i;
+        SYS_LOG_DEBUG(g_logger) << "filtered " << i;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    unlink(s_file);
+    g_logger->setLevel(noobnet::LogLevel::INFO);
+    noobnet::LogAppender::ptr file(new noobnet::FileLogAppender(s_file));
+    file->setFormater(noobnet::LogFormatter::ptr(new noobnet::LogFormatter("%m%n")));
+    noobnet::LogAppender::ptr error(new noobnet::FileLogAppender(s_file));
+    error->setLevel(noobnet::LogLevel::FATAL);
+    g_logger->addAppender(file);
+    g_logger->addAppender(error);
+
+    //默认不统计日志宏的级别过滤
+    SYS_LOG_DEBUG(g_logger) << "not counted";
+    ok &= g_logger->getMetrics().get(noobnet::LogMetrics::FILTERED) == 0;
+    noobnet::LogSite::SetCountFiltered(true);
+
+    std::vector<noobnet::Thread::ptr> thrs;
+    for (int i = 0; i < s_threads; ++i) {
+        thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread(&run, "t" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+
+    uint64_t total = s_threads * s_lines;
+    const noobnet::LogMetrics& lm = g_logger->getMetrics();
+    const noobnet::LogMetrics& am = file->getMetrics();
+    ok &= lm.get(noobnet::LogMetrics::EVENTS) == total;
+    ok &= lm.get(noobnet::LogMetrics::FILTERED) == total;
+    ok &= am.get(noobnet::LogMetrics::EVENTS) == total;
+    ok &= error->getMetrics().get(noobnet::LogMetrics::EVENTS) == 0;
+    //"metrics " + 数字 + 换行
+    uint64_t bytes = 0;
+    for (int i = 0; i < s_lines; ++i) {
+        bytes += 9 + std::to_string(i).size();
+    }
+    ok &= am.get(noobnet::LogMetrics::BYTES) == bytes * s_threads;
+    ok &= lm.get(noobnet::LogMetrics::BYTES) == bytes * s_threads;
+    ok &= am.get(noobnet::LogMetrics::FORMAT_NS) > 0;
+    ok &= am.get(noobnet::LogMetrics::APPEND_NS) > am.get(noobnet::LogMetrics::FORMAT_NS);
+    ok &= am.get(noobnet::LogMetrics::ERRORS) == 0;
+
+    //限速丢弃
+    g_logger->setRateLimit(1, 1);
+    for (int i = 0; i < 100; ++i) {
+        SYS_LOG_INFO(g_logger) << "throttled " << i;
+    }
+    g_logger->setRateLimit(0);
+    ok &= lm.get(noobnet::LogMetrics::THROTTLED) >= 99;
+
+    //写入失败
+    noobnet::LogAppender::ptr bad(new noobnet::FileLogAppender("/nonexistent/dir/x.log"));
+    g_logger->addAppender(bad);
+    SYS_LOG_INFO(g_logger) << "lost";
+    ok &= bad->getMetrics().get(noobnet::LogMetrics::ERRORS) == 1;
+    g_logger->delAppender(bad);
+
+    std::string yaml = noobnet::LoggerMgr::getInstance()->metricsToYamlString();
+    std::string json = noobnet::LoggerMgr::getInstance()->metricsToJsonString();
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "\n" << yaml;
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << json;
+    //JSON是YAML的子集
+    YAML::Node ny = YAML::Load(yaml);
+    YAML::Node nj = YAML::Load(json);
+    bool found = false;
+    for (auto n : {ny, nj}) {
+        for (size_t i = 0; i < n.size(); ++i) {
+            if (n[i]["name"].as<std::string>() != "metrics_test") {
+                continue;
+            }
+            found = true;
+            ok &= n[i]["filtered"].as<uint64_t>() == total;
+            ok &= n[i]["appenders"].size() == 2;
+            ok &= n[i]["appenders"][0]["type"].as<std::string>() == "FileLogAppender";
+            ok &= n[i]["appenders"][0]["bytes"].as<uint64_t>() == am.get(noobnet::LogMetrics::BYTES);
+            ok &= n[i]["appenders"][0]["io_ns"].as<uint64_t>() > 0;
+        }
+    }
+    ok &= found;
+    unlink(s_file);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include "../net/log.h"
+#include "../net/log_mmap.h"
+#include "../net/thread.h"
+#include "../net/epoch.h"
+#include <fstream>
+#include <set>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static const char* s_file = "/tmp/noobnet_test_log_mmap.txt";
+static const int s_threads = 4;
+static const int s_lines = 20000;
+
+noobnet::Logger::ptr g_logger = SYS_LOG_NAME("mmap_test");
+
+void run() {
+    for (int i = 0; i < s_lines; ++i) {
+        SYS_LOG_INFO(g_logger) << "mmap " << noobnet::Thread::GetName() << " " << i;
+    }
+}
+
+//写一轮日志，appender析构后文件应截断到实际长度
+static uint64_t write_round(const std::string& prefix) {
+    noobnet::MmapFileLogAppender::ptr appender(
+        new noobnet::MmapFileLogAppender(s_file, 64 * 1024));
+    g_logger->addAppender(appender);
+
+    std::vector<noobnet::Thread::ptr> thrs;
+    for (int i = 0; i < s_threads; ++i) {
+        thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread(&run, prefix + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    g_logger->clearAppenders();
+    //等旧的appender快照在后台释放，appender随本函数返回析构，下一轮才能从文件结尾继续
+    noobnet::Epoch::Synchronize();
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "offset=" << appender->getOffset()
+        << " chunks=" << appender->getMappedChunks()
+        << " errors=" << appender->getWriteErrors();
+    return appender->getOffset();
+}
+
+int main(int argc, char const *argv[])
+{
+    unlink(s_file);
+    write_round("a");
+    // 第二轮从已有文件的结尾继续写
+    uint64_t offset = write_round("b");
+
+    struct stat st;
+    stat(s_file, &st);
+    std::ifstream ifs(s_file);
+    std::string line;
+    std::set<std::string> lines;
+    int count = 0;
+    while (std::getline(ifs, line)) {
+        lines.insert(line.substr(line.find("mmap ")));
+        ++count;
+    }
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "size=" << st.st_size << " lines=" << count
+        << " unique=" << lines.size() << " expect=" << 2 * s_threads * s_lines;
+    return ((uint64_t)st.st_size == offset && count == 2 * s_threads * s_lines
+            && lines.size() == (size_t)count) ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include "../net/log.h"
+
+//保存最后一条消息
+class CaptureLogAppender : public noobnet::LogAppender {
+public:
+    typedef std::shared_ptr<CaptureLogAppender> ptr;
+    void log(std::shared_ptr<noobnet::Logger> logger, noobnet::LogLevel::level level,
+             const noobnet::LogEvent& event) override {
+        last = event.getContent();
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::string last;
+};
+
+struct Point {
+    int x;
+    int y;
+};
+
+std::ostream& operator<<(std::ostream& os, const Point& p) {
+    return os << "(" << p.x << "," << p.y << ")";
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    noobnet::Logger::ptr logger(new noobnet::Logger("printf_test"));
+    CaptureLogAppender::ptr appender(new CaptureLogAppender);
+    logger->addAppender(appender);
+
+    //printf风格
+    SYS_LOG_FMT_INFO(logger, "uid=%d cost=%.2f name=%s", 42, 1.5, "abc");
+    ok &= appender->last == "uid=42 cost=1.50 name=abc";
+
+    //超过线程本地缓冲的输出
+    std::string big(10000, 'x');
+    SYS_LOG_FMT_INFO(logger, "[%s] %d", big.c_str(), 7);
+    ok &= appender->last == "[" + big + "] 7";
+    SYS_LOG_FMT_INFO(logger, "%s", "");
+    ok &= appender->last.empty();
+
+    //流式输出之后追加
+    {
+        noobnet::LogEventWrap wrap(__FILE__, __LINE__, logger, noobnet::LogLevel::INFO);
+        wrap.getSS() << std::string(4090, 'a');
+        wrap.getEvent()->format("%s|%d", "bcdefg", 1);
+    }
+    ok &= appender->last == std::string(4090, 'a') + "bcdefg|1";
+
+    //{}占位符
+    std::string name("noob");
+    SYS_LOG_PRINT_INFO(logger, "uid={} cost={} name={} ok={} p={}", 42, 1.5, name, true, Point{1, 2});
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << appender->last;
+    ok &= appender->last == "uid=42 cost=1.5 name=noob ok=1 p=(1,2)";
+    SYS_LOG_PRINT_WARN(logger, "no args {{}} }}");
+    ok &= appender->last == "no args {} }";
+    SYS_LOG_PRINT_ERROR(logger, "{}{}", big, -1);
+    ok &= appender->last == big + "-1";
+
+    //非字面量的格式串直接调用print，个数不一致时不会出错
+    {
+        noobnet::LogEvent event(__FILE__, __LINE__, 0, 1, 2, time(0), logger, noobnet::LogLevel::INFO);
+        std::string fmt("a={} b={}");
+        event.print(fmt.c_str(), 1);
+        ok &= event.getContent() == "a=1 b={}";
+    }
+    {
+        noobnet::LogEvent event(__FILE__, __LINE__, 0, 1, 2, time(0), logger, noobnet::LogLevel::INFO);
+        event.print("a={}", 1, 2, 3);
+        ok &= event.getContent() == "a=1";
+    }
+
+    static_assert(noobnet::LogPlaceholders("{} {{}} {}") == 2, "placeholders");
+    static_assert(noobnet::LogPlaceholders("{x}") == 0, "placeholders");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include "../net/log.h"
+#include "../net/config.h"
+#include "../net/thread.h"
+#include "../net/epoch.h"
+#include <atomic>
+#include <fstream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+static const int s_loggers = 100;
+static const char* s_fifo = "/tmp/noobnet_test_log_reload.fifo";
+
+//logger数量较多的配置，level_switch切换reload_0的appender级别，with_extra给reload_1多加一个appender，
+//file为reload_0的appender写入的文件
+static std::string make_conf(int level_switch, bool with_extra,
+                             const std::string& file = "/dev/null") {
+    std::string conf = "logs:\n";
+    for (int i = 0; i < s_loggers; ++i) {
+        conf += "  - name: reload_" + std::to_string(i) + "\n";
+        conf += "    level: INFO\n";
+        conf += "    appenders:\n";
+        conf += "      - type: FileLogAppender\n";
+        conf += "        file: " + (i == 0 ? file : std::string("/dev/null")) + "\n";
+        if (i == 0) {
+            conf += std::string("        level: ") + (level_switch ? "WARN" : "INFO") + "\n";
+        }
+        if (with_extra && i == 1) {
+            conf += "      - type: StdoutLogAppender\n";
+            conf += "        level: FATAL\n";
+        }
+    }
+    return conf;
+}
+
+//线程是否阻塞在打开文件的系统调用中
+static bool blocked_in_open(pid_t tid) {
+    std::ifstream ifs("/proc/self/task/" + std::to_string(tid) + "/syscall");
+    long nr = -1;
+    ifs >> nr;
+    return nr == SYS_openat || nr == SYS_open;
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    noobnet::Config::LoadFromYaml(YAML::Load(make_conf(0, false)));
+    noobnet::Logger::ptr l0 = SYS_LOG_NAME("reload_0");
+    noobnet::Logger::ptr l1 = SYS_LOG_NAME("reload_1");
+    noobnet::Logger::ptr l2 = SYS_LOG_NAME("reload_2");
+    ok &= l0->getAppenders()->size() == 1 && l1->getAppenders()->size() == 1;
+    noobnet::LogAppender::ptr a0 = l0->getAppenders()->front();
+    noobnet::LogAppender::ptr a2 = l2->getAppenders()->front();
+    std::weak_ptr<noobnet::LogAppender> w0(a0);
+
+    //只有reload_0的appender变化，其余复用原来的对象，不会重复添加
+    noobnet::Config::LoadFromYaml(YAML::Load(make_conf(1, true)));
+    ok &= l0->getAppenders()->size() == 1 && l0->getAppenders()->front() != a0;
+    ok &= l0->getAppenders()->front()->getLevel() == noobnet::LogLevel::WARN;
+    ok &= l1->getAppenders()->size() == 2;
+    ok &= l2->getAppenders()->size() == 1 && l2->getAppenders()->front() == a2;
+
+    //被替换的appender交给回收线程，等待回收后即已析构
+    a0.reset();
+    noobnet::Epoch::Synchronize();
+    ok &= w0.expired();
+
+    //仍有线程在写日志（处于临界区内）时，被替换的appender不会被析构
+    noobnet::LogAppender::ptr a1 = l0->getAppenders()->front();
+    std::weak_ptr<noobnet::LogAppender> w1(a1);
+    a1.reset();
+    std::atomic<bool> entered {false};
+    std::atomic<bool> leave {false};
+    noobnet::Thread::ptr holder(new noobnet::Thread([&entered, &leave] () {
+        noobnet::EpochGuard guard;
+        entered = true;
+        while (!leave) {
+            usleep(1000);
+        }
+    }, "holder"));
+    while (!entered) {
+        usleep(1000);
+    }
+    noobnet::Config::LoadFromYaml(YAML::Load(make_conf(0, true)));
+    ok &= l0->getAppenders()->front()->getLevel() == noobnet::LogLevel::INFO;
+    usleep(20 * 1000);
+    ok &= !w1.expired();
+    leave = true;
+    holder->join();
+    noobnet::Epoch::Synchronize();
+    ok &= w1.expired();
+
+    //代码中添加的appender不受配置影响
+    noobnet::LogAppender::ptr manual(new noobnet::StdoutLogAppender);
+    manual->setLevel(noobnet::LogLevel::FATAL);
+    l1->addAppender(manual);
+    noobnet::Config::LoadFromYaml(YAML::Load(make_conf(1, false)));
+    ok &= l1->getAppenders()->size() == 2 && l1->getAppenders()->back() == manual;
+
+    //加载期间写日志的线程不会被阻塞：加载线程在创建appender时打开FIFO，
+    //没有读端时一直阻塞在open中，这期间在另一个线程查找logger并写日志，必须能够完成
+    unlink(s_fifo);
+    ok &= mkfifo(s_fifo, 0644) == 0;
+    std::atomic<pid_t> reload_tid {0};
+    noobnet::Thread::ptr reloader(new noobnet::Thread([&reload_tid] () {
+        reload_tid = noobnet::GetThreadId();
+        noobnet::Config::LoadFromYaml(YAML::Load(make_conf(0, false, s_fifo)));
+    }, "reloader"));
+    while (!reload_tid || !blocked_in_open(reload_tid)) {
+        usleep(1000);
+    }
+    std::atomic<bool> logged {false};
+    noobnet::Thread::ptr writer(new noobnet::Thread([&logged] () {
+        for (int i = 0; i < s_loggers; ++i) {
+            SYS_LOG_INFO(SYS_LOG_NAME("reload_" + std::to_string(i))) << "during reload " << i;
+        }
+        logged = true;
+    }, "writer"));
+    for (int i = 0; i < 1000 && !logged; ++i) {
+        usleep(1000);
+    }
+    ok &= logged && blocked_in_open(reload_tid);
+    //打开读端让加载继续
+    int fd = open(s_fifo, O_RDONLY | O_NONBLOCK);
+    writer->join();
+    reloader->join();
+    ok &= l2->getAppenders()->size() == 1 && l2->getAppenders()->front() == a2;
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "logged_during_reload=" << logged;
+
+    //删除logger只移除配置创建的appender
+    noobnet::Config::LoadFromYaml(YAML::Load("logs:\n  - name: reload_1\n    level: INFO\n"));
+    ok &= l2->getAppenders()->empty();
+    ok &= l1->getAppenders()->size() == 1 && l1->getAppenders()->front() == manual;
+    noobnet::Epoch::Synchronize();
+    close(fd);
+    unlink(s_fifo);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#include "../net/log.h"
+#include "../net/log_rolling.h"
+#include "../net/thread.h"
+#include <zlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <set>
+
+static const char* s_dir = "/tmp/noobnet_test_log_rolling";
+static const int s_threads = 4;
+static const int s_lines = 20000;
+
+noobnet::Logger::ptr g_logger = SYS_LOG_NAME("rolling_test");
+
+void run() {
+    for (int i = 0; i < s_lines; ++i) {
+        SYS_LOG_INFO(g_logger) << "rolling " << noobnet::Thread::GetName() << " " << i;
+    }
+}
+
+//读取目录下所有日志文件（含.gz），统计每一行
+static void collect(std::multiset<std::string>& lines, int& files) {
+    DIR* d = opendir(s_dir);
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(d)) != nullptr) {
+        std::string name = dp->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        ++files;
+        gzFile f = gzopen((std::string(s_dir) + "/" + name).c_str(), "rb");
+        char buf[1024];
+        while (gzgets(f, buf, sizeof(buf))) {
+            std::string line(buf);
+            lines.insert(line.substr(line.find("rolling ")));
+        }
+        gzclose(f);
+    }
+    closedir(d);
+}
+
+int main(int argc, char const *argv[])
+{
+    system((std::string("rm -rf ") + s_dir + " && mkdir -p " + s_dir).c_str());
+    {
+        noobnet::RollingFileLogAppender::ptr appender(new noobnet::RollingFileLogAppender(
+            std::string(s_dir) + "/app.log", 256 * 1024, 0, 0, noobnet::RollingFileLogAppender::GZIP));
+        g_logger->addAppender(appender);
+
+        std::vector<noobnet::Thread::ptr> thrs;
+        for (int i = 0; i < s_threads; ++i) {
+            thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread(&run, "t" + std::to_string(i))));
+        }
+        for (auto& i : thrs) {
+            i->join();
+        }
+        g_logger->clearAppenders();
+        SYS_LOG_INFO(SYS_LOG_ROOT()) << "rotations=" << appender->getRotations()
+            << " errors=" << appender->getWriteErrors();
+    }
+
+    std::multiset<std::string> lines;
+    int files = 0;
+    collect(lines, files);
+    size_t unique = std::set<std::string>(lines.begin(), lines.end()).size();
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "files=" << files << " lines=" << lines.size()
+        << " unique=" << unique << " expect=" << s_threads * s_lines;
+    return (lines.size() == unique && unique == (size_t)s_threads * s_lines) ? 0 : 1;
+}
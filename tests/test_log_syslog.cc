@@ -0,0 +1,150 @@
+#include "../net/log.h"
+#include "../net/log_syslog.h"
+#include "../net/config.h"
+#include "../net/thread.h"
+#include <atomic>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static const char* s_sock = "/tmp/noobnet_test_log_syslog.sock";
+static const int s_threads = 4;
+static const int s_lines = 5000;
+
+static const char* s_conf =
+    "logs:\n"
+    "  - name: syslog_test\n"
+    "    level: DEBUG\n"
+    "    formatter: \"%c %m\"\n"
+    "    appenders:\n"
+    "      - type: SyslogLogAppender\n"
+    "        address: unix:/tmp/noobnet_test_log_syslog.sock\n"
+    "        facility: local0\n"
+    "        tag: noobnet_test\n"
+    "        queue_size: 1048576\n"
+    "        flush_interval: 10\n";
+
+noobnet::Logger::ptr g_logger = SYS_LOG_NAME("syslog_test");
+
+std::atomic<bool> g_stop {false};
+std::atomic<uint64_t> g_received {0};
+std::atomic<uint64_t> g_bad {0};
+
+//收集端：统计收到的报文并检查格式
+void collect(int fd) {
+    char buf[65536];
+    while (!g_stop) {
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n <= 0) {
+            usleep(100);
+            continue;
+        }
+        std::string msg(buf, n);
+        //local0(16) * 8 + info(6)
+        if (msg.compare(0, 5, "<134>") != 0 || msg.find(" noobnet_test[") == std::string::npos
+                || msg.find("]: syslog_test syslog ") == std::string::npos || msg.back() == '\n') {
+            ++g_bad;
+        }
+        ++g_received;
+    }
+}
+
+void run() {
+    for (int i = 0; i < s_lines; ++i) {
+        SYS_LOG_INFO(g_logger) << "syslog " << noobnet::Thread::GetName() << " " << i;
+    }
+}
+
+static int bind_unix(const char* path) {
+    unlink(path);
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return fd;
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = true;
+    int fd = bind_unix(s_sock);
+    noobnet::Thread::ptr collector(new noobnet::Thread(std::bind(&collect, fd), "collector"));
+
+    noobnet::Config::LoadFromYaml(YAML::Load(s_conf));
+    auto appenders = g_logger->getAppenders();
+    noobnet::SyslogLogAppender::ptr appender = appenders->empty() ? nullptr
+        : std::dynamic_pointer_cast<noobnet::SyslogLogAppender>(appenders->front());
+    if (!appender) {
+        return 1;
+    }
+
+    std::vector<noobnet::Thread::ptr> thrs;
+    for (int i = 0; i < s_threads; ++i) {
+        thrs.push_back(noobnet::Thread::ptr(new noobnet::Thread(&run, "t" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    appender->flush();
+    usleep(100 * 1000);
+    g_stop = true;
+    collector->join();
+
+    uint64_t total = s_threads * s_lines;
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "sent=" << appender->getSent()
+        << " received=" << g_received << " bad=" << g_bad
+        << " dropped=" << appender->getDropped() << " send_dropped=" << appender->getSendDropped()
+        << " calls=" << appender->getSendCalls() << " errors=" << appender->getSendErrors();
+    ok &= appender->getSent() + appender->getDropped() + appender->getSendDropped() == total;
+    ok &= g_received == appender->getSent() && g_bad == 0;
+    //批量发送
+    ok &= appender->getSendCalls() < appender->getSent();
+
+    //收集端停止读取时日志线程不会阻塞，多出的报文计入丢弃
+    uint64_t begin = noobnet::GetMonotonicUS();
+    for (int i = 0; i < 100000; ++i) {
+        SYS_LOG_INFO(g_logger) << "stalled " << i;
+    }
+    appender->flush();
+    uint64_t cost = noobnet::GetMonotonicUS() - begin;
+    uint64_t lost = appender->getDropped() + appender->getSendDropped();
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "stalled: cost=" << cost << "us lost=" << lost;
+    ok &= lost > 0;
+    ok &= appender->getSent() + lost == total + 100000;
+    close(fd);
+    unlink(s_sock);
+
+    //UDP
+    int ufd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(ufd, (struct sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(ufd, (struct sockaddr*)&addr, &len);
+    {
+        noobnet::SyslogLogAppender::ptr udp(new noobnet::SyslogLogAppender(
+                "udp:127.0.0.1:" + std::to_string(ntohs(addr.sin_port)), "daemon", "udp_test"));
+        noobnet::Logger::ptr logger(new noobnet::Logger("udp_logger"));
+        logger->addAppender(udp);
+        SYS_LOG_ERROR(logger) << "over udp";
+        udp->flush();
+        ok &= udp->getSent() == 1;
+    }
+    char buf[1024];
+    ssize_t n = recv(ufd, buf, sizeof(buf), MSG_DONTWAIT);
+    std::string msg(n > 0 ? std::string(buf, n) : "");
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "udp: " << msg;
+    //daemon(3) * 8 + err(3)
+    ok &= msg.compare(0, 4, "<27>") == 0 && msg.find(" udp_test[" + std::to_string(getpid()) + "]: ") != std::string::npos
+        && msg.find("over udp") != std::string::npos;
+    close(ufd);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include "../net/log.h"
+#include "../net/config.h"
+#include <atomic>
+
+//统计收到的日志和汇总行
+class CountLogAppender : public noobnet::LogAppender {
+public:
+    typedef std::shared_ptr<CountLogAppender> ptr;
+    void log(std::shared_ptr<noobnet::Logger> logger, noobnet::LogLevel::level level,
+             const noobnet::LogEvent& event) override {
+        std::string content = event.getContent();
+        if (content.compare(0, 11, "suppressed ") == 0) {
+            ++reports;
+            suppressed += std::stoull(content.substr(11));
+        } else {
+            ++passed;
+        }
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<uint64_t> passed {0};
+    std::atomic<uint64_t> reports {0};
+    std::atomic<uint64_t> suppressed {0};
+};
+
+static const char* s_conf =
+    "logs:\n"
+    "  - name: sample_test\n"
+    "    level: DEBUG\n"
+    "    sample: 10\n"
+    "  - name: rate_test\n"
+    "    level: DEBUG\n"
+    "    rate_limit: 100\n"
+    "    burst: 10\n";
+
+int main(int argc, char const *argv[])
+{
+    noobnet::Config::LoadFromYaml(YAML::Load(s_conf));
+    bool ok = true;
+
+    //1/10采样
+    noobnet::Logger::ptr sample = SYS_LOG_NAME("sample_test");
+    CountLogAppender::ptr sc(new CountLogAppender);
+    sample->addAppender(sc);
+    for (int i = 0; i < 1000; ++i) {
+        SYS_LOG_ERROR(sample) << "sampled " << i;
+    }
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "sample: passed=" << sc->passed
+        << " reports=" << sc->reports << " suppressed=" << sc->suppressed;
+    ok &= sc->passed == 100;
+
+    //每秒100条，突发10条，持续1.5秒
+    noobnet::Logger::ptr rate = SYS_LOG_NAME("rate_test");
+    CountLogAppender::ptr rc(new CountLogAppender);
+    rate->addAppender(rc);
+    uint64_t begin = noobnet::GetMonotonicUS();
+    uint64_t total = 0;
+    while (noobnet::GetMonotonicUS() - begin < 1500 * 1000) {
+        SYS_LOG_ERROR(rate) << "limited " << total;
+        ++total;
+    }
+    double secs = (noobnet::GetMonotonicUS() - begin) / 1e6;
+    SYS_LOG_INFO(SYS_LOG_ROOT()) << "rate: total=" << total << " passed=" << rc->passed
+        << " reports=" << rc->reports << " suppressed=" << rc->suppressed
+        << " secs=" << secs;
+    ok &= rc->passed >= 10 && rc->passed <= 10 + (uint64_t)(secs * 100) + 1;
+    ok &= rc->reports >= 1 && rc->passed + rc->suppressed <= total;
+
+    //关闭后不再节流
+    rate->setRateLimit(0);
+    uint64_t before = rc->passed;
+    for (int i = 0; i < 1000; ++i) {
+        SYS_LOG_ERROR(rate) << "unlimited " << i;
+    }
+    ok &= rc->passed - before >= 1000;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#include "../net/log.h"
+#include "../net/log_binary.h"
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+//将BinaryLogAppender输出的文件还原为文本
+//用法: log_decode [-p pattern] file...
+int main(int argc, char* argv[])
+{
+    std::string pattern = "%d%T[%p]%T%c%T%m%T%n";
+    int opt;
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        if (opt == 'p') {
+            pattern = optarg;
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-p pattern] file..." << std::endl;
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        std::cerr << "usage: " << argv[0] << " [-p pattern] file..." << std::endl;
+        return 1;
+    }
+
+    noobnet::BinaryLogReader reader(pattern);
+    if (reader.getFormatter()->is_Error()) {
+        std::cerr << "invalid pattern: " << pattern << std::endl;
+        return 1;
+    }
+    for (int i = optind; i < argc; ++i) {
+        std::ifstream ifs(argv[i], std::ios::binary);
+        if (!ifs) {
+            std::cerr << "open " << argv[i] << " failed" << std::endl;
+            return 1;
+        }
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        const std::string& data = ss.str();
+
+        noobnet::LogStream out;
+        int64_t n = reader.decode(data.c_str(), data.size(), out);
+        fwrite(out.data(), 1, out.size(), stdout);
+        if (n < 0) {
+            std::cerr << argv[i] << ": corrupted record" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}